@@ -0,0 +1,302 @@
+#pragma once
+#include "../NovusTypes.h"
+#include "ByteBuffer.h"
+#include <cassert>
+#include <memory>
+
+namespace BitStream
+{
+    // Number of bits needed to store any value in [0, range]
+    constexpr u32 BitsRequired(u32 range)
+    {
+        u32 bits = 0;
+        while (range != 0)
+        {
+            bits++;
+            range >>= 1;
+        }
+
+        return bits;
+    }
+}
+
+/*
+    Packs values at bit granularity into a Bytebuffer.
+
+    Bits are collected in a 64-bit scratch word and written out 32 bits at a time, the buffer is only guaranteed to hold
+    everything once Flush has been called. Writing past the end of the buffer doesn't throw, it marks the writer as
+    overflowed and every following write returns false.
+*/
+class BitWriter
+{
+public:
+    BitWriter(std::shared_ptr<Bytebuffer>& buffer) : _buffer(buffer.get()) { }
+    ~BitWriter()
+    {
+        // Forgetting to flush would silently drop the tail of the stream
+        assert(_scratchBits == 0 || _hasOverflowed);
+    }
+
+    inline bool WriteBits(u32 value, u32 numBits)
+    {
+        assert(numBits <= 32);
+        assert(numBits == 32 || (value >> numBits) == 0);
+
+        if (_hasOverflowed)
+            return false;
+
+        _scratch |= static_cast<u64>(value) << _scratchBits;
+        _scratchBits += numBits;
+        _bitsWritten += numBits;
+
+        if (_scratchBits >= 32)
+        {
+            if (!_buffer->PutU32(static_cast<u32>(_scratch)))
+            {
+                _hasOverflowed = true;
+                return false;
+            }
+
+            _scratch >>= 32;
+            _scratchBits -= 32;
+        }
+
+        return true;
+    }
+    inline bool WriteBool(bool value)
+    {
+        return WriteBits(value ? 1 : 0, 1);
+    }
+
+    // Writes value using only as many bits as the range [min, max] needs
+    inline bool WriteRanged(u32 value, u32 min, u32 max)
+    {
+        assert(min <= max && value >= min && value <= max);
+        return WriteBits(value - min, BitStream::BitsRequired(max - min));
+    }
+    inline bool WriteRanged(i32 value, i32 min, i32 max)
+    {
+        assert(min <= max && value >= min && value <= max);
+
+        u32 range = static_cast<u32>(static_cast<i64>(max) - min);
+        return WriteBits(static_cast<u32>(static_cast<i64>(value) - min), BitStream::BitsRequired(range));
+    }
+
+    // Maps value from [min, max] onto numBits bits, values outside of the range are clamped
+    inline bool WriteQuantized(f32 value, f32 min, f32 max, u32 numBits)
+    {
+        assert(min < max && numBits > 0 && numBits <= 32);
+
+        f64 maxQuantized = static_cast<f64>((static_cast<u64>(1) << numBits) - 1);
+        f64 normalized = (static_cast<f64>(value) - min) / (static_cast<f64>(max) - min);
+        normalized = normalized < 0.0 ? 0.0 : (normalized > 1.0 ? 1.0 : normalized);
+
+        return WriteBits(static_cast<u32>(normalized * maxQuantized + 0.5), numBits);
+    }
+
+    // LEB128, 7 bits per byte with the high bit set while more bytes follow
+    inline bool WriteVarInt(u64 value)
+    {
+        do
+        {
+            u32 byte = static_cast<u32>(value & 0x7F);
+            value >>= 7;
+
+            if (value != 0)
+                byte |= 0x80;
+
+            if (!WriteBits(byte, 8))
+                return false;
+        } while (value != 0);
+
+        return true;
+    }
+    // Zigzag encoded so small negative values stay small
+    inline bool WriteVarInt(i64 value)
+    {
+        return WriteVarInt((static_cast<u64>(value) << 1) ^ static_cast<u64>(value >> 63));
+    }
+
+    // Pads with zero bits up to the next byte boundary
+    inline bool AlignToByte()
+    {
+        u32 padding = (8 - (_scratchBits % 8)) % 8;
+        return padding == 0 || WriteBits(0, padding);
+    }
+
+    // Aligns and writes out the remaining scratch bytes, after this the buffer can be written to directly again
+    inline bool Flush()
+    {
+        if (!AlignToByte())
+            return false;
+
+        u32 numBytes = _scratchBits / 8;
+        if (!_buffer->CanPerformWrite(numBytes))
+        {
+            _hasOverflowed = true;
+            return false;
+        }
+
+        for (u32 i = 0; i < numBytes; i++)
+        {
+            _buffer->PutU8(static_cast<u8>(_scratch >> (i * 8)));
+        }
+
+        _scratch = 0;
+        _scratchBits = 0;
+        return true;
+    }
+
+    size_t GetBitsWritten() const { return _bitsWritten; }
+    bool HasOverflowed() const { return _hasOverflowed; }
+
+private:
+    Bytebuffer* _buffer;
+
+    u64 _scratch = 0;
+    u32 _scratchBits = 0;
+    size_t _bitsWritten = 0;
+    bool _hasOverflowed = false;
+};
+
+/*
+    Reads values written by BitWriter, starting at the buffer's current read position and never past writtenData.
+    Call Align once done to hand the unread whole bytes back to the buffer.
+*/
+class BitReader
+{
+public:
+    BitReader(std::shared_ptr<Bytebuffer>& buffer) : _buffer(buffer.get()) { }
+
+    inline bool ReadBits(u32& value, u32 numBits)
+    {
+        assert(numBits <= 32);
+
+        while (_scratchBits < numBits)
+        {
+            size_t bytesLeft = _buffer->writtenData - _buffer->readData;
+            if (bytesLeft >= sizeof(u32) && _scratchBits <= 32)
+            {
+                u32 word = 0;
+                _buffer->GetU32(word);
+
+                _scratch |= static_cast<u64>(word) << _scratchBits;
+                _scratchBits += 32;
+            }
+            else if (bytesLeft > 0)
+            {
+                u8 byte = 0;
+                _buffer->GetU8(byte);
+
+                _scratch |= static_cast<u64>(byte) << _scratchBits;
+                _scratchBits += 8;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        value = numBits == 32 ? static_cast<u32>(_scratch) : static_cast<u32>(_scratch & ((static_cast<u64>(1) << numBits) - 1));
+        _scratch >>= numBits;
+        _scratchBits -= numBits;
+        _bitsRead += numBits;
+        return true;
+    }
+    inline bool ReadBool(bool& value)
+    {
+        u32 bit = 0;
+        if (!ReadBits(bit, 1))
+            return false;
+
+        value = bit != 0;
+        return true;
+    }
+
+    inline bool ReadRanged(u32& value, u32 min, u32 max)
+    {
+        assert(min <= max);
+
+        u32 offset = 0;
+        if (!ReadBits(offset, BitStream::BitsRequired(max - min)))
+            return false;
+
+        value = min + offset;
+        return value <= max;
+    }
+    inline bool ReadRanged(i32& value, i32 min, i32 max)
+    {
+        assert(min <= max);
+
+        u32 range = static_cast<u32>(static_cast<i64>(max) - min);
+        u32 offset = 0;
+        if (!ReadBits(offset, BitStream::BitsRequired(range)) || offset > range)
+            return false;
+
+        value = static_cast<i32>(static_cast<i64>(min) + offset);
+        return true;
+    }
+
+    inline bool ReadQuantized(f32& value, f32 min, f32 max, u32 numBits)
+    {
+        assert(min < max && numBits > 0 && numBits <= 32);
+
+        u32 quantized = 0;
+        if (!ReadBits(quantized, numBits))
+            return false;
+
+        f64 maxQuantized = static_cast<f64>((static_cast<u64>(1) << numBits) - 1);
+        value = static_cast<f32>(min + (static_cast<f64>(max) - min) * (quantized / maxQuantized));
+        return true;
+    }
+
+    inline bool ReadVarInt(u64& value)
+    {
+        value = 0;
+
+        // A u64 never needs more than 10 bytes, anything longer is malformed
+        for (u32 shift = 0; shift < 70; shift += 7)
+        {
+            u32 byte = 0;
+            if (!ReadBits(byte, 8))
+                return false;
+
+            value |= static_cast<u64>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+
+        return false;
+    }
+    inline bool ReadVarInt(i64& value)
+    {
+        u64 zigzag = 0;
+        if (!ReadVarInt(zigzag))
+            return false;
+
+        value = static_cast<i64>(zigzag >> 1) ^ -static_cast<i64>(zigzag & 1);
+        return true;
+    }
+
+    // Skips to the next byte boundary and returns any bytes read ahead into the scratch word to the buffer
+    inline void Align()
+    {
+        u32 padding = _scratchBits % 8;
+        _scratch >>= padding;
+        _scratchBits -= padding;
+        _bitsRead += padding;
+
+        _buffer->readData -= _scratchBits / 8;
+        _scratch = 0;
+        _scratchBits = 0;
+    }
+
+    size_t GetBitsRead() const { return _bitsRead; }
+
+private:
+    Bytebuffer* _buffer;
+
+    u64 _scratch = 0;
+    u32 _scratchBits = 0;
+    size_t _bitsRead = 0;
+};
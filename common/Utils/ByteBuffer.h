@@ -530,6 +530,17 @@ public:
     inline void SetOwnership(bool hasOwnership) { _hasOwnership = hasOwnership; }
     inline bool HasOwnership() { return _hasOwnership; }
 
+    // Points a non-owning buffer at memory owned by someone else, this is used for zero-copy views
+    inline void SetView(u8* inData, size_t inSize)
+    {
+        assert(!_hasOwnership);
+
+        _data = inData;
+        size = inSize;
+        writtenData = inSize;
+        readData = 0;
+    }
+
     inline bool SkipRead(size_t bytes) 
     {
         if (readData + bytes > size)
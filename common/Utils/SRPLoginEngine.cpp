@@ -0,0 +1,187 @@
+#include "SRPLoginEngine.h"
+#include "CPUInfo.h"
+#include <Utils/DebugHandler.h>
+#include <algorithm>
+#include <cstring>
+
+SRPLoginEngine::SRPLoginEngine(u32 numWorkers, size_t poolSize) : _poolSize(poolSize), _numWorkers(numWorkers), _numSleeping(0), _isRunning(false), _hasRefillFailed(false), _numLogins(0), _numPoolMisses(0)
+{
+    if (_numWorkers == 0)
+        _numWorkers = static_cast<u32>(std::max(CPUInfo::Get().GetNumCores(), 1));
+
+    // Builds the group's tables before any worker needs them
+    SRPUtils::GetNG();
+}
+SRPLoginEngine::~SRPLoginEngine()
+{
+    Stop();
+}
+
+void SRPLoginEngine::Start(bool prefill)
+{
+    if (_isRunning)
+        return;
+
+    _isRunning = true;
+    _hasRefillFailed = false;
+
+    _workers.reserve(_numWorkers);
+    for (u32 i = 0; i < _numWorkers; i++)
+    {
+        _workers.push_back(std::thread(&SRPLoginEngine::Run, this));
+    }
+
+    if (prefill)
+    {
+        // Workers only go to sleep once the pool is full or can't be refilled and they have nothing else to do, and say so right before
+        std::unique_lock<std::mutex> lock(_mutex);
+        _poolCondition.wait(lock, [this]() { return _ephemerals.size_approx() >= _poolSize || _hasRefillFailed || !_isRunning; });
+
+        if (_hasRefillFailed)
+            DebugHandler::PrintWarning("[SRPLoginEngine]: Generating an ephemeral failed, only prefilled %zu of %zu", _ephemerals.size_approx(), _poolSize);
+    }
+}
+void SRPLoginEngine::Stop()
+{
+    if (_isRunning)
+    {
+        _isRunning = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _condition.notify_all();
+            _poolCondition.notify_all();
+        }
+
+        for (std::thread& worker : _workers)
+        {
+            if (worker.joinable())
+                worker.join();
+        }
+
+        _workers.clear();
+    }
+
+    // Nobody is left to verify these, but whoever queued them is still waiting on an answer
+    LoginJob jobs[DEQUEUE_BULK_SIZE];
+    while (size_t numJobs = _jobs.try_dequeue_bulk(jobs, DEQUEUE_BULK_SIZE))
+    {
+        for (size_t i = 0; i < numJobs; i++)
+        {
+            LoginJob& job = jobs[i];
+            if (job.handler)
+                job.handler(job.verifier, false);
+
+            job = LoginJob();
+        }
+    }
+}
+
+void SRPLoginEngine::Enqueue(std::shared_ptr<SRPVerifier> verifier, const std::string& username, const u8* aBuffer, Handler handler)
+{
+    LoginJob job;
+    job.verifier = std::move(verifier);
+    job.username = username;
+    std::memcpy(job.a, aBuffer, sizeof(job.a));
+    job.handler = std::move(handler);
+
+    _jobs.enqueue(std::move(job));
+    Wake();
+}
+bool SRPLoginEngine::StartVerification(SRPVerifier& verifier, const std::string& username, const u8* aBuffer)
+{
+    std::unique_ptr<SRPEphemeral> ephemeral = TakeEphemeral();
+    if (!ephemeral)
+        return false;
+
+    _numLogins++;
+    return verifier.StartVerification(username, aBuffer, *ephemeral);
+}
+
+std::unique_ptr<SRPEphemeral> SRPLoginEngine::TakeEphemeral()
+{
+    // Every ephemeral is used for exactly one login, reusing b would let a client learn about it
+    std::unique_ptr<SRPEphemeral> ephemeral;
+    if (_ephemerals.try_dequeue(ephemeral))
+    {
+        // A sleeping worker only refills the pool once it is woken
+        Wake();
+        return ephemeral;
+    }
+
+    _numPoolMisses++;
+
+    ephemeral = std::make_unique<SRPEphemeral>();
+    if (!ephemeral->Generate())
+        return nullptr;
+
+    return ephemeral;
+}
+bool SRPLoginEngine::RefillEphemeral()
+{
+    if (_ephemerals.size_approx() >= _poolSize)
+        return false;
+
+    // A failure isn't retried until a worker is woken again, otherwise the workers would spin on it
+    std::unique_ptr<SRPEphemeral> ephemeral = std::make_unique<SRPEphemeral>();
+    if (!ephemeral->Generate())
+    {
+        _hasRefillFailed = true;
+        return false;
+    }
+
+    _hasRefillFailed = false;
+    _ephemerals.enqueue(std::move(ephemeral));
+    return true;
+}
+
+void SRPLoginEngine::Wake()
+{
+    // Pairs with the fence in Run, either a worker sees what we just did or we see it going to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_numSleeping.load(std::memory_order_relaxed) == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_numWakeups < _numSleeping.load(std::memory_order_relaxed))
+            _numWakeups++;
+    }
+    _condition.notify_one();
+}
+
+void SRPLoginEngine::Run()
+{
+    LoginJob jobs[DEQUEUE_BULK_SIZE];
+    while (_isRunning)
+    {
+        size_t numJobs = _jobs.try_dequeue_bulk(jobs, DEQUEUE_BULK_SIZE);
+        for (size_t i = 0; i < numJobs; i++)
+        {
+            LoginJob& job = jobs[i];
+
+            bool result = StartVerification(*job.verifier, job.username, job.a);
+            if (job.handler)
+                job.handler(job.verifier, result);
+
+            job = LoginJob();
+        }
+
+        // Challenges always go first, the pool is only refilled one ephemeral at a time in between
+        if (numJobs > 0 || RefillEphemeral())
+            continue;
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _numSleeping.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        _poolCondition.notify_all();
+
+        // A challenge or a taken ephemeral from before _numSleeping was raised did not wake anyone, so look once more before waiting
+        if (_jobs.size_approx() == 0 && (_ephemerals.size_approx() >= _poolSize || _hasRefillFailed))
+            _condition.wait(lock, [this]() { return _numWakeups > 0 || !_isRunning; });
+
+        if (_numWakeups > 0)
+            _numWakeups--;
+
+        _numSleeping.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
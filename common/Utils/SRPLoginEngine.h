@@ -0,0 +1,78 @@
+#pragma once
+#include "../NovusTypes.h"
+#include "ConcurrentQueue.h"
+#include "srp.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Runs the server side of SRP logins on a pool of workers instead of the thread that received the challenge.
+
+    Workers take challenges in batches and use ephemerals (b, g^b) from a pool, so a login costs the two exponentiations
+    that depend on the client and nothing else. Whenever there are no challenges the workers top the pool back up, a
+    restart can prefill it with Start before the first client connects. When the pool runs dry during a storm the
+    ephemeral is generated inline, which is still cheaper than a plain SRPVerifier through the group's fixed-base table.
+*/
+class SRPLoginEngine
+{
+public:
+    using Handler = std::function<void(std::shared_ptr<SRPVerifier>&, bool)>;
+
+    static constexpr size_t DEQUEUE_BULK_SIZE = 16;
+
+    // numWorkers of 0 means one worker per core
+    SRPLoginEngine(u32 numWorkers = 0, size_t poolSize = 4096);
+    ~SRPLoginEngine();
+
+    // With prefill the calling thread waits until the pool is full
+    void Start(bool prefill = false);
+    // Challenges that are still queued are not verified, their handlers are called with false instead
+    void Stop();
+
+    // The verifier needs its salt and verifier set, A is copied. The handler runs on a worker with whether verification started
+    void Enqueue(std::shared_ptr<SRPVerifier> verifier, const std::string& username, const u8* aBuffer, Handler handler);
+    // Runs on the calling thread, but still takes its ephemeral from the pool
+    bool StartVerification(SRPVerifier& verifier, const std::string& username, const u8* aBuffer);
+
+    size_t GetNumEphemerals() { return _ephemerals.size_approx(); }
+    size_t GetNumPending() { return _jobs.size_approx(); }
+    u64 GetNumLogins() { return _numLogins; }
+    u64 GetNumPoolMisses() { return _numPoolMisses; }
+
+private:
+    struct LoginJob
+    {
+        std::shared_ptr<SRPVerifier> verifier;
+        std::string username;
+        u8 a[256];
+        Handler handler;
+    };
+
+    std::unique_ptr<SRPEphemeral> TakeEphemeral();
+    bool RefillEphemeral();
+    void Wake();
+    void Run();
+
+    size_t _poolSize;
+    moodycamel::ConcurrentQueue<LoginJob> _jobs;
+    moodycamel::ConcurrentQueue<std::unique_ptr<SRPEphemeral>> _ephemerals;
+
+    std::vector<std::thread> _workers;
+    u32 _numWorkers;
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::condition_variable _poolCondition;
+    std::atomic<u32> _numSleeping;
+    u32 _numWakeups = 0; // Guarded by _mutex
+    std::atomic<bool> _isRunning;
+    std::atomic<bool> _hasRefillFailed;
+
+    std::atomic<u64> _numLogins;
+    std::atomic<u64> _numPoolMisses;
+};
@@ -38,20 +38,33 @@
 #include <openssl/sha.h>
 #include <openssl/crypto.h>
 #include <openssl/rand.h>
+#include <mutex>
 #include "srp.h"
 #include "../Math/sha256.h"
 
+// The fixed-base table covers exponents of up to this many bits in 4 bit windows, our ephemerals are 256 bits
+constexpr size_t SRP_FIXED_BASE_BITS = 256;
+constexpr size_t SRP_FIXED_BASE_WINDOWS = SRP_FIXED_BASE_BITS / 4;
+constexpr size_t SRP_FIXED_BASE_ENTRIES = 16;
+constexpr size_t SRP_FIXED_BASE_MAX_WORDS = 8192 / 64;
+
 NGConstant* SRPUtils::_ng = nullptr;
 bool SRPUtils::_randomInitialized = false;
 NGConstant* SRPUtils::GetNG(const SRP_NGType ngType /* = SRP_NGType::SRP_NG_2048 */)
 {
-    if (!_ng)
+    // Login workers can get here at the same time
+    static std::once_flag ngFlag;
+    std::call_once(ngFlag, [ngType]()
     {
-        _ng = new NGConstant();
+        NGConstant* ng = new NGConstant();
 
-        BN_hex2bn(&_ng->n, ngConstants[ngType].n.c_str());
-        BN_hex2bn(&_ng->g, ngConstants[ngType].g.c_str());
-    }
+        BN_hex2bn(&ng->n, ngConstants[ngType].n.c_str());
+        BN_hex2bn(&ng->g, ngConstants[ngType].g.c_str());
+
+        RandomInit();
+        PrepareNG(ng);
+        _ng = ng;
+    });
 
     return _ng;
 }
@@ -163,25 +176,15 @@ static BIGNUM* CalculateX(const BIGNUM* salt, const std::string& username, const
 }
 static void CalculateM(NGConstant* ng, u8* dest, const std::string I, const BIGNUM* s, const BIGNUM* A, const BIGNUM* B, const u8* K)
 {
-    u8 H_N[SHA256_DIGEST_LENGTH];
-    u8 H_g[SHA256_DIGEST_LENGTH];
     u8 H_I[SHA256_DIGEST_LENGTH];
-    u8 H_xor[SHA256_DIGEST_LENGTH];
-    i32 i = 0;
     i32 hash_len = SHA256_DIGEST_LENGTH;
 
-    HashNumber(ng->n, H_N);
-    HashNumber(ng->g, H_g);
-
     Sha256 hasher;
     hasher.Hash((const u8*)I.c_str(), I.length(), H_I);
 
-    for (i = 0; i < hash_len; i++)
-        H_xor[i] = H_N[i] ^ H_g[i];
-
     hasher.Init();
     {
-        hasher.Update(H_xor, hash_len);
+        hasher.Update(ng->hashNG, hash_len);
         hasher.Update(H_I, hash_len);
         UpdateHashNumber(hasher, s);
         UpdateHashNumber(hasher, A);
@@ -202,14 +205,149 @@ static void CalculateHAMK(u8* dest, const BIGNUM* A, const u8* M, const u8* K)
     hasher.Final(dest);
 }
 
+// Reads every entry of the window so the memory access pattern doesn't depend on the secret exponent
+static void SelectFixedBaseEntry(const u8* window, u32 digit, size_t entrySize, u8* dest)
+{
+    // Entries are padded to whole words, masking words instead of bytes keeps this cheap next to the multiplication
+    size_t numWords = entrySize / sizeof(u64);
+    u64 selected[SRP_FIXED_BASE_MAX_WORDS] = { 0 };
+
+    for (u32 i = 0; i < SRP_FIXED_BASE_ENTRIES; i++)
+    {
+        u64 mask = 0 - static_cast<u64>(i == digit);
+        const u8* entry = window + i * entrySize;
+
+        for (size_t j = 0; j < numWords; j++)
+        {
+            u64 word;
+            memcpy(&word, entry + j * sizeof(u64), sizeof(u64));
+            selected[j] |= word & mask;
+        }
+    }
+
+    memcpy(dest, selected, entrySize);
+}
+
 // Novuscore Wrappers
-NGConstant::NGConstant() : n(BN_new()), g(BN_new())
+NGConstant::NGConstant() : n(BN_new()), g(BN_new()), k(nullptr), montContext(nullptr)
 {
 }
 NGConstant::~NGConstant()
 {
     BN_free(n);
     BN_free(g);
+    BN_free(k);
+    BN_MONT_CTX_free(montContext);
+}
+
+SRPEphemeral::SRPEphemeral() : b(BN_new()), gb(BN_new())
+{
+}
+SRPEphemeral::~SRPEphemeral()
+{
+    BN_clear_free(b);
+    BN_free(gb);
+}
+bool SRPEphemeral::Generate()
+{
+    SRPUtils::GetNG();
+
+    if (!b || !gb || !BN_rand(b, 256, -1, 0))
+        return false;
+
+    // Picks the constant time path wherever b is used as an exponent
+    BN_set_flags(b, BN_FLG_CONSTTIME);
+    return SRPUtils::ModExpG(gb, b, SRPUtils::GetThreadContext());
+}
+
+BN_CTX* SRPUtils::GetThreadContext()
+{
+    thread_local std::unique_ptr<BN_CTX, decltype(&BN_CTX_free)> context(BN_CTX_new(), &BN_CTX_free);
+    return context.get();
+}
+void SRPUtils::PrepareNG(NGConstant* ng)
+{
+    BN_CTX* ctx = GetThreadContext();
+
+    ng->k = HashNumbers(ng->n, ng->n, ng->g);
+    ng->montContext = BN_MONT_CTX_new();
+    BN_MONT_CTX_set(ng->montContext, ng->n, ctx);
+
+    u8 hashN[SHA256_DIGEST_LENGTH];
+    u8 hashG[SHA256_DIGEST_LENGTH];
+    HashNumber(ng->n, hashN);
+    HashNumber(ng->g, hashG);
+
+    for (i32 i = 0; i < SHA256_DIGEST_LENGTH; i++)
+    {
+        ng->hashNG[i] = hashN[i] ^ hashG[i];
+    }
+
+    // Window i holds g^(j * 16^i) for every digit j, so g^b is one lookup per window and a multiplication between them
+    size_t entrySize = (static_cast<size_t>(BN_num_bytes(ng->n)) + sizeof(u64) - 1) & ~(sizeof(u64) - 1);
+    ng->fixedBaseSize = entrySize;
+    ng->fixedBaseTable.resize(SRP_FIXED_BASE_WINDOWS * SRP_FIXED_BASE_ENTRIES * entrySize);
+
+    BN_CTX_start(ctx);
+    BIGNUM* windowBase = BN_CTX_get(ctx);
+    BIGNUM* one = BN_CTX_get(ctx);
+    BIGNUM* entry = BN_CTX_get(ctx);
+
+    BN_to_montgomery(windowBase, ng->g, ng->montContext, ctx);
+    BN_one(one);
+    BN_to_montgomery(one, one, ng->montContext, ctx);
+
+    u8* tableEntry = ng->fixedBaseTable.data();
+    for (size_t i = 0; i < SRP_FIXED_BASE_WINDOWS; i++)
+    {
+        BN_copy(entry, one);
+        for (size_t j = 0; j < SRP_FIXED_BASE_ENTRIES; j++)
+        {
+            BN_bn2lebinpad(entry, tableEntry, static_cast<i32>(entrySize));
+            BN_mod_mul_montgomery(entry, entry, windowBase, ng->montContext, ctx);
+            tableEntry += entrySize;
+        }
+
+        // windowBase^16 is where the next window starts
+        BN_copy(windowBase, entry);
+    }
+
+    BN_CTX_end(ctx);
+}
+bool SRPUtils::ModExpG(BIGNUM* result, const BIGNUM* exponent, BN_CTX* ctx)
+{
+    NGConstant* ng = GetNG();
+    if (BN_is_negative(exponent) || static_cast<size_t>(BN_num_bits(exponent)) > SRP_FIXED_BASE_BITS)
+        return BN_mod_exp_mont(result, ng->g, exponent, ng->n, ctx, ng->montContext) == 1;
+
+    u8 exponentBytes[SRP_FIXED_BASE_BITS / 8];
+    BN_bn2lebinpad(exponent, exponentBytes, sizeof(exponentBytes));
+
+    size_t entrySize = ng->fixedBaseSize;
+    std::vector<u8> selected(entrySize);
+
+    BN_CTX_start(ctx);
+    BIGNUM* factor = BN_CTX_get(ctx);
+    bool isOk = factor != nullptr;
+
+    const u8* window = ng->fixedBaseTable.data();
+    for (size_t i = 0; i < SRP_FIXED_BASE_WINDOWS && isOk; i++)
+    {
+        u32 digit = (exponentBytes[i / 2] >> ((i & 1) * 4)) & 0xF;
+        SelectFixedBaseEntry(window, digit, entrySize, selected.data());
+        window += SRP_FIXED_BASE_ENTRIES * entrySize;
+
+        // Both stay in Montgomery form until the very end
+        if (i == 0)
+            isOk = BN_lebin2bn(selected.data(), static_cast<i32>(entrySize), result) != nullptr;
+        else
+            isOk = BN_lebin2bn(selected.data(), static_cast<i32>(entrySize), factor) != nullptr && BN_mod_mul_montgomery(result, result, factor, ng->montContext, ctx) == 1;
+    }
+
+    isOk = isOk && BN_from_montgomery(result, result, ng->montContext, ctx) == 1;
+
+    BN_CTX_end(ctx);
+    return isOk;
 }
 
 void SRPUtils::CreateAccount(const std::string& username, const std::string& password, Bytebuffer* sBuffer, Bytebuffer* vBuffer)
@@ -401,29 +539,46 @@ SRPVerifier::SRPVerifier() : authenticated(0), username()
 }
 bool SRPVerifier::StartVerification(const std::string& inUsername, const u8* aBuffer)
 {
-    NGConstant* ng = SRPUtils::GetNG();
+    SRPEphemeral ephemeral;
+    if (!ephemeral.Generate())
+        return false;
 
-    BIGNUM* s = BN_bin2bn(saltBuffer->GetDataPointer(), static_cast<i32>(saltBuffer->size), nullptr);
-    BIGNUM* v = BN_bin2bn(verifierBuffer->GetDataPointer(), static_cast<i32>(verifierBuffer->size), nullptr);
-    BIGNUM* A = BN_bin2bn(aBuffer, 256, nullptr);
-    BIGNUM* k = nullptr;
-    BIGNUM* u = nullptr;
-    BIGNUM* B = BN_new();
-    BIGNUM* S = BN_new();
-    BIGNUM* b = BN_new();
-    BIGNUM* tmp1 = BN_new();
-    BIGNUM* tmp2 = BN_new();
-    BN_CTX* ctx = BN_CTX_new();
+    return StartVerification(inUsername, aBuffer, ephemeral);
+}
+bool SRPVerifier::StartVerification(const std::string& inUsername, const u8* aBuffer, const SRPEphemeral& ephemeral)
+{
+    NGConstant* ng = SRPUtils::GetNG();
+    BN_CTX* ctx = SRPUtils::GetThreadContext();
 
     username = inUsername;
 
-    if (!s || !v || !A || !B || !S || !b || !tmp1 || !tmp2 || !ctx || !ng)
+    if (!ctx || !ng)
     {
-        assert(s && v && A && B && S && b && tmp1 && tmp2 && ctx && ng);
+        assert(ctx && ng);
         return false;
     }
 
-    SRPUtils::RandomInit();
+    // Every temporary comes from the thread's BN_CTX, this releases all of them whichever way we return
+    struct ContextFrame
+    {
+        ContextFrame(BN_CTX* inCtx) : ctx(inCtx) { BN_CTX_start(ctx); }
+        ~ContextFrame() { BN_CTX_end(ctx); }
+        BN_CTX* ctx;
+    } frame(ctx);
+
+    BIGNUM* s = BN_bin2bn(saltBuffer->GetDataPointer(), static_cast<i32>(saltBuffer->size), BN_CTX_get(ctx));
+    BIGNUM* v = BN_bin2bn(verifierBuffer->GetDataPointer(), static_cast<i32>(verifierBuffer->size), BN_CTX_get(ctx));
+    BIGNUM* A = BN_bin2bn(aBuffer, 256, BN_CTX_get(ctx));
+    BIGNUM* B = BN_CTX_get(ctx);
+    BIGNUM* S = BN_CTX_get(ctx);
+    BIGNUM* tmp1 = BN_CTX_get(ctx);
+    BIGNUM* tmp2 = BN_CTX_get(ctx);
+
+    if (!s || !v || !A || !tmp2)
+    {
+        assert(s && v && A && tmp2);
+        return false;
+    }
 
     // SRP-6a safety check
     BN_mod(tmp1, A, ng->n, ctx);
@@ -433,21 +588,11 @@ bool SRPVerifier::StartVerification(const std::string& inUsername, const u8* aBu
         return false;
     }
 
-    BN_rand(b, 256, -1, 0);
-
-    k = HashNumbers(ng->n, ng->n, ng->g);
-    if (!k)
-    {
-        assert(k);
-        return false;
-    }
-
     /* B = kv + g^b */
-    BN_mod_mul(tmp1, k, v, ng->n, ctx);
-    BN_mod_exp(tmp2, ng->g, b, ng->n, ctx);
-    BN_mod_add(B, tmp1, tmp2, ng->n, ctx);
+    BN_mod_mul(tmp1, ng->k, v, ng->n, ctx);
+    BN_mod_add(B, tmp1, ephemeral.gb, ng->n, ctx);
 
-    u = HashNumbers(ng->n, A, B);
+    BIGNUM* u = HashNumbers(ng->n, A, B);
     if (!u)
     {
         assert(u);
@@ -455,9 +600,10 @@ bool SRPVerifier::StartVerification(const std::string& inUsername, const u8* aBu
     }
 
     /* S = (A *(v^u)) ^ b */
-    BN_mod_exp(tmp1, v, u, ng->n, ctx);
-    BN_mul(tmp2, A, tmp1, ctx);
-    BN_mod_exp(S, tmp2, b, ng->n, ctx);
+    BN_mod_exp_mont(tmp1, v, u, ng->n, ctx, ng->montContext);
+    BN_mod_mul(tmp2, A, tmp1, ng->n, ctx);
+    BN_mod_exp_mont(S, tmp2, ephemeral.b, ng->n, ctx, ng->montContext);
+    BN_free(u);
 
     HashNumber(S, session_key);
 
@@ -476,18 +622,6 @@ bool SRPVerifier::StartVerification(const std::string& inUsername, const u8* aBu
     }
 
     BN_bn2bin(B, bBuffer->GetDataPointer());
-
-    BN_free(s);
-    BN_free(v);
-    BN_free(A);
-    BN_free(k);
-    BN_free(u);
-    BN_free(B);
-    BN_free(S);
-    BN_free(b);
-    BN_free(tmp1);
-    BN_free(tmp2);
-    BN_CTX_free(ctx);
     return true;
 }
 bool SRPVerifier::VerifySession(const u8* inM)
@@ -57,6 +57,7 @@
 #pragma once
 #include <string>
 #include <memory>
+#include <vector>
 #include "ByteBuffer.h"
 
 enum SRP_NGType
@@ -70,6 +71,10 @@ enum SRP_NGType
 
 struct bignum_st;
 typedef struct bignum_st BIGNUM;
+struct bignum_ctx;
+typedef struct bignum_ctx BN_CTX;
+struct bn_mont_ctx_st;
+typedef struct bn_mont_ctx_st BN_MONT_CTX;
 struct NGConstant
 {
     NGConstant();
@@ -77,6 +82,27 @@ struct NGConstant
 
     BIGNUM* n;
     BIGNUM* g;
+
+    // Everything below only depends on the group, SRPUtils::GetNG computes it once
+    BIGNUM* k;
+    BN_MONT_CTX* montContext;
+    u8 hashNG[32] = { 0 }; // H(N) xor H(g)
+
+    // g^(j * 16^i) in Montgomery form for every 4 bit window i of a 256 bit exponent, see SRPUtils::ModExpG
+    std::vector<u8> fixedBaseTable;
+    size_t fixedBaseSize = 0;
+};
+
+// The server's private b and public g^b, they don't depend on the client so they can be generated ahead of a login
+struct SRPEphemeral
+{
+    SRPEphemeral();
+    ~SRPEphemeral();
+
+    bool Generate();
+
+    BIGNUM* b;
+    BIGNUM* gb;
 };
 
 struct NGHex
@@ -185,7 +211,14 @@ public:
     static NGConstant* GetNG(const SRP_NGType ngType = SRP_NGType::SRP_NG_2048);
     static void CreateAccount(const std::string& username, const std::string& password, Bytebuffer* sBuffer, Bytebuffer* vBuffer);
     static void RandomInit();
+
+    // g^exponent mod N through the fixed-base table of the group, exponents of up to 256 bits only
+    static bool ModExpG(BIGNUM* result, const BIGNUM* exponent, BN_CTX* ctx);
+    // BN_CTX isn't thread safe, every thread keeps its own for as long as it lives
+    static BN_CTX* GetThreadContext();
 private:
+    static void PrepareNG(NGConstant* ng);
+
     static NGConstant* _ng;
     static bool _randomInitialized;
 };
@@ -224,6 +257,8 @@ public:
     SRPVerifier();
 
     bool StartVerification(const std::string& inUsername, const u8* aBuffer);
+    // Same as above with an ephemeral that was generated up front, see SRPLoginEngine
+    bool StartVerification(const std::string& inUsername, const u8* aBuffer, const SRPEphemeral& ephemeral);
 
     /* inM must be exactly SHA256_DIGEST_LENGTH bytes in size */
     bool VerifySession(const u8* inM);
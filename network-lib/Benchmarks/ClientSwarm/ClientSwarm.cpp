@@ -0,0 +1,316 @@
+#include "ClientSwarm.h"
+#include <Networking/NetworkPacket.h>
+#include <Utils/DebugHandler.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+// Bounds what a server that never answers movement can make us hold on to
+constexpr size_t SWARM_MAX_PENDING_MOVES = 1024;
+
+u32 LatencyHistogram::GetPercentile(f64 percentile)
+{
+    if (_samples.empty())
+        return 0;
+
+    if (!_isSorted)
+    {
+        std::sort(_samples.begin(), _samples.end());
+        _isSorted = true;
+    }
+
+    size_t index = static_cast<size_t>(percentile * (_samples.size() - 1) + 0.5);
+    return _samples[std::min(index, _samples.size() - 1)];
+}
+
+void ClientSwarmReport::Print()
+{
+    DebugHandler::Print("[ClientSwarm]: %u/%u clients connected in %.2fs (%.0f connections/s), %u logged in, %u failed to log in",
+        numConnected, numConnected + numFailedConnects, connectSeconds, connectSeconds > 0 ? numConnected / connectSeconds : 0.0, numLoggedIn, numFailedLogins);
+    DebugHandler::Print("[ClientSwarm]: %llu packets sent (%.0f/s), %llu packets received (%.0f/s) over %.2fs",
+        static_cast<unsigned long long>(packetsSent), runSeconds > 0 ? packetsSent / runSeconds : 0.0, static_cast<unsigned long long>(packetsReceived), runSeconds > 0 ? packetsReceived / runSeconds : 0.0, runSeconds);
+
+    DebugHandler::Print("[ClientSwarm]: Login round trip p50 %.3fms p99 %.3fms p999 %.3fms (%zu samples)",
+        loginLatency.GetPercentile(0.5) / 1000.0, loginLatency.GetPercentile(0.99) / 1000.0, loginLatency.GetPercentile(0.999) / 1000.0, loginLatency.GetCount());
+    DebugHandler::Print("[ClientSwarm]: Move round trip p50 %.3fms p99 %.3fms p999 %.3fms (%zu samples)",
+        moveLatency.GetPercentile(0.5) / 1000.0, moveLatency.GetPercentile(0.99) / 1000.0, moveLatency.GetPercentile(0.999) / 1000.0, moveLatency.GetCount());
+}
+
+ClientSwarm::ClientSwarm(std::shared_ptr<NetworkEngine> engine, ClientSwarmConfig config) : _engine(engine), _config(config)
+{
+    if (!_config.writeMove)
+    {
+        _config.writeMove = [](std::shared_ptr<Bytebuffer>& buffer, u32 clientIndex, u32 sequence)
+        {
+            // Every client walks its own circle so the server sees plausible, changing positions
+            f32 angle = (clientIndex * 0.618f + sequence * 0.05f);
+            vec3 position(std::cos(angle) * 100.0f, std::sin(angle) * 100.0f, 0.0f);
+
+            buffer->PutU32(1);
+            buffer->Put<vec3>(position);
+            buffer->PutF32(angle);
+        };
+    }
+}
+
+ClientSwarmReport ClientSwarm::Run()
+{
+    ClientSwarmReport report;
+
+    _isRunning = true;
+    _clients.reserve(_config.numClients);
+
+    Clock::time_point connectStart = Clock::now();
+    for (u32 i = 0; i < _config.numClients; i++)
+    {
+        if (_config.connectsPerSecond > 0)
+            std::this_thread::sleep_until(connectStart + std::chrono::microseconds(static_cast<u64>(i) * 1000000 / _config.connectsPerSecond));
+
+        _clients.push_back(std::make_unique<SwarmClient>());
+        SwarmClient& client = *_clients.back();
+        client.index = i;
+
+        Connect(client);
+    }
+
+    // Connects are all in flight at once, a login storm is only paced by connectsPerSecond
+    while (_numConnected + _numFailedConnects < _config.numClients)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    report.numConnected = _numConnected;
+    report.numFailedConnects = _numFailedConnects;
+    report.connectSeconds = std::chrono::duration<f64>(Clock::now() - connectStart).count();
+
+    Clock::time_point runStart = Clock::now();
+    u64 packetsSentAtStart = _packetsSent;
+    u64 packetsReceivedAtStart = _packetsReceived;
+
+    std::this_thread::sleep_for(std::chrono::seconds(_config.durationSeconds));
+    _isRunning = false;
+
+    report.runSeconds = std::chrono::duration<f64>(Clock::now() - runStart).count();
+    report.packetsSent = _packetsSent - packetsSentAtStart;
+    report.packetsReceived = _packetsReceived - packetsReceivedAtStart;
+
+    // Give replies that are already on their way a moment to arrive before we hang up
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (std::unique_ptr<SwarmClient>& client : _clients)
+    {
+        if (!client->connection)
+            continue;
+
+        std::shared_ptr<NetworkClient> connection = client->connection;
+        asio::steady_timer* moveTimer = client->moveTimer.get();
+        asio::post(connection->socket()->get_executor(), [connection, moveTimer]()
+        {
+            moveTimer->cancel();
+            connection->Close(asio::error::operation_aborted);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    report.numLoggedIn = _numLoggedIn;
+    report.numFailedLogins = _numFailedLogins;
+    for (std::unique_ptr<SwarmClient>& client : _clients)
+    {
+        std::lock_guard<std::mutex> lock(client->mutex);
+        report.loginLatency.Merge(client->loginLatency);
+        report.moveLatency.Merge(client->moveLatency);
+    }
+
+    return report;
+}
+
+void ClientSwarm::Connect(SwarmClient& client)
+{
+    asio::io_context& context = _engine->GetContext(_engine->NextContextIndex());
+
+    client.connection = std::make_shared<NetworkClient>(new asio::ip::tcp::socket(context));
+    client.connection->SetReadHandler(std::bind(&ClientSwarm::_internalRead, this, &client, std::placeholders::_1, std::placeholders::_2));
+    client.moveTimer = std::make_unique<asio::steady_timer>(context);
+
+    std::string username = _config.uniqueUsernames ? _config.username + std::to_string(client.index) : _config.username;
+    client.srp = std::make_unique<SRPUser>(username, _config.password);
+
+    client.connection->AsyncConnect(_config.address, _config.port, _config.connectTimeout, std::bind(&ClientSwarm::_internalConnect, this, &client, std::placeholders::_1, std::placeholders::_2));
+}
+void ClientSwarm::SendChallenge(SwarmClient& client)
+{
+    client.srp->StartAuthentication();
+
+    ClientLogonChallenge challenge;
+    challenge.majorVersion = 0;
+    challenge.patchVersion = 0;
+    challenge.minorVersion = 0;
+    challenge.buildType = BuildType::Internal;
+    challenge.gameBuild = 0;
+    challenge.gameName = "NovusCore";
+    challenge.username = client.srp->username;
+
+    std::shared_ptr<Bytebuffer> buffer = Bytebuffer::Borrow<1024>();
+    buffer->SkipWrite(sizeof(PacketHeader));
+
+    PacketHeader header;
+    header.opcode = Opcode::CMSG_LOGON_CHALLENGE;
+    header.size = challenge.Serialize(buffer, client.srp->aBuffer);
+    buffer->Put<PacketHeader>(header, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(client.mutex);
+        client.state = SwarmClientState::CHALLENGE;
+        client.requestSentAt = Clock::now();
+    }
+
+    client.connection->Send(buffer);
+    _packetsSent++;
+}
+void ClientSwarm::SendMove(SwarmClient& client)
+{
+    std::shared_ptr<Bytebuffer> buffer = Bytebuffer::Borrow<1024>();
+    buffer->SkipWrite(sizeof(PacketHeader));
+
+    _config.writeMove(buffer, client.index, client.moveSequence++);
+
+    PacketHeader header;
+    header.opcode = Opcode::MSG_MOVE_ENTITY;
+    header.size = static_cast<u16>(buffer->writtenData - sizeof(PacketHeader));
+    buffer->Put<PacketHeader>(header, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(client.mutex);
+        if (client.pendingMoves.size() == SWARM_MAX_PENDING_MOVES)
+            client.pendingMoves.pop_front();
+
+        client.pendingMoves.push_back(Clock::now());
+    }
+
+    client.connection->Send(buffer);
+    _packetsSent++;
+}
+void ClientSwarm::ScheduleMove(SwarmClient& client, Clock::duration delay)
+{
+    client.moveTimer->expires_after(delay);
+    client.moveTimer->async_wait(std::bind(&ClientSwarm::_internalMoveTimer, this, &client, std::placeholders::_1));
+}
+void ClientSwarm::Fail(SwarmClient& client)
+{
+    client.state = SwarmClientState::FAILED;
+    _numFailedLogins++;
+
+    client.connection->Close(asio::error::access_denied);
+}
+
+void ClientSwarm::_internalConnect(SwarmClient* client, NetworkClient* /*connection*/, const asio::error_code& error)
+{
+    if (error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(client->mutex);
+            client->state = SwarmClientState::FAILED;
+        }
+
+        _numFailedConnects++;
+        return;
+    }
+
+    _numConnected++;
+    SendChallenge(*client);
+}
+void ClientSwarm::_internalRead(SwarmClient* client, BaseSocket* socket, BaseSocket::PacketBatch& batch)
+{
+    Clock::time_point now = Clock::now();
+
+    for (std::shared_ptr<NetworkPacket>& packet : batch)
+    {
+        _packetsReceived++;
+
+        std::lock_guard<std::mutex> lock(client->mutex);
+        u32 latency = static_cast<u32>(std::chrono::duration_cast<std::chrono::microseconds>(now - client->requestSentAt).count());
+
+        switch (packet->header.opcode)
+        {
+            case Opcode::SMSG_LOGON_CHALLENGE:
+            {
+                ServerLogonChallenge challenge;
+                challenge.Deserialize(packet->payload);
+
+                if (client->state != SwarmClientState::CHALLENGE || challenge.status != 0 || !client->srp->ProcessChallenge(challenge.s, challenge.B))
+                {
+                    Fail(*client);
+                    return;
+                }
+                client->loginLatency.Add(latency);
+
+                ClientLogonHandshake handshake;
+                std::memcpy(handshake.M1, client->srp->M, sizeof(handshake.M1));
+
+                std::shared_ptr<Bytebuffer> buffer = Bytebuffer::Borrow<128>();
+                buffer->SkipWrite(sizeof(PacketHeader));
+
+                PacketHeader header;
+                header.opcode = Opcode::CMSG_LOGON_HANDSHAKE;
+                header.size = handshake.Serialize(buffer);
+                buffer->Put<PacketHeader>(header, 0);
+
+                client->state = SwarmClientState::HANDSHAKE;
+                client->requestSentAt = Clock::now();
+                client->connection->Send(buffer);
+                _packetsSent++;
+                break;
+            }
+            case Opcode::SMSG_LOGON_HANDSHAKE:
+            {
+                ServerLogonHandshake handshake;
+                handshake.Deserialize(packet->payload);
+
+                if (client->state != SwarmClientState::HANDSHAKE || !client->srp->VerifySession(handshake.HAMK))
+                {
+                    Fail(*client);
+                    return;
+                }
+                client->loginLatency.Add(latency);
+
+                client->state = SwarmClientState::MOVING;
+                _numLoggedIn++;
+
+                // Spread the first move over one interval so the clients don't all send in lockstep
+                std::chrono::nanoseconds interval(static_cast<u64>(1e9 / std::max(_config.movesPerSecond, 0.001f)));
+                std::uniform_int_distribution<u64> phase(0, interval.count());
+                std::minstd_rand random(client->index);
+                ScheduleMove(*client, std::chrono::nanoseconds(phase(random)));
+                break;
+            }
+            case Opcode::MSG_MOVE_ENTITY:
+            {
+                if (client->pendingMoves.empty())
+                    break;
+
+                u32 moveLatency = static_cast<u32>(std::chrono::duration_cast<std::chrono::microseconds>(now - client->pendingMoves.front()).count());
+                client->pendingMoves.pop_front();
+                client->moveLatency.Add(moveLatency);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    socket->AsyncRead();
+}
+void ClientSwarm::_internalMoveTimer(SwarmClient* client, const asio::error_code& error)
+{
+    if (error || !_isRunning || client->state != SwarmClientState::MOVING)
+        return;
+
+    SendMove(*client);
+
+    // Scheduled from the previous deadline so the rate holds even when a handler runs late
+    std::chrono::nanoseconds interval(static_cast<u64>(1e9 / std::max(_config.movesPerSecond, 0.001f)));
+    client->moveTimer->expires_at(client->moveTimer->expiry() + interval);
+    client->moveTimer->async_wait(std::bind(&ClientSwarm::_internalMoveTimer, this, client, std::placeholders::_1));
+}
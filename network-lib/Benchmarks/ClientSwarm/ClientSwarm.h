@@ -0,0 +1,133 @@
+#pragma once
+#include <NovusTypes.h>
+#include <Utils/srp.h>
+#include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <Networking/NetworkClient.h>
+#include <Networking/NetworkEngine.h>
+
+struct ClientSwarmConfig
+{
+    u32 address = 0x7F000001; // 127.0.0.1
+    u16 port = 0;
+
+    u32 numClients = 100;
+    u32 connectsPerSecond = 0; // 0 connects as fast as possible
+    std::chrono::milliseconds connectTimeout = std::chrono::milliseconds(5000);
+    f32 movesPerSecond = 10.0f; // Per client, once logged in
+    u32 durationSeconds = 10; // Counted from the moment every client has connected
+
+    // Every client logs in with the same account unless uniqueUsernames appends the client index
+    std::string username = "swarm";
+    std::string password = "swarm";
+    bool uniqueUsernames = false;
+
+    // Writes the MSG_MOVE_ENTITY payload, defaults to movement flags, position and orientation
+    std::function<void(std::shared_ptr<Bytebuffer>&, u32 clientIndex, u32 sequence)> writeMove;
+};
+
+// Keeps every sample, a swarm run produces few enough of them that exact percentiles are affordable
+class LatencyHistogram
+{
+public:
+    void Add(u32 microseconds) { _samples.push_back(microseconds); }
+    void Merge(const LatencyHistogram& other) { _samples.insert(_samples.end(), other._samples.begin(), other._samples.end()); }
+
+    size_t GetCount() const { return _samples.size(); }
+    // Sorts on first use after samples were added, percentile is in [0, 1]
+    u32 GetPercentile(f64 percentile);
+
+private:
+    std::vector<u32> _samples;
+    bool _isSorted = false;
+};
+
+struct ClientSwarmReport
+{
+    u32 numConnected = 0;
+    u32 numFailedConnects = 0;
+    u32 numLoggedIn = 0;
+    u32 numFailedLogins = 0;
+    f64 connectSeconds = 0; // Time it took to connect every client
+    f64 runSeconds = 0;
+
+    u64 packetsSent = 0;
+    u64 packetsReceived = 0;
+
+    LatencyHistogram loginLatency; // CMSG_LOGON_CHALLENGE and CMSG_LOGON_HANDSHAKE round trips
+    LatencyHistogram moveLatency; // MSG_MOVE_ENTITY round trips
+
+    void Print();
+};
+
+/*
+    Headless load generator, opens numClients connections to a server, runs the full SRP login on each of them and then
+    sends MSG_MOVE_ENTITY at a fixed rate per client.
+
+    Move latency is measured against the MSG_MOVE_ENTITY packets the server sends back, in order. Against a server that
+    doesn't answer movement only throughput is reported.
+*/
+class ClientSwarm
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ClientSwarm(std::shared_ptr<NetworkEngine> engine, ClientSwarmConfig config);
+
+    // Blocks until the run is over, the engine must have been started
+    ClientSwarmReport Run();
+
+private:
+    enum class SwarmClientState : u8
+    {
+        CONNECTING,
+        CHALLENGE,
+        HANDSHAKE,
+        MOVING,
+        FAILED
+    };
+    struct SwarmClient
+    {
+        u32 index = 0;
+        SwarmClientState state = SwarmClientState::CONNECTING;
+        std::shared_ptr<NetworkClient> connection;
+        std::unique_ptr<SRPUser> srp;
+        std::unique_ptr<asio::steady_timer> moveTimer;
+
+        std::mutex mutex;
+        Clock::time_point requestSentAt;
+        std::deque<Clock::time_point> pendingMoves;
+        u32 moveSequence = 0;
+        LatencyHistogram loginLatency;
+        LatencyHistogram moveLatency;
+    };
+
+    void Connect(SwarmClient& client);
+    void SendChallenge(SwarmClient& client);
+    void SendMove(SwarmClient& client);
+    void ScheduleMove(SwarmClient& client, Clock::duration delay);
+    void Fail(SwarmClient& client);
+
+    void _internalConnect(SwarmClient* client, NetworkClient* connection, const asio::error_code& error);
+    void _internalRead(SwarmClient* client, BaseSocket* socket, BaseSocket::PacketBatch& batch);
+    void _internalMoveTimer(SwarmClient* client, const asio::error_code& error);
+
+    std::shared_ptr<NetworkEngine> _engine;
+    ClientSwarmConfig _config;
+    std::vector<std::unique_ptr<SwarmClient>> _clients;
+
+    std::atomic<bool> _isRunning = false;
+    std::atomic<u32> _numConnected = 0;
+    std::atomic<u32> _numFailedConnects = 0;
+    std::atomic<u32> _numLoggedIn = 0;
+    std::atomic<u32> _numFailedLogins = 0;
+    std::atomic<u64> _packetsSent = 0;
+    std::atomic<u64> _packetsReceived = 0;
+};
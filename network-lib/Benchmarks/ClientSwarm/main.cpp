@@ -0,0 +1,198 @@
+#include "ClientSwarm.h"
+#include <Networking/MessageHandler.h>
+#include <Networking/NetworkPacket.h>
+#include <Networking/NetworkServer.h>
+#include <Utils/DebugHandler.h>
+#include <robin_hood.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+/*
+    Runs a ClientSwarm against a login server inside the same process, so a run measures nothing but the network library
+    and the SRP login on both ends.
+
+    Usage: ClientSwarm [numClients] [durationSeconds] [movesPerSecond] [connectsPerSecond]
+
+    The server answers the login of the default swarm account and echoes every MSG_MOVE_ENTITY, which is what the swarm
+    measures its move round trips against.
+*/
+
+static MessageHandler messageHandler;
+
+// Every swarm client logs in with the same account, its salt and verifier are created once up front
+static std::shared_ptr<Bytebuffer> accountSalt;
+static std::shared_ptr<Bytebuffer> accountVerifier;
+
+static std::mutex verifierMutex;
+static robin_hood::unordered_map<u64, std::shared_ptr<SRPVerifier>> verifiers;
+
+static bool HandleLogonChallenge(std::shared_ptr<NetworkClient> client, std::shared_ptr<NetworkPacket>& packet)
+{
+    ClientLogonChallenge challenge;
+    challenge.Deserialize(packet->payload);
+
+    std::shared_ptr<SRPVerifier> verifier = std::make_shared<SRPVerifier>();
+    verifier->saltBuffer = accountSalt;
+    verifier->verifierBuffer = accountVerifier;
+
+    ServerLogonChallenge response;
+    response.status = verifier->StartVerification(challenge.username, challenge.A) ? 0 : 1;
+    if (response.status == 0)
+    {
+        // B is sent as a fixed 256 bytes, a shorter number is padded at the front
+        std::memset(response.B, 0, sizeof(response.B));
+        std::memcpy(response.B + sizeof(response.B) - verifier->bBuffer->size, verifier->bBuffer->GetDataPointer(), verifier->bBuffer->size);
+        std::memcpy(response.s, accountSalt->GetDataPointer(), sizeof(response.s));
+
+        std::lock_guard<std::mutex> lock(verifierMutex);
+        verifiers[client->GetHandle().ToU64()] = verifier;
+    }
+
+    std::shared_ptr<Bytebuffer> buffer = Bytebuffer::Borrow<512>();
+    buffer->SkipWrite(sizeof(PacketHeader));
+
+    PacketHeader header;
+    header.opcode = Opcode::SMSG_LOGON_CHALLENGE;
+    header.size = response.Serialize(buffer);
+    buffer->Put<PacketHeader>(header, 0);
+
+    client->SetStatus(ConnectionStatus::AUTH_HANDSHAKE);
+    client->Send(buffer);
+    return response.status == 0;
+}
+static bool HandleLogonHandshake(std::shared_ptr<NetworkClient> client, std::shared_ptr<NetworkPacket>& packet)
+{
+    std::shared_ptr<SRPVerifier> verifier;
+    {
+        std::lock_guard<std::mutex> lock(verifierMutex);
+
+        auto itr = verifiers.find(client->GetHandle().ToU64());
+        if (itr == verifiers.end())
+            return false;
+
+        verifier = itr->second;
+        verifiers.erase(itr);
+    }
+
+    ClientLogonHandshake handshake;
+    handshake.Deserialize(packet->payload);
+
+    if (!verifier->VerifySession(handshake.M1))
+        return false;
+
+    ServerLogonHandshake response;
+    std::memcpy(response.HAMK, verifier->HAMK, sizeof(response.HAMK));
+
+    std::shared_ptr<Bytebuffer> buffer = Bytebuffer::Borrow<128>();
+    buffer->SkipWrite(sizeof(PacketHeader));
+
+    PacketHeader header;
+    header.opcode = Opcode::SMSG_LOGON_HANDSHAKE;
+    header.size = response.Serialize(buffer);
+    buffer->Put<PacketHeader>(header, 0);
+
+    client->SetStatus(ConnectionStatus::AUTH_SUCCESS);
+    client->Send(buffer);
+    return true;
+}
+static bool HandleMove(std::shared_ptr<NetworkClient> client, std::shared_ptr<NetworkPacket>& packet)
+{
+    // Same pool the swarm sends its moves from, MSG_MOVE_ENTITY is registered with a max size that fits it
+    std::shared_ptr<Bytebuffer> buffer = Bytebuffer::Borrow<1024>();
+    buffer->Put<PacketHeader>(packet->header);
+    buffer->PutBytes(packet->payload->GetDataPointer(), packet->header.size);
+
+    client->Send(buffer);
+    return true;
+}
+
+static void HandleRead(BaseSocket* socket, BaseSocket::PacketBatch& batch)
+{
+    std::shared_ptr<NetworkClient> client = std::static_pointer_cast<NetworkClient>(socket->shared_from_this());
+    for (std::shared_ptr<NetworkPacket>& packet : batch)
+    {
+        if (!messageHandler.CallHandler(client, packet))
+        {
+            client->Close(asio::error::connection_aborted);
+            return;
+        }
+    }
+
+    socket->AsyncRead();
+}
+static void HandleDisconnect(BaseSocket* socket)
+{
+    NetworkClient* client = static_cast<NetworkClient*>(socket);
+
+    std::lock_guard<std::mutex> lock(verifierMutex);
+    verifiers.erase(client->GetHandle().ToU64());
+}
+static void HandleConnection(NetworkServer* server, asio::ip::tcp::socket* socket, const asio::error_code& error)
+{
+    if (error)
+    {
+        delete socket;
+        return;
+    }
+
+    std::shared_ptr<NetworkClient> client = std::make_shared<NetworkClient>(socket);
+    client->SetReadHandler(std::bind(&HandleRead, std::placeholders::_1, std::placeholders::_2));
+    client->SetDisconnectHandler(std::bind(&HandleDisconnect, std::placeholders::_1));
+
+    server->AddConnection(client);
+    client->Listen();
+}
+
+static u32 GetArgument(int argc, char* argv[], int index, u32 defaultValue)
+{
+    return index < argc ? static_cast<u32>(std::strtoul(argv[index], nullptr, 10)) : defaultValue;
+}
+
+int main(int argc, char* argv[])
+{
+    ClientSwarmConfig config;
+    config.numClients = GetArgument(argc, argv, 1, config.numClients);
+    config.durationSeconds = GetArgument(argc, argv, 2, config.durationSeconds);
+    config.movesPerSecond = static_cast<f32>(GetArgument(argc, argv, 3, static_cast<u32>(config.movesPerSecond)));
+    config.connectsPerSecond = GetArgument(argc, argv, 4, config.connectsPerSecond);
+
+    // The challenge always carries a 4 byte salt, so keep going until the random one doesn't start with a zero byte
+    do
+    {
+        accountSalt = Bytebuffer::Borrow<4>();
+        accountVerifier = Bytebuffer::Borrow<256>();
+        SRPUtils::CreateAccount(config.username, config.password, accountSalt.get(), accountVerifier.get());
+    } while (accountSalt->size != 4);
+
+    messageHandler.SetMessageHandler(Opcode::CMSG_LOGON_CHALLENGE, OpcodeHandler(ConnectionStatus::AUTH_NONE, sizeof(ClientLogonChallenge::A), -1, HandleLogonChallenge));
+    messageHandler.SetMessageHandler(Opcode::CMSG_LOGON_HANDSHAKE, OpcodeHandler(ConnectionStatus::AUTH_HANDSHAKE, sizeof(ClientLogonHandshake), HandleLogonHandshake));
+    messageHandler.SetMessageHandler(Opcode::MSG_MOVE_ENTITY, OpcodeHandler(ConnectionStatus::AUTH_SUCCESS, 0, 1024 - sizeof(PacketHeader), HandleMove));
+
+    // The server and the swarm get their own threads so neither one slows the other down
+    u32 numContexts = std::max(std::thread::hardware_concurrency() / 2, 1u);
+    std::shared_ptr<NetworkEngine> serverEngine = std::make_shared<NetworkEngine>(numContexts, ConnectionDistribution::ROUND_ROBIN, false);
+    std::shared_ptr<NetworkEngine> swarmEngine = std::make_shared<NetworkEngine>(numContexts, ConnectionDistribution::ROUND_ROBIN, false);
+    serverEngine->Start();
+    swarmEngine->Start();
+
+    NetworkServer server(serverEngine, 0);
+    server.SetConnectionHandler(std::bind(&HandleConnection, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    server.Start();
+
+    config.address = 0x7F000001;
+    config.port = server.GetPort();
+
+    DebugHandler::Print("[ClientSwarm]: %u clients against port %u for %us, %.1f moves/s each", config.numClients, config.port, config.durationSeconds, config.movesPerSecond);
+
+    ClientSwarm swarm(swarmEngine, config);
+    ClientSwarmReport report = swarm.Run();
+    report.Print();
+
+    server.Stop();
+    swarmEngine->Stop();
+    serverEngine->Stop();
+    return 0;
+}
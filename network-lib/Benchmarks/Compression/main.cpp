@@ -0,0 +1,181 @@
+#include <Networking/PacketCompressor.h>
+#include <Networking/ServerDirectory.h>
+#include <Utils/DebugHandler.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+    Streams packets shaped like our large opcodes through one PacketCompressor and inflates them again with another, the
+    same way the two ends of a connection would, and reports bytes saved against CPU spent per opcode.
+
+    Usage: CompressionBenchmark [packetsPerOpcode]
+
+    Every packet of an opcode differs from the one before it the way the real traffic does, a few fields change and
+    the rest repeats, so the report includes what the shared window saves across packets. SMSG_UPDATE_ENTITY is random
+    data and shows what a packet that doesn't compress costs.
+*/
+
+using Clock = std::chrono::steady_clock;
+using PayloadWriter = std::function<void(std::vector<u8>& payload, u32 packetIndex)>;
+
+struct BenchmarkOpcode
+{
+    const char* name;
+    Opcode opcode;
+    PayloadWriter writePayload;
+};
+
+static std::mt19937 generator(1337);
+
+template <typename T>
+static void Append(std::vector<u8>& payload, const T& value)
+{
+    const u8* bytes = reinterpret_cast<const u8*>(&value);
+    payload.insert(payload.end(), bytes, bytes + sizeof(T));
+}
+static void AppendString(std::vector<u8>& payload, const std::string& value)
+{
+    payload.insert(payload.end(), value.begin(), value.end());
+    payload.push_back(0);
+}
+
+// 64 realms with a name, an address and a population that changes between packets
+static void WriteRealmlist(std::vector<u8>& payload, u32 /*packetIndex*/)
+{
+    for (u8 i = 0; i < 64; i++)
+    {
+        Append<u8>(payload, i);
+        AppendString(payload, "Realm " + std::to_string(i) + (i % 2 ? " (PvP)" : " (Normal)"));
+        AppendString(payload, "10.0." + std::to_string(i / 16) + "." + std::to_string(i) + ":8085");
+        Append<u8>(payload, static_cast<u8>(i % 3));
+        Append<f32>(payload, static_cast<f32>(generator() % 1000) / 1000.0f);
+    }
+}
+// The full directory of 1500 internal servers an authority sends a node that connects
+static void WriteFullServerInfo(std::vector<u8>& payload, u32 packetIndex)
+{
+    for (u32 i = 0; i < 1500; i++)
+    {
+        ServerEntry entry;
+        entry.entity = static_cast<entt::entity>(i + packetIndex);
+        entry.type = static_cast<AddressType>(i % 4);
+        entry.region = static_cast<RegionType>(i % 3);
+        entry.realmId = static_cast<u8>(i % 16);
+        entry.address = 0x0A000000 | i;
+        entry.port = static_cast<u16>(3724 + i % 8);
+        Append(payload, entry);
+    }
+}
+// A burst of 400 entities around the player, ids and models repeat while positions and rotations do not
+static void WriteCreateEntityBurst(std::vector<u8>& payload, u32 packetIndex)
+{
+    std::uniform_real_distribution<f32> position(-2000.0f, 2000.0f);
+    for (u32 i = 0; i < 400; i++)
+    {
+        Append<u32>(payload, packetIndex * 400 + i);
+        Append<u32>(payload, 1000 + i % 32);
+        Append<f32>(payload, position(generator));
+        Append<f32>(payload, position(generator));
+        Append<f32>(payload, position(generator) / 100.0f);
+        Append<f32>(payload, static_cast<f32>(i % 360));
+        Append<u16>(payload, 100);
+        Append<u16>(payload, 100);
+    }
+}
+static void WriteRandom(std::vector<u8>& payload, u32 /*packetIndex*/)
+{
+    for (u32 i = 0; i < 8192; i++)
+    {
+        payload.push_back(static_cast<u8>(generator()));
+    }
+}
+
+static void Run(const BenchmarkOpcode& benchmarkOpcode, u32 numPackets)
+{
+    PacketCompressor compressor(0);
+    PacketCompressor decompressor(0);
+
+    std::vector<u8> payload;
+    std::shared_ptr<Bytebuffer> compressed = Bytebuffer::Borrow<NETWORK_MAX_FRAME_SIZE>();
+    std::shared_ptr<Bytebuffer> uncompressed = Bytebuffer::Borrow<NETWORK_MAX_FRAME_SIZE>();
+
+    Clock::duration compressTime = Clock::duration::zero();
+    Clock::duration decompressTime = Clock::duration::zero();
+    u64 payloadBytes = 0;
+    u32 numMismatches = 0;
+
+    for (u32 i = 0; i < numPackets; i++)
+    {
+        payload.clear();
+        benchmarkOpcode.writePayload(payload, i);
+
+        PacketHeader header;
+        header.opcode = benchmarkOpcode.opcode;
+        header.size = static_cast<u16>(payload.size());
+        payloadBytes += payload.size();
+
+        compressed->Reset();
+        uncompressed->Reset();
+
+        Clock::time_point startTime = Clock::now();
+        if (!compressor.Compress(header, payload.data(), compressed))
+        {
+            DebugHandler::PrintError("[CompressionBenchmark]: Failed to compress a %u byte payload", header.size);
+            return;
+        }
+        Clock::time_point compressedTime = Clock::now();
+
+        PacketHeader compressedHeader;
+        std::memcpy(&compressedHeader, compressed->GetDataPointer(), sizeof(PacketHeader));
+        if (!decompressor.Decompress(compressedHeader, compressed->GetDataPointer() + sizeof(PacketHeader), uncompressed))
+        {
+            DebugHandler::PrintError("[CompressionBenchmark]: Failed to decompress a %u byte payload", header.size);
+            return;
+        }
+        Clock::time_point decompressedTime = Clock::now();
+
+        compressTime += compressedTime - startTime;
+        decompressTime += decompressedTime - compressedTime;
+
+        if (compressedHeader.size != header.size || std::memcmp(uncompressed->GetDataPointer(), payload.data(), payload.size()) != 0)
+            numMismatches++;
+    }
+
+    const CompressionStats& stats = compressor.GetStats(benchmarkOpcode.opcode);
+    f64 bytesSaved = static_cast<f64>(stats.bytesIn) - static_cast<f64>(stats.bytesOut);
+    f64 compressMicroseconds = std::chrono::duration<f64, std::micro>(compressTime).count();
+    f64 decompressMicroseconds = std::chrono::duration<f64, std::micro>(decompressTime).count();
+    f64 sampledMicroseconds = stats.numSampledPackets > 0 ? stats.sampledNanoseconds / 1000.0 / stats.numSampledPackets : 0.0;
+
+    DebugHandler::Print("[CompressionBenchmark]: %s, %u packets of %.0f bytes: %.0f -> %.0f bytes (%.1f%% saved)%s",
+        benchmarkOpcode.name, numPackets, static_cast<f64>(payloadBytes) / numPackets,
+        static_cast<f64>(stats.bytesIn), static_cast<f64>(stats.bytesOut), bytesSaved * 100.0 / stats.bytesIn, numMismatches > 0 ? ", MISMATCHED" : "");
+    DebugHandler::Print("[CompressionBenchmark]:     deflate %.1fus and inflate %.1fus per packet (sampled deflate %.1fus), %.0f bytes saved per deflate CPU ms",
+        compressMicroseconds / numPackets, decompressMicroseconds / numPackets, sampledMicroseconds, bytesSaved / (compressMicroseconds / 1000.0));
+}
+
+int main(int argc, char* argv[])
+{
+    u32 numPackets = argc > 1 ? static_cast<u32>(std::strtoul(argv[1], nullptr, 10)) : 2000;
+
+    std::vector<BenchmarkOpcode> benchmarkOpcodes =
+    {
+        { "SMSG_SEND_REALMLIST", Opcode::SMSG_SEND_REALMLIST, WriteRealmlist },
+        { "SMSG_SEND_FULL_INTERNAL_SERVER_INFO", Opcode::SMSG_SEND_FULL_INTERNAL_SERVER_INFO, WriteFullServerInfo },
+        { "SMSG_CREATE_ENTITY", Opcode::SMSG_CREATE_ENTITY, WriteCreateEntityBurst },
+        { "SMSG_UPDATE_ENTITY", Opcode::SMSG_UPDATE_ENTITY, WriteRandom }
+    };
+
+    DebugHandler::Print("[CompressionBenchmark]: Level %u, window bits %u, mem level %u", NETWORK_COMPRESSION_LEVEL, NETWORK_COMPRESSION_WINDOW_BITS, NETWORK_COMPRESSION_MEM_LEVEL);
+    for (const BenchmarkOpcode& benchmarkOpcode : benchmarkOpcodes)
+    {
+        Run(benchmarkOpcode, numPackets);
+    }
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <Networking/MessageHandler.h>
+#include <Networking/NetworkClient.h>
+#include <Networking/NetworkPacket.h>
+#include <Utils/DebugHandler.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+/*
+    Times MessageHandler::CallHandler per packet for both handler signatures, on a single thread with nothing contended.
+
+    Usage: DispatchBenchmark [packetsPerRun] [numRuns]
+
+    - shared_ptr handler: what every handler cost before view handlers, the connection is copied for the call
+    - view handler, view path: CallHandler(NetworkClient&, const PacketView&), no reference count is touched
+    - view handler, shared_ptr path: a view handler reached through the shared pointer overload, as an existing read handler would
+
+    Every handler reads the 8 byte payload so none of them can be optimized away. The fastest run is reported.
+*/
+
+using Clock = std::chrono::steady_clock;
+
+static u64 checksum = 0;
+
+static bool HandleShared(std::shared_ptr<NetworkClient> /*connection*/, std::shared_ptr<NetworkPacket>& packet)
+{
+    u64 value = 0;
+    std::memcpy(&value, packet->payload->GetDataPointer(), sizeof(u64));
+    checksum += value;
+    return true;
+}
+static bool HandleView(NetworkClient& /*connection*/, const PacketView& packet)
+{
+    u64 value = 0;
+    std::memcpy(&value, packet.payload, sizeof(u64));
+    checksum += value;
+    return true;
+}
+
+static f64 TimeRun(u32 numPackets, const std::function<bool()>& dispatch)
+{
+    Clock::time_point startTime = Clock::now();
+    for (u32 i = 0; i < numPackets; i++)
+    {
+        if (!dispatch())
+            return std::numeric_limits<f64>::max();
+    }
+
+    return std::chrono::duration<f64, std::nano>(Clock::now() - startTime).count() / numPackets;
+}
+static void Report(const char* name, u32 numPackets, u32 numRuns, const std::function<bool()>& dispatch)
+{
+    // The std::function call is the same for every case, a run without dispatch is subtracted so only CallHandler is left
+    std::function<bool()> empty = []() { return true; };
+
+    f64 best = std::numeric_limits<f64>::max();
+    f64 bestEmpty = std::numeric_limits<f64>::max();
+    for (u32 i = 0; i < numRuns; i++)
+    {
+        best = std::min(best, TimeRun(numPackets, dispatch));
+        bestEmpty = std::min(bestEmpty, TimeRun(numPackets, empty));
+    }
+
+    if (best == std::numeric_limits<f64>::max())
+    {
+        DebugHandler::PrintError("[DispatchBenchmark]: %s rejected a packet", name);
+        return;
+    }
+
+    DebugHandler::Print("[DispatchBenchmark]: %-31s %6.1f ns/packet", name, std::max(best - bestEmpty, 0.0));
+}
+
+static u32 GetArgument(int argc, char* argv[], int index, u32 defaultValue)
+{
+    return index < argc ? static_cast<u32>(std::strtoul(argv[index], nullptr, 10)) : defaultValue;
+}
+
+int main(int argc, char* argv[])
+{
+    u32 numPackets = GetArgument(argc, argv, 1, 10000000);
+    u32 numRuns = std::max(GetArgument(argc, argv, 2, 5), 1u);
+
+    MessageHandler messageHandler;
+    messageHandler.SetMessageHandler(Opcode::MSG_MOVE_ENTITY, OpcodeHandler(ConnectionStatus::AUTH_NONE, sizeof(u64), HandleShared));
+    messageHandler.SetMessageHandler(Opcode::MSG_MOVE_HEARTBEAT_ENTITY, OpcodeHandler(ConnectionStatus::AUTH_NONE, sizeof(u64), HandleView));
+
+    asio::io_context context;
+    std::shared_ptr<NetworkClient> connection = std::make_shared<NetworkClient>(new asio::ip::tcp::socket(context));
+
+    u64 value = 1;
+    std::shared_ptr<NetworkPacket> sharedPacket = std::make_shared<NetworkPacket>();
+    sharedPacket->header.opcode = Opcode::MSG_MOVE_ENTITY;
+    sharedPacket->header.size = sizeof(u64);
+    sharedPacket->payload = Bytebuffer::Borrow<128>();
+    sharedPacket->payload->PutU64(value);
+
+    std::shared_ptr<NetworkPacket> viewPacket = std::make_shared<NetworkPacket>();
+    viewPacket->header.opcode = Opcode::MSG_MOVE_HEARTBEAT_ENTITY;
+    viewPacket->header.size = sizeof(u64);
+    viewPacket->payload = Bytebuffer::Borrow<128>();
+    viewPacket->payload->PutU64(value);
+
+    PacketView view;
+    view.header = viewPacket->header;
+    view.payload = viewPacket->payload->GetDataPointer();
+
+    DebugHandler::Print("[DispatchBenchmark]: %u packets per run, best of %u runs", numPackets, numRuns);
+
+    Report("shared_ptr handler", numPackets, numRuns, [&]() { return messageHandler.CallHandler(connection, sharedPacket); });
+    Report("view handler, view path", numPackets, numRuns, [&]() { return messageHandler.CallHandler(*connection, view); });
+    Report("view handler, shared_ptr path", numPackets, numRuns, [&]() { return messageHandler.CallHandler(connection, viewPacket); });
+
+    // Keeps the handlers' reads alive
+    return checksum == 0 ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+#include <Networking/NetworkServer.h>
+#include <Utils/DebugHandler.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+/*
+    Runs the same echo load against a NetworkServer on the reactor and then on the io_uring backend.
+
+    Usage: IoUringBenchmark [numConnections] [framesInFlight] [payloadSize] [durationSeconds]
+
+    The clients are plain asio sockets on a thread of their own, so they cost the same for both backends. Each one keeps
+    framesInFlight frames in flight and sends the next one as soon as an echo comes back. CPU time is for the whole
+    process, clients included.
+*/
+
+using tcp = asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+struct EchoConfig
+{
+    u32 numConnections = 256;
+    u32 framesInFlight = 4;
+    u32 payloadSize = 32;
+    u32 durationSeconds = 3;
+};
+
+struct EchoClient
+{
+    std::unique_ptr<tcp::socket> socket;
+    std::vector<u8> readBuffer;
+    std::vector<u8> frame;
+};
+
+static std::atomic<u64> numEchoes;
+static std::atomic<bool> isRunning;
+
+static void HandleRead(BaseSocket* socket, BaseSocket::PacketBatch& batch)
+{
+    std::shared_ptr<Bytebuffer> buffer = Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
+    for (std::shared_ptr<NetworkPacket>& packet : batch)
+    {
+        if (buffer->GetSpace() < sizeof(PacketHeader) + packet->header.size)
+        {
+            socket->Send(buffer);
+            buffer = Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
+        }
+
+        buffer->Put<PacketHeader>(packet->header);
+        buffer->PutBytes(packet->payload->GetDataPointer(), packet->header.size);
+    }
+
+    socket->Send(buffer);
+    socket->AsyncRead();
+}
+static void HandleConnection(NetworkServer* server, tcp::socket* socket, const asio::error_code& error)
+{
+    if (error)
+    {
+        delete socket;
+        return;
+    }
+
+    std::shared_ptr<NetworkClient> client = std::make_shared<NetworkClient>(socket);
+    client->SetReadHandler(std::bind(&HandleRead, std::placeholders::_1, std::placeholders::_2));
+    server->AddConnection(client);
+
+    // An io_uring only takes operations from its own context's thread
+    asio::post(socket->get_executor(), std::bind(&NetworkClient::Listen, client));
+}
+
+static void ReadEcho(EchoClient& client)
+{
+    asio::async_read(*client.socket, asio::buffer(client.readBuffer), [&client](const asio::error_code& error, size_t)
+    {
+        if (error || !isRunning)
+            return;
+
+        numEchoes.fetch_add(1, std::memory_order_relaxed);
+        asio::async_write(*client.socket, asio::buffer(client.frame), [](const asio::error_code&, size_t) { });
+        ReadEcho(client);
+    });
+}
+
+static f64 GetSeconds(const timeval& time)
+{
+    return time.tv_sec + time.tv_usec / 1000000.0;
+}
+
+static void Run(NetworkBackend backend, const EchoConfig& config)
+{
+    const char* name = backend == NetworkBackend::IO_URING ? "io_uring" : "reactor";
+
+    std::shared_ptr<NetworkEngine> engine = std::make_shared<NetworkEngine>(2, ConnectionDistribution::ROUND_ROBIN, false);
+    if (!engine->SetBackend(backend))
+    {
+        DebugHandler::PrintWarning("[IoUringBenchmark]: The %s backend isn't available on this build or kernel", name);
+        return;
+    }
+    engine->Start();
+
+    NetworkServer server(engine, 0);
+    server.SetConnectionHandler(std::bind(&HandleConnection, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    server.Start();
+
+    numEchoes = 0;
+    isRunning = true;
+
+    asio::io_context clientContext(1);
+    std::vector<EchoClient> clients(config.numConnections);
+    for (EchoClient& client : clients)
+    {
+        PacketHeader header;
+        header.opcode = Opcode::MSG_MOVE_ENTITY;
+        header.size = static_cast<u16>(config.payloadSize);
+
+        client.frame.resize(sizeof(PacketHeader) + config.payloadSize);
+        client.readBuffer.resize(client.frame.size());
+        std::memcpy(client.frame.data(), &header, sizeof(PacketHeader));
+
+        client.socket = std::make_unique<tcp::socket>(clientContext);
+        client.socket->connect(tcp::endpoint(asio::ip::address_v4::loopback(), server.GetPort()));
+        client.socket->set_option(tcp::no_delay(true));
+    }
+
+    for (EchoClient& client : clients)
+    {
+        for (u32 i = 0; i < config.framesInFlight; i++)
+        {
+            asio::write(*client.socket, asio::buffer(client.frame));
+        }
+
+        ReadEcho(client);
+    }
+
+    std::thread clientThread([&clientContext]() { clientContext.run(); });
+
+    // Connections that were still being accepted when the frames went out need a moment to get going
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    rusage startUsage;
+    getrusage(RUSAGE_SELF, &startUsage);
+    u64 startEchoes = numEchoes;
+    Clock::time_point startTime = Clock::now();
+
+    std::this_thread::sleep_for(std::chrono::seconds(config.durationSeconds));
+
+    rusage endUsage;
+    getrusage(RUSAGE_SELF, &endUsage);
+    u64 echoes = numEchoes - startEchoes;
+    f64 seconds = std::chrono::duration<f64>(Clock::now() - startTime).count();
+
+    isRunning = false;
+    clientContext.stop();
+    clientThread.join();
+    clients.clear();
+
+    u64 numOperations = 0;
+    u64 numSubmits = 0;
+    for (size_t i = 0; i < engine->GetNumContexts(); i++)
+    {
+        if (std::shared_ptr<IoUringContext> ioUring = engine->GetIoUring(engine->GetContext(i)))
+        {
+            numOperations += ioUring->GetNumOperations();
+            numSubmits += ioUring->GetNumSubmits();
+        }
+    }
+
+    server.Stop();
+    engine->Stop();
+
+    f64 userSeconds = GetSeconds(endUsage.ru_utime) - GetSeconds(startUsage.ru_utime);
+    f64 systemSeconds = GetSeconds(endUsage.ru_stime) - GetSeconds(startUsage.ru_stime);
+
+    DebugHandler::Print("[IoUringBenchmark]: %-8s %.0f echoes/s, %.2fs user and %.2fs system CPU, %.1fus CPU per echo",
+        name, echoes / seconds, userSeconds, systemSeconds, (userSeconds + systemSeconds) * 1000000.0 / echoes);
+
+    if (numSubmits > 0)
+        DebugHandler::Print("[IoUringBenchmark]:          %.1f operations per io_uring_enter", static_cast<f64>(numOperations) / numSubmits);
+}
+
+static u32 GetArgument(int argc, char* argv[], int index, u32 defaultValue)
+{
+    return index < argc ? static_cast<u32>(std::strtoul(argv[index], nullptr, 10)) : defaultValue;
+}
+
+int main(int argc, char* argv[])
+{
+    EchoConfig config;
+    config.numConnections = GetArgument(argc, argv, 1, config.numConnections);
+    config.framesInFlight = GetArgument(argc, argv, 2, config.framesInFlight);
+    config.payloadSize = std::min<u32>(GetArgument(argc, argv, 3, config.payloadSize), NETWORK_BUFFER_SIZE - sizeof(PacketHeader));
+    config.durationSeconds = GetArgument(argc, argv, 4, config.durationSeconds);
+
+    DebugHandler::Print("[IoUringBenchmark]: %u connections with %u frames of %u bytes in flight for %us",
+        config.numConnections, config.framesInFlight, config.payloadSize, config.durationSeconds);
+
+    Run(NetworkBackend::REACTOR, config);
+    Run(NetworkBackend::IO_URING, config);
+    return 0;
+}
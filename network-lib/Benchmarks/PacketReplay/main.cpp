@@ -0,0 +1,107 @@
+#include <Networking/MessageHandler.h>
+#include <Networking/NetworkClient.h>
+#include <Networking/PacketCapture.h>
+#include <Networking/PacketReplay.h>
+#include <Utils/DebugHandler.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+/*
+    Replays a capture written by PacketCaptureWriter and prints the per opcode report.
+
+    Usage: PacketReplayBenchmark <capture> [fast|paced] [speed] [iterations] [initialStatus]
+
+    - fast replays as fast as possible, paced waits for every packet's original timestamp scaled by speed
+    - initialStatus is the status every connection starts in, one of AUTH_NONE, AUTH_CHALLENGE, AUTH_HANDSHAKE, AUTH_FAILED,
+      AUTH_SUCCESS or CONNECTED. Captures taken after the login need AUTH_SUCCESS
+
+    The game's handlers live outside this library, so every opcode gets a view handler that accepts any size in the initial
+    status and reads its payload. The report is the dispatch cost per opcode for the capture's traffic, a server measures its
+    own handlers by handing its MessageHandler to PacketReplay the same way.
+*/
+
+// Not static, so the handler's reads can't be optimized away
+u64 checksum = 0;
+
+static bool HandlePacket(NetworkClient& /*connection*/, const PacketView& packet)
+{
+    for (u16 i = 0; i < packet.header.size; i++)
+    {
+        checksum += packet.payload[i];
+    }
+
+    return true;
+}
+
+static u32 GetArgument(int argc, char* argv[], int index, u32 defaultValue)
+{
+    return index < argc ? static_cast<u32>(std::strtoul(argv[index], nullptr, 10)) : defaultValue;
+}
+static bool GetStatus(const char* name, ConnectionStatus& status)
+{
+    static const char* names[] = { "AUTH_NONE", "AUTH_CHALLENGE", "AUTH_HANDSHAKE", "AUTH_FAILED", "AUTH_SUCCESS", "CONNECTED" };
+    for (u8 i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (std::strcmp(name, names[i]) != 0)
+            continue;
+
+        status = static_cast<ConnectionStatus>(i);
+        return true;
+    }
+
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        DebugHandler::PrintError("[PacketReplayBenchmark]: Usage: PacketReplayBenchmark <capture> [fast|paced] [speed] [iterations] [initialStatus]");
+        return 1;
+    }
+
+    PacketReplayConfig config;
+    if (argc > 2)
+    {
+        if (std::strcmp(argv[2], "paced") == 0)
+        {
+            config.isPaced = true;
+        }
+        else if (std::strcmp(argv[2], "fast") != 0)
+        {
+            DebugHandler::PrintError("[PacketReplayBenchmark]: Unknown pacing mode %s, expected fast or paced", argv[2]);
+            return 1;
+        }
+    }
+
+    config.speed = argc > 3 ? static_cast<f32>(std::strtod(argv[3], nullptr)) : 1.0f;
+    config.iterations = std::max(GetArgument(argc, argv, 4, 1), 1u);
+    if (argc > 5 && !GetStatus(argv[5], config.initialStatus))
+    {
+        DebugHandler::PrintError("[PacketReplayBenchmark]: Unknown connection status %s", argv[5]);
+        return 1;
+    }
+
+    PacketCaptureReader reader;
+    if (!reader.Open(argv[1]))
+    {
+        DebugHandler::PrintError("[PacketReplayBenchmark]: Failed to open capture %s", argv[1]);
+        return 1;
+    }
+
+    MessageHandler messageHandler;
+    for (u16 i = static_cast<u16>(Opcode::INVALID) + 1; i < static_cast<u16>(Opcode::MAX_COUNT); i++)
+    {
+        messageHandler.SetMessageHandler(static_cast<Opcode>(i), OpcodeHandler(config.initialStatus, 0, -1, HandlePacket));
+    }
+
+    DebugHandler::Print("[PacketReplayBenchmark]: Replaying %s %s at %.2fx, %u iterations", argv[1], config.isPaced ? "paced" : "as fast as possible",
+        config.speed, config.iterations);
+
+    PacketReplay replay(&messageHandler, config);
+    PacketReplayReport report = replay.Run(reader);
+    report.Print();
+
+    return report.numFailed == 0 ? 0 : 1;
+}
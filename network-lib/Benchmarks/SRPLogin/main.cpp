@@ -0,0 +1,146 @@
+#include <Utils/DebugHandler.h>
+#include <Utils/SRPLoginEngine.h>
+#include <Utils/srp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Logons per second per core of the server side of an SRP login, three ways:
+
+    - SRPVerifier::StartVerification on numWorkers threads of our own, generating every ephemeral inline
+    - SRPLoginEngine with a warm pool that was prefilled with an ephemeral for every logon
+    - SRPLoginEngine without a pool, every ephemeral is generated inline like it is once a storm has drained the pool
+
+    Usage: SRPLoginBenchmark [numLogons] [numWorkers]
+
+    Every logon uses the same account and the same A, only the server's work is measured.
+*/
+
+using Clock = std::chrono::steady_clock;
+
+static std::shared_ptr<Bytebuffer> accountSalt;
+static std::shared_ptr<Bytebuffer> accountVerifier;
+static std::string username = "BENCHMARK";
+static u8 clientA[256];
+
+static std::shared_ptr<SRPVerifier> CreateVerifier()
+{
+    std::shared_ptr<SRPVerifier> verifier = std::make_shared<SRPVerifier>();
+    verifier->saltBuffer = accountSalt;
+    verifier->verifierBuffer = accountVerifier;
+    return verifier;
+}
+
+static void Report(const char* name, u32 numLogons, u32 numWorkers, u32 numFailed, Clock::duration duration)
+{
+    f64 seconds = std::chrono::duration<f64>(duration).count();
+    f64 logonsPerSecond = numLogons / seconds;
+
+    DebugHandler::Print("[SRPLoginBenchmark]: %-26s %8.0f logons/s, %6.0f per core, %6.0fus per logon%s",
+        name, logonsPerSecond, logonsPerSecond / numWorkers, seconds * 1000000.0 * numWorkers / numLogons, numFailed > 0 ? ", FAILED" : "");
+}
+
+static void RunPlain(u32 numLogons, u32 numWorkers)
+{
+    std::atomic<u32> numFailed = 0;
+    std::vector<std::thread> threads;
+
+    Clock::time_point startTime = Clock::now();
+    for (u32 i = 0; i < numWorkers; i++)
+    {
+        u32 numThreadLogons = numLogons / numWorkers + (i < numLogons % numWorkers ? 1 : 0);
+        threads.push_back(std::thread([numThreadLogons, &numFailed]()
+        {
+            for (u32 j = 0; j < numThreadLogons; j++)
+            {
+                std::shared_ptr<SRPVerifier> verifier = CreateVerifier();
+                if (!verifier->StartVerification(username, clientA))
+                    numFailed++;
+            }
+        }));
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    Report("SRPVerifier", numLogons, numWorkers, numFailed, Clock::now() - startTime);
+}
+
+static void RunEngine(const char* name, u32 numLogons, u32 numWorkers, size_t poolSize)
+{
+    SRPLoginEngine engine(numWorkers, poolSize);
+    engine.Start(true);
+
+    std::atomic<u32> numHandled = 0;
+    std::atomic<u32> numFailed = 0;
+    std::promise<void> done;
+
+    Clock::time_point startTime = Clock::now();
+    for (u32 i = 0; i < numLogons; i++)
+    {
+        engine.Enqueue(CreateVerifier(), username, clientA, [numLogons, &numHandled, &numFailed, &done](std::shared_ptr<SRPVerifier>&, bool result)
+        {
+            if (!result)
+                numFailed++;
+
+            if (++numHandled == numLogons)
+                done.set_value();
+        });
+    }
+
+    done.get_future().wait();
+    Clock::duration duration = Clock::now() - startTime;
+
+    engine.Stop();
+
+    Report(name, numLogons, numWorkers, numFailed, duration);
+    if (engine.GetNumPoolMisses() > 0)
+        DebugHandler::Print("[SRPLoginBenchmark]:                            %llu ephemerals generated inline", static_cast<unsigned long long>(engine.GetNumPoolMisses()));
+}
+
+static u32 GetArgument(int argc, char* argv[], int index, u32 defaultValue)
+{
+    return index < argc ? static_cast<u32>(std::strtoul(argv[index], nullptr, 10)) : defaultValue;
+}
+
+int main(int argc, char* argv[])
+{
+    u32 numLogons = std::max(GetArgument(argc, argv, 1, 2000), 1u);
+    u32 numWorkers = std::max(GetArgument(argc, argv, 2, std::thread::hardware_concurrency()), 1u);
+
+    // The challenge always carries a 4 byte salt and a 256 byte A, so keep going until neither starts with a zero byte
+    do
+    {
+        accountSalt = Bytebuffer::Borrow<4>();
+        accountVerifier = Bytebuffer::Borrow<256>();
+        SRPUtils::CreateAccount(username, "PASSWORD", accountSalt.get(), accountVerifier.get());
+    } while (accountSalt->size != 4);
+
+    std::unique_ptr<SRPUser> user;
+    do
+    {
+        user = std::make_unique<SRPUser>(username, "PASSWORD");
+        user->StartAuthentication();
+    } while (user->aBuffer->size != sizeof(clientA));
+    std::memcpy(clientA, user->aBuffer->GetDataPointer(), sizeof(clientA));
+
+    // Builds the group's tables before anything is timed
+    SRPUtils::GetNG();
+
+    DebugHandler::Print("[SRPLoginBenchmark]: %u logons on %u workers", numLogons, numWorkers);
+
+    RunPlain(numLogons, numWorkers);
+    RunEngine("SRPLoginEngine, warm pool", numLogons, numWorkers, numLogons);
+    RunEngine("SRPLoginEngine, no pool", numLogons, numWorkers, 0);
+    return 0;
+}
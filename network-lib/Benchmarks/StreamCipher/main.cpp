@@ -0,0 +1,129 @@
+#include <Networking/PacketHeader.h>
+#include <Networking/StreamCipher.h>
+#include <Utils/DebugHandler.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/*
+    Seals and opens records the way a connection would and reports the cost per record and per packet against a target.
+
+    Usage: StreamCipherBenchmark [targetNanosecondsPerPacket] [recordsPerCase]
+
+    A record holds whole frames, so the cases are the records our traffic actually produces: a lone move, a tick
+    bundle of moves, a bundle flushed at NETWORK_BUNDLE_FLUSH_THRESHOLD and a single large SMSG_CREATE_ENTITY burst.
+    Per packet is seal plus open divided by the frames in the record, which is what one packet costs both ends, and is
+    held against the target for every case but the burst.
+*/
+
+using Clock = std::chrono::steady_clock;
+
+struct RecordCase
+{
+    const char* name;
+    u32 numFrames;
+    u16 payloadSize;
+    bool hasTarget; // The target is for the small packets that make up our packet rates, a large burst is about throughput
+};
+
+// Records are sealed in batches and then opened in the same order, so both sides are timed without a clock read per record
+static constexpr u32 BATCH_SIZE = 64;
+
+static void Run(const RecordCase& recordCase, u32 numRecords, f64 targetNanoseconds)
+{
+    u8 sessionKey[32];
+    for (u32 i = 0; i < sizeof(sessionKey); i++)
+    {
+        sessionKey[i] = static_cast<u8>(i * 31 + 7);
+    }
+
+    StreamCipher sealer;
+    StreamCipher opener;
+    if (!sealer.Init(sessionKey, sizeof(sessionKey), true) || !opener.Init(sessionKey, sizeof(sessionKey), false))
+    {
+        DebugHandler::PrintError("[StreamCipherBenchmark]: Failed to initialize the ciphers");
+        return;
+    }
+
+    std::vector<u8> plaintext;
+    for (u32 i = 0; i < recordCase.numFrames; i++)
+    {
+        PacketHeader header;
+        header.opcode = Opcode::MSG_MOVE_ENTITY;
+        header.size = recordCase.payloadSize;
+
+        const u8* headerBytes = reinterpret_cast<const u8*>(&header);
+        plaintext.insert(plaintext.end(), headerBytes, headerBytes + sizeof(PacketHeader));
+        for (u16 j = 0; j < recordCase.payloadSize; j++)
+        {
+            plaintext.push_back(static_cast<u8>(i + j));
+        }
+    }
+
+    size_t recordSize = plaintext.size() + StreamCipher::RECORD_OVERHEAD;
+    std::vector<std::vector<u8>> records(BATCH_SIZE, std::vector<u8>(recordSize));
+
+    Clock::duration sealTime = Clock::duration::zero();
+    Clock::duration openTime = Clock::duration::zero();
+    u32 numFailed = 0;
+
+    for (u32 done = 0; done < numRecords; done += BATCH_SIZE)
+    {
+        u32 batchSize = std::min(BATCH_SIZE, numRecords - done);
+
+        Clock::time_point startTime = Clock::now();
+        for (u32 i = 0; i < batchSize; i++)
+        {
+            if (!sealer.Seal(plaintext.data(), plaintext.size(), records[i].data()))
+                numFailed++;
+        }
+        Clock::time_point sealedTime = Clock::now();
+
+        for (u32 i = 0; i < batchSize; i++)
+        {
+            u8* opened = nullptr;
+            size_t openedSize = 0;
+            if (!opener.Open(records[i].data(), recordSize, opened, openedSize) || openedSize != plaintext.size())
+                numFailed++;
+        }
+        Clock::time_point openedTime = Clock::now();
+
+        sealTime += sealedTime - startTime;
+        openTime += openedTime - sealedTime;
+    }
+
+    f64 sealNanoseconds = std::chrono::duration<f64, std::nano>(sealTime).count() / numRecords;
+    f64 openNanoseconds = std::chrono::duration<f64, std::nano>(openTime).count() / numRecords;
+    f64 packetNanoseconds = (sealNanoseconds + openNanoseconds) / recordCase.numFrames;
+
+    f64 megabytesPerSecond = plaintext.size() * 1000.0 / (sealNanoseconds + openNanoseconds);
+
+    const char* verdict = !recordCase.hasTarget ? "" : packetNanoseconds <= targetNanoseconds ? ", under target" : ", OVER TARGET";
+    DebugHandler::Print("[StreamCipherBenchmark]: %-24s %6zu B: seal %6.0f ns and open %6.0f ns per record, %7.1f ns per packet, %6.0f MB/s%s%s",
+        recordCase.name, plaintext.size(), sealNanoseconds, openNanoseconds, packetNanoseconds, megabytesPerSecond, verdict, numFailed > 0 ? ", FAILED" : "");
+}
+
+int main(int argc, char* argv[])
+{
+    f64 targetNanoseconds = argc > 1 ? std::strtod(argv[1], nullptr) : 1000.0;
+    u32 numRecords = argc > 2 ? std::max(static_cast<u32>(std::strtoul(argv[2], nullptr, 10)), 1u) : 20000;
+
+    // Moves are 36 byte frames, a tick bundles every move of a player's surroundings
+    RecordCase recordCases[] =
+    {
+        { "single move", 1, 32, true },
+        { "tick bundle, 16 moves", 16, 32, true },
+        { "flushed bundle", NETWORK_BUNDLE_FLUSH_THRESHOLD / 36, 32, true },
+        { "SMSG_CREATE_ENTITY burst", 1, 60000, false }
+    };
+
+    DebugHandler::Print("[StreamCipherBenchmark]: %u records per case, target %.0f ns per packet", numRecords, targetNanoseconds);
+    for (const RecordCase& recordCase : recordCases)
+    {
+        Run(recordCase, numRecords, targetNanoseconds);
+    }
+
+    return 0;
+}
@@ -25,23 +25,33 @@
 
 #include "BaseSocket.h"
 #include "Defines.h"
+#include "IoUringContext.h"
+#include "NetworkPacket.h"
+#include "PacketCapture.h"
+#include "PacketCompressor.h"
+#include "SendLane.h"
+#include "SharedMemoryChannel.h"
+#include "StreamCipher.h"
 
+#include <array>
 #include <asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <vector>
 #include <Utils/ByteBuffer.h>
 
 class BaseSocket : public std::enable_shared_from_this<BaseSocket>
 {
 public:
-    using tcp = asio::ip::tcp;  
-    BaseSocket(tcp::socket* socket) : _isClosed(false), _socket(socket) { Init(); }
-    ~BaseSocket() { }
+    using tcp = asio::ip::tcp;
+    using PacketBatch = std::vector<std::shared_ptr<NetworkPacket>>;
 
-    void Init()
-    {
-        _receiveBuffer = Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
-        _sendBuffer = Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
-    }
+    BaseSocket(tcp::socket* socket) : _isClosed(false), _socket(socket) { }
+    ~BaseSocket() { }
 
+    // Null while the socket is idle, a buffer is only attached between the socket becoming readable and the batch being consumed
     std::shared_ptr<Bytebuffer> GetReceiveBuffer() { return _receiveBuffer; }
     void _internalRead(asio::error_code errorCode, size_t bytesRead)
     {
@@ -52,45 +62,305 @@ public:
         }
 
         _receiveBuffer->writtenData += bytesRead;
+        _lastReceiveTime = std::chrono::steady_clock::now();
+        if (!FramePackets())
+        {
+            Close(asio::error::invalid_argument);
+            return;
+        }
+
+        // Nothing complete arrived yet, keep reading until at least one full frame is buffered
+        if (_packetBatch.empty())
+        {
+            AsyncRead();
+            return;
+        }
 
         if (_readHandler)
-            _readHandler(this);
+            _readHandler(this, _packetBatch);
+    }
+    void _internalReadable(asio::error_code errorCode, size_t /*events*/)
+    {
+        if (errorCode)
+        {
+            Close(errorCode);
+            return;
+        }
+
+        if (IsClosed())
+            return;
+
+        _receiveBuffer = BorrowReceiveBuffer();
+        ReadSome();
     }
     void _internalWrite(asio::error_code errorCode, std::size_t bytesWritten)
     {
         if (errorCode)
         {
             Close(errorCode);
+            return;
         }
+
+        bool releasedBackpressure = false;
+        {
+            std::lock_guard<std::mutex> lock(_sendMutex);
+
+            _sendInFlight.clear();
+            _sendQueuedBytes -= bytesWritten;
+
+            if (_isSendBackpressured && _sendQueuedBytes <= _sendLowWatermark)
+            {
+                _isSendBackpressured = false;
+                releasedBackpressure = true;
+            }
+
+            StartWrite();
+        }
+
+        if (releasedBackpressure && _backpressureHandler)
+            _backpressureHandler(this, false);
     }
     void AsyncRead()
     {
-        if (!_socket->is_open())
+        if (IsClosed())
+            return;
+
+        // Any views handed out by the previous batch are invalid from this point on
+        _packetBatch.clear();
+        _inflateBuffers.clear();
+        CompactReceiveBuffer();
+
+        // Frames held back by an encryption barrier are already here, they are framed before we wait for more
+        if (_hasHeldBackData)
+        {
+            _hasHeldBackData = false;
+            asio::post(_socket->get_executor(), std::bind(&BaseSocket::_internalRead, shared_from_this(), asio::error_code(), 0));
             return;
+        }
+
+        // An idle socket holds no receive buffer, we wait until it is readable and only borrow one then
+        if (!_receiveBuffer)
+        {
+            if (_sharedMemory)
+            {
+                _receiveBuffer = BorrowReceiveBuffer();
+            }
+            else if (_ioUring)
+            {
+                _ioUring->AsyncWaitReadable(_socket->native_handle(),
+                    std::bind(&BaseSocket::_internalReadable, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+                return;
+            }
+            else
+            {
+                _socket->async_wait(tcp::socket::wait_read,
+                    std::bind(&BaseSocket::_internalReadable, shared_from_this(), std::placeholders::_1, 0));
+                return;
+            }
+        }
 
-        _receiveBuffer->Reset();
-        _socket->async_read_some(asio::buffer(_receiveBuffer->GetReadPointer(), _receiveBuffer->GetReadSpace()),
-            std::bind(&BaseSocket::_internalRead, this, std::placeholders::_1, std::placeholders::_2));
+        ReadSome();
     }
+    // The buffer holds whole frames, which go out on the send lane of their opcode (see SendLane.h). The socket keeps a
+    // reference to the buffer until it has been written, the buffer must not be modified after this call
     void Send(std::shared_ptr<Bytebuffer>& buffer)
     {
-        if (!buffer->IsEmpty() || buffer->IsFull())
+        if (buffer->IsEmpty() || IsClosed())
+            return;
+
+        bool becameBackpressured = false;
         {
-            _socket->async_write_some(asio::buffer(buffer->GetDataPointer(), buffer->writtenData),
-                std::bind(&BaseSocket::_internalWrite, this, std::placeholders::_1, std::placeholders::_2));
+            std::lock_guard<std::mutex> lock(_sendMutex);
+
+            if (_isBundling && buffer->writtenData < _bundleFlushThreshold)
+            {
+                Bundle(buffer);
+            }
+            else
+            {
+                // Whatever was bundled so far was sent first and has to stay in front
+                FlushBundle();
+                QueueLanes(buffer);
+            }
+            _numSends++;
+
+            if (!_isSendBackpressured && _sendQueuedBytes >= _sendHighWatermark)
+            {
+                _isSendBackpressured = true;
+                becameBackpressured = true;
+            }
+
+            if (!_isWriting)
+            {
+                _isWriting = true;
+                StartWrite();
+            }
         }
+
+        if (becameBackpressured && _backpressureHandler)
+            _backpressureHandler(this, true);
+    }
+
+    // Once highWatermark bytes are queued the socket reports backpressure until the queue drains to lowWatermark
+    void SetSendWatermarks(size_t lowWatermark, size_t highWatermark)
+    {
+        assert(lowWatermark <= highWatermark);
+
+        std::lock_guard<std::mutex> lock(_sendMutex);
+        _sendLowWatermark = lowWatermark;
+        _sendHighWatermark = highWatermark;
     }
+    bool IsSendBackpressured() { return _isSendBackpressured; }
+
+    // Outgoing packets with a payload of at least threshold bytes are deflated, compressed packets are always accepted on receive.
+    // Both ends keep streaming state, so this has to be enabled before any packet that should be compressed is sent
+    void EnableCompression(size_t threshold = NETWORK_COMPRESSION_THRESHOLD)
+    {
+        std::lock_guard<std::mutex> lock(_sendMutex);
+
+        if (!_compressor)
+            _compressor = std::make_unique<PacketCompressor>(threshold);
+        else
+            _compressor->SetThreshold(threshold);
+    }
+    // Null until EnableCompression, the per opcode stats of what this socket deflated are kept on its compressor
+    PacketCompressor* GetCompressor() { return _compressor.get(); }
+    size_t GetSendQueuedBytes() { return _sendQueuedBytes; }
+
+    // Copies sends into one buffer per socket until FlushTick, so the small packets of a whole tick go out in a single write.
+    // The bundle is flushed early once it holds flushThreshold bytes, buffers at least that large are queued without a copy
+    void EnableTickBundling(size_t flushThreshold = NETWORK_BUNDLE_FLUSH_THRESHOLD)
+    {
+        std::lock_guard<std::mutex> lock(_sendMutex);
+        _isBundling = true;
+        _bundleFlushThreshold = std::min<size_t>(std::max<size_t>(flushThreshold, 1), NETWORK_MAX_FRAME_SIZE);
+    }
+    void DisableTickBundling()
+    {
+        std::lock_guard<std::mutex> lock(_sendMutex);
+        _isBundling = false;
+
+        if (FlushBundle() && !_isWriting)
+        {
+            _isWriting = true;
+            StartWrite();
+        }
+    }
+    bool IsTickBundling() { return _isBundling; }
+    // Writes everything bundled since the last flush, returns false if there was nothing to write
+    bool FlushTick()
+    {
+        if (IsClosed())
+            return false;
+
+        std::lock_guard<std::mutex> lock(_sendMutex);
+        if (!FlushBundle())
+            return false;
+
+        if (!_isWriting)
+        {
+            _isWriting = true;
+            StartWrite();
+        }
+
+        return true;
+    }
+
+    // Encrypts everything sent from now on and decrypts everything framed from now on, usually right after the SRP handshake.
+    // Must be called from the socket's io_context, between frames: the peer has to switch right after its last plaintext frame
+    bool EnableEncryption(const u8* sessionKey, size_t keySize, bool isServer)
+    {
+        std::unique_ptr<StreamCipher> cipher = std::make_unique<StreamCipher>();
+        if (!cipher->Init(sessionKey, keySize, isServer))
+            return false;
+
+        std::lock_guard<std::mutex> lock(_sendMutex);
+
+        // Frames sent before this still have to go out in plaintext, so they leave the bundle and the lanes before the cipher is in place
+        FlushBundle();
+        if (!DrainLanes(std::numeric_limits<size_t>::max()))
+            return false;
 
-    bool IsClosed() { return _isClosed || !_socket->is_open(); }
+        _cipher = std::move(cipher);
+
+        // The drained frames are queued but nothing picks them up unless a write is started for them
+        if (!_isWriting && !_sendQueue.empty())
+        {
+            _isWriting = true;
+            StartWrite();
+        }
+
+        return true;
+    }
+    bool IsEncrypted() { return _cipher != nullptr; }
+    // Null until EnableEncryption, the seal and open stats of this socket are kept on its cipher
+    StreamCipher* GetCipher() { return _cipher.get(); }
+    // Ends the next batch right after a packet with this opcode, so anything that follows it is only framed once the
+    // read handler had the chance to call EnableEncryption. Needed when the peer may send encrypted data right behind it
+    void SetEncryptionBarrier(Opcode opcode)
+    {
+        _encryptionBarrier = opcode;
+    }
+
+    // Only updated by the socket's own io_context, the send count is safe to read from anywhere
+    std::chrono::steady_clock::time_point GetLastReceiveTime() { return _lastReceiveTime; }
+    u64 GetNumSends() { return _numSends; }
+    // Heartbeats that were dropped from a send lane because a newer one for the same entity was sent before they went out
+    u64 GetNumSupersededSends() { return _numSupersededSends; }
+    // Every bundle handed to the send lanes, whether by FlushTick or because it reached the flush threshold
+    u64 GetNumBundleFlushes() { return _numBundleFlushes; }
+
+    // Moves all traffic of this socket onto a shared memory channel, must be done before the first AsyncRead or Send
+    void AttachSharedMemory(std::shared_ptr<SharedMemoryChannel> channel)
+    {
+        _sharedMemory = channel;
+    }
+    bool IsSharedMemory() { return _sharedMemory != nullptr; }
+
+    // Moves reads and writes of this socket onto the io_uring of its io_context, must be done before the first AsyncRead or Send
+    void AttachIoUring(std::shared_ptr<IoUringContext> ioUring)
+    {
+        assert(&ioUring->GetContext() == &_socket->get_executor().context());
+
+        _ioUring = ioUring;
+    }
+    bool IsIoUring() { return _ioUring != nullptr; }
+
+    // Every packet this socket frames is offered to the capture under connectionId, must be set before the first AsyncRead
+    void SetPacketCapture(std::shared_ptr<PacketCaptureWriter> capture, u64 connectionId)
+    {
+        _packetCapture = capture;
+        _packetCaptureId = connectionId;
+    }
+
+    bool IsClosed() { return _isClosed || (_sharedMemory ? !_sharedMemory->IsOpen() : !_socket->is_open()); }
     void Close(asio::error_code error)
     {
         if (!_isClosed)
         {
+            // The close handler may drop the last owning reference, keep ourselves alive until we are done
+            std::shared_ptr<BaseSocket> self = weak_from_this().lock();
+
             if (_disconnectHandler)
                 _disconnectHandler(this);
 
+            if (_sharedMemory)
+                _sharedMemory->Close();
+
+            // Operations in the ring hold their own reference to the file, closing the descriptor alone would leave them pending
+            if (_ioUring)
+            {
+                _ioUring->Flush();
+
+                asio::error_code ignored;
+                _socket->shutdown(tcp::socket::shutdown_both, ignored);
+            }
+
             _socket->close();
             _isClosed = true;
+
+            if (_closeHandler)
+                _closeHandler(this);
         }
     }
     void _internalConnected(bool connected)
@@ -103,7 +373,10 @@ public:
     {
         return _socket;
     }
-    void SetReadHandler(std::function<void(BaseSocket*)> readHandler)
+
+    // The packets in the batch are views into the receive buffer, they are only valid until AsyncRead is called again.
+    // Holding on to one doesn't extend that, use NetworkPacket::Copy to keep a packet
+    void SetReadHandler(std::function<void(BaseSocket*, PacketBatch&)> readHandler)
     {
         _readHandler = readHandler;
     }
@@ -115,13 +388,589 @@ public:
     {
         _disconnectHandler = disconnectHandler;
     }
+    // Called with true when the send queue reaches the high watermark and with false once it has drained to the low watermark
+    void SetBackpressureHandler(std::function<void(BaseSocket*, bool)> backpressureHandler)
+    {
+        _backpressureHandler = backpressureHandler;
+    }
+    // Used by NetworkServer to unregister the connection, runs after the disconnect handler
+    void _internalSetCloseHandler(std::function<void(BaseSocket*)> closeHandler)
+    {
+        _closeHandler = closeHandler;
+    }
+
 private:
+    // A run of whole frames in a buffer that was sent, or in a buffer we compressed or encrypted them into
+    struct QueuedFrames
+    {
+        std::shared_ptr<Bytebuffer> buffer;
+        size_t offset = 0;
+        size_t size = 0;
+
+        // Set for a frame that a newer one with the same opcode and key replaces while it is still queued
+        Opcode supersedeOpcode = Opcode::INVALID;
+        u32 supersedeKey = 0;
+    };
+    // Entries before head have been taken already, they are only cleared once the lane is empty
+    struct SendLaneQueue
+    {
+        std::vector<QueuedFrames> frames;
+        size_t head = 0;
+        size_t deficit = 0;
+    };
+
+    // Splits every complete frame in the receive buffer into a packet view, partial frames are left for the next read
+    bool FramePackets()
+    {
+        if (_cipher)
+            return FrameRecords();
+
+        while (_receiveBuffer->GetActiveSize() >= sizeof(PacketHeader))
+        {
+            PacketHeader header;
+            _receiveBuffer->Get<PacketHeader>(header, _receiveBuffer->readData);
+
+            size_t frameSize = sizeof(PacketHeader) + header.size;
+            if (_receiveBuffer->GetActiveSize() < frameSize)
+                break;
+
+            if (!AddPacket(header, _receiveBuffer->GetReadPointer() + sizeof(PacketHeader)))
+                return false;
+
+            _receiveBuffer->readData += frameSize;
+
+            if (_encryptionBarrier != Opcode::INVALID && header.opcode == _encryptionBarrier)
+            {
+                _encryptionBarrier = Opcode::INVALID;
+                _hasHeldBackData = _receiveBuffer->GetActiveSize() > 0;
+                break;
+            }
+        }
+
+        return true;
+    }
+    // Decrypts every complete record in place and frames the packets inside it, records never split a frame
+    bool FrameRecords()
+    {
+        while (_receiveBuffer->GetActiveSize() >= StreamCipher::RECORD_HEADER_SIZE)
+        {
+            size_t recordSize = 0;
+            if (!StreamCipher::GetRecordSize(_receiveBuffer->GetReadPointer(), recordSize))
+                return false;
+
+            if (_receiveBuffer->GetActiveSize() < recordSize)
+                break;
+
+            u8* plaintext = nullptr;
+            size_t plaintextSize = 0;
+            if (!_cipher->Open(_receiveBuffer->GetReadPointer(), recordSize, plaintext, plaintextSize))
+                return false;
+
+            size_t offset = 0;
+            while (offset < plaintextSize)
+            {
+                if (plaintextSize - offset < sizeof(PacketHeader))
+                    return false;
+
+                PacketHeader header;
+                std::memcpy(&header, plaintext + offset, sizeof(PacketHeader));
+
+                size_t frameSize = sizeof(PacketHeader) + header.size;
+                if (plaintextSize - offset < frameSize || !AddPacket(header, plaintext + offset + sizeof(PacketHeader)))
+                    return false;
+
+                offset += frameSize;
+            }
+
+            _receiveBuffer->readData += recordSize;
+        }
+
+        return true;
+    }
+    bool AddPacket(PacketHeader header, u8* payload)
+    {
+        if (static_cast<u16>(header.opcode) & PACKET_COMPRESSED_FLAG)
+        {
+            payload = Inflate(header, payload);
+            if (payload == nullptr)
+                return false;
+        }
+
+        if (_packetCapture)
+            _packetCapture->Write(_packetCaptureId, header, payload);
+
+        std::shared_ptr<NetworkPacket> packet = GetPacketView(_packetBatch.size());
+        packet->header = header;
+        packet->payload->SetView(payload, header.size);
+
+        _packetBatch.push_back(packet);
+        return true;
+    }
+    // Inflates a compressed payload into pooled memory that lives as long as the current batch, returns the uncompressed payload
+    u8* Inflate(PacketHeader& header, u8* payload)
+    {
+        if (!_decompressor)
+            _decompressor = std::make_unique<PacketCompressor>(std::numeric_limits<size_t>::max());
+
+        if (_inflateBuffers.empty() || _inflateBuffers.back()->GetSpace() < 0xFFFF)
+            _inflateBuffers.push_back(Bytebuffer::Borrow<NETWORK_MAX_FRAME_SIZE>());
+
+        std::shared_ptr<Bytebuffer>& output = _inflateBuffers.back();
+        u8* uncompressedPayload = output->GetWritePointer();
+
+        if (!_decompressor->Decompress(header, payload, output))
+            return nullptr;
+
+        return uncompressedPayload;
+    }
+    // Appends buffer to the bundle, which is flushed first if buffer doesn't fit anymore. Must be called with _sendMutex held
+    void Bundle(std::shared_ptr<Bytebuffer>& buffer)
+    {
+        if (_bundleBuffer && _bundleBuffer->GetSpace() < buffer->writtenData)
+            FlushBundle();
+
+        if (!_bundleBuffer)
+        {
+            if (_bundleFlushThreshold <= NETWORK_BUFFER_SIZE)
+                _bundleBuffer = Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
+            else
+                _bundleBuffer = Bytebuffer::Borrow<NETWORK_MAX_FRAME_SIZE>();
+        }
+
+        _bundleBuffer->PutBytes(buffer->GetDataPointer(), buffer->writtenData);
+        _sendQueuedBytes += buffer->writtenData;
+
+        if (_bundleBuffer->writtenData >= _bundleFlushThreshold)
+            FlushBundle();
+    }
+    // Hands the bundle to the send lanes, the next bundled send borrows a new one. Must be called with _sendMutex held
+    bool FlushBundle()
+    {
+        if (!_bundleBuffer)
+            return false;
+
+        _sendQueuedBytes -= _bundleBuffer->writtenData;
+        _numBundleFlushes++;
+
+        QueueLanes(_bundleBuffer);
+        _bundleBuffer.reset();
+        return true;
+    }
+    // Splits buffer into runs of frames that share a send lane, frames that can be superseded get an entry of their own.
+    // Must be called with _sendMutex held
+    void QueueLanes(std::shared_ptr<Bytebuffer>& buffer)
+    {
+        const u8* data = buffer->GetDataPointer();
+        size_t size = buffer->writtenData;
+
+        size_t offset = 0;
+        size_t runOffset = 0;
+        SendLane runLane = SendLane::DEFAULT;
+        while (offset + sizeof(PacketHeader) <= size)
+        {
+            PacketHeader header;
+            std::memcpy(&header, data + offset, sizeof(PacketHeader));
+
+            size_t frameSize = sizeof(PacketHeader) + header.size;
+            if (offset + frameSize > size)
+                break;
+
+            SendLaneInfo info = SendLanes::Get(header.opcode);
+            bool isSuperseded = info.isSuperseded && header.size >= sizeof(u32);
+
+            if (offset > runOffset && (info.lane != runLane || isSuperseded))
+            {
+                AddToLane(runLane, QueuedFrames{ buffer, runOffset, offset - runOffset });
+                runOffset = offset;
+            }
+            runLane = info.lane;
+
+            if (isSuperseded)
+            {
+                QueuedFrames frames{ buffer, offset, frameSize };
+                frames.supersedeOpcode = header.opcode;
+                std::memcpy(&frames.supersedeKey, data + offset + sizeof(PacketHeader), sizeof(u32));
+
+                Supersede(info.lane, frames);
+                AddToLane(info.lane, std::move(frames));
+                runOffset = offset + frameSize;
+            }
+
+            offset += frameSize;
+        }
+
+        // Anything that isn't a whole frame stays behind the frames in front of it, draining reports it if it has to be parsed
+        if (size > runOffset)
+            AddToLane(runLane, QueuedFrames{ buffer, runOffset, size - runOffset });
+    }
+    void AddToLane(SendLane lane, QueuedFrames&& frames)
+    {
+        _sendQueuedBytes += frames.size;
+        _sendLanes[static_cast<size_t>(lane)].frames.push_back(std::move(frames));
+    }
+    // Drops a queued frame that frames replaces, it only ever looks at entries that haven't been written yet
+    void Supersede(SendLane lane, const QueuedFrames& frames)
+    {
+        SendLaneQueue& queue = _sendLanes[static_cast<size_t>(lane)];
+        for (size_t i = queue.head; i < queue.frames.size(); i++)
+        {
+            QueuedFrames& queued = queue.frames[i];
+            if (queued.supersedeOpcode != frames.supersedeOpcode || queued.supersedeKey != frames.supersedeKey || queued.size == 0)
+                continue;
+
+            _sendQueuedBytes -= queued.size;
+            _numSupersededSends++;
+
+            // Left in place as an empty entry, removing it would shift every entry behind it
+            queued.buffer.reset();
+            queued.size = 0;
+            break;
+        }
+    }
+    // Takes frames out of the lanes with deficit round robin until maxSize bytes have been taken or the lanes are empty,
+    // compression and encryption happen here so they see the frames in wire order. Must be called with _sendMutex held
+    bool DrainLanes(size_t maxSize)
+    {
+        size_t drainedSize = 0;
+        bool hasQueued = true;
+        while (hasQueued && drainedSize < maxSize)
+        {
+            hasQueued = false;
+            for (size_t i = 0; i < _sendLanes.size() && drainedSize < maxSize; i++)
+            {
+                SendLaneQueue& queue = _sendLanes[i];
+                if (queue.head == queue.frames.size())
+                    continue;
+
+                queue.deficit += SendLanes::Quantum[i];
+                while (queue.head < queue.frames.size() && drainedSize < maxSize)
+                {
+                    QueuedFrames& frames = queue.frames[queue.head];
+                    if (frames.size > queue.deficit)
+                        break;
+
+                    queue.deficit -= frames.size;
+                    drainedSize += frames.size;
+                    _sendQueuedBytes -= frames.size;
+
+                    if (frames.size > 0 && !QueueFrames(frames))
+                        return false;
+
+                    frames.buffer.reset();
+                    queue.head++;
+                }
+
+                // An empty lane doesn't get to save up its deficit for later
+                if (queue.head == queue.frames.size())
+                {
+                    queue.frames.clear();
+                    queue.head = 0;
+                    queue.deficit = 0;
+                }
+                else
+                {
+                    hasQueued = true;
+                }
+            }
+        }
+
+        return true;
+    }
+    // Queues frames taken from a lane to be written, deflated when large enough. Must be called with _sendMutex held
+    bool QueueFrames(QueuedFrames& frames)
+    {
+        if (_compressor && frames.size >= _compressor->GetThreshold())
+            return QueueCompressed(frames.buffer->GetDataPointer() + frames.offset, frames.size);
+
+        return QueueBuffer(frames);
+    }
+    // Rewrites the frames in data with every large enough payload deflated, must be called with _sendMutex held
+    bool QueueCompressed(const u8* data, size_t size)
+    {
+        std::shared_ptr<Bytebuffer> output = Bytebuffer::Borrow<NETWORK_MAX_FRAME_SIZE>();
+
+        size_t offset = 0;
+        while (offset + sizeof(PacketHeader) <= size)
+        {
+            PacketHeader header;
+            std::memcpy(&header, data + offset, sizeof(PacketHeader));
+
+            size_t frameSize = sizeof(PacketHeader) + header.size;
+            if (offset + frameSize > size)
+                break;
+
+            const u8* frame = data + offset;
+            bool shouldCompress = _compressor->ShouldCompress(header);
+
+            // Compressed frames never grow past NETWORK_MAX_FRAME_SIZE, so a fresh output buffer always has room for one
+            size_t requiredSpace = shouldCompress ? NETWORK_MAX_FRAME_SIZE : frameSize;
+            if (output->GetSpace() < requiredSpace)
+            {
+                QueuedFrames outputFrames{ output, 0, output->writtenData };
+                if (!QueueBuffer(outputFrames))
+                    return false;
+
+                output = Bytebuffer::Borrow<NETWORK_MAX_FRAME_SIZE>();
+            }
+
+            if (shouldCompress)
+            {
+                if (!_compressor->Compress(header, frame + sizeof(PacketHeader), output))
+                    return false;
+            }
+            else
+            {
+                output->PutBytes(frame, frameSize);
+            }
+
+            offset += frameSize;
+        }
+
+        if (offset < size)
+            return false;
+
+        QueuedFrames outputFrames{ output, 0, output->writtenData };
+        return QueueBuffer(outputFrames);
+    }
+    // Queues whole frames to be written as is or sealed into records, must be called with _sendMutex held
+    bool QueueBuffer(QueuedFrames& frames)
+    {
+        if (_cipher)
+            return QueueEncrypted(frames.buffer->GetDataPointer() + frames.offset, frames.size);
+
+        _sendQueuedBytes += frames.size;
+        _sendQueue.push_back(frames);
+        return true;
+    }
+    // Seals the frames in data straight into pooled send buffers, as many frames per record as fit. Must be called with _sendMutex held
+    bool QueueEncrypted(const u8* data, size_t size)
+    {
+        std::shared_ptr<Bytebuffer> output;
+        size_t offset = 0;
+        while (offset < size)
+        {
+            size_t recordEnd = offset;
+            while (recordEnd + sizeof(PacketHeader) <= size)
+            {
+                PacketHeader header;
+                std::memcpy(&header, data + recordEnd, sizeof(PacketHeader));
+
+                size_t frameSize = sizeof(PacketHeader) + header.size;
+                if (recordEnd + frameSize > size)
+                    return false;
+
+                if (recordEnd + frameSize - offset > NETWORK_MAX_RECORD_SIZE - StreamCipher::RECORD_OVERHEAD)
+                    break;
+
+                recordEnd += frameSize;
+            }
+
+            // Whatever is left isn't a whole frame
+            if (recordEnd == offset)
+                return false;
+
+            size_t recordSize = recordEnd - offset + StreamCipher::RECORD_OVERHEAD;
+            if (!output || output->GetSpace() < recordSize)
+            {
+                if (output)
+                {
+                    _sendQueuedBytes += output->writtenData;
+                    _sendQueue.push_back(QueuedFrames{ output, 0, output->writtenData });
+                }
+
+                size_t remainingSize = size - offset + StreamCipher::RECORD_OVERHEAD;
+                if (remainingSize <= 1024)
+                    output = Bytebuffer::Borrow<1024>();
+                else if (remainingSize <= NETWORK_BUFFER_SIZE)
+                    output = Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
+                else
+                    output = Bytebuffer::Borrow<NETWORK_MAX_RECORD_SIZE>();
+            }
+
+            if (!_cipher->Seal(data + offset, recordEnd - offset, output->GetWritePointer()))
+                return false;
+
+            output->writtenData += recordSize;
+            offset = recordEnd;
+        }
+
+        if (output)
+        {
+            _sendQueuedBytes += output->writtenData;
+            _sendQueue.push_back(QueuedFrames{ output, 0, output->writtenData });
+        }
+
+        return true;
+    }
+    // Reads whatever is available into the receive buffer, which must be attached
+    void ReadSome()
+    {
+        if (_sharedMemory)
+        {
+            _sharedMemory->AsyncReadSome(_receiveBuffer->GetWritePointer(), _receiveBuffer->GetSpace(),
+                std::bind(&BaseSocket::_internalRead, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+            return;
+        }
+
+        if (_ioUring)
+        {
+            _ioUring->AsyncReadSome(_socket->native_handle(), _receiveBuffer->GetWritePointer(), _receiveBuffer->GetSpace(),
+                std::bind(&BaseSocket::_internalRead, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+            return;
+        }
+
+        // The socket is readable by now, so asio performs the read right away instead of going back to the reactor
+        _socket->async_read_some(asio::buffer(_receiveBuffer->GetWritePointer(), _receiveBuffer->GetSpace()),
+            std::bind(&BaseSocket::_internalRead, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+    }
+    std::shared_ptr<Bytebuffer> BorrowReceiveBuffer()
+    {
+        return _ioUring ? _ioUring->BorrowReceiveBuffer() : Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
+    }
+    // Gathers up to a batch from the lanes into a single write, or stops writing if nothing is queued. Must be called with _sendMutex held
+    void StartWrite()
+    {
+        if (!DrainLanes(NETWORK_SEND_BATCH_SIZE))
+        {
+            asio::post(_socket->get_executor(), std::bind(&BaseSocket::Close, shared_from_this(), asio::error::invalid_argument));
+            return;
+        }
+
+        if (_sendQueue.empty())
+        {
+            _isWriting = false;
+            return;
+        }
+
+        _sendInFlight.swap(_sendQueue);
+
+        _sendGatherBuffers.clear();
+        for (QueuedFrames& frames : _sendInFlight)
+        {
+            _sendGatherBuffers.push_back(asio::buffer(frames.buffer->GetDataPointer() + frames.offset, frames.size));
+        }
+
+        if (_sharedMemory)
+        {
+            _sharedMemory->AsyncWrite(_sendGatherBuffers,
+                std::bind(&BaseSocket::_internalWrite, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+            return;
+        }
+
+        if (_ioUring)
+        {
+            _ioUring->AsyncWrite(_socket->native_handle(), _sendGatherBuffers,
+                std::bind(&BaseSocket::_internalWrite, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+            return;
+        }
+
+        asio::async_write(*_socket, _sendGatherBuffers,
+            std::bind(&BaseSocket::_internalWrite, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+    }
+    std::shared_ptr<NetworkPacket>& GetPacketView(size_t index)
+    {
+        if (index >= _packetViews.size())
+            _packetViews.resize(index + 1);
+
+        // Views are re-pointed for every batch, a handler that keeps a packet past its batch has to NetworkPacket::Copy it
+        std::shared_ptr<NetworkPacket>& packet = _packetViews[index];
+        if (!packet)
+        {
+            packet = std::make_shared<NetworkPacket>();
+            packet->payload = std::make_shared<Bytebuffer>(_receiveBuffer->GetDataPointer(), 0);
+        }
+
+        return packet;
+    }
+    // Moves the unread tail (at most one partial frame) to the front so the next frame is always contiguous.
+    // A drained buffer goes back to the pool, only a partial frame keeps it attached while we wait for more
+    void CompactReceiveBuffer()
+    {
+        if (!_receiveBuffer)
+            return;
+
+        size_t activeSize = _receiveBuffer->GetActiveSize();
+        if (activeSize == 0)
+        {
+            // Shared memory channels have no readiness to wait on, they keep a regular buffer for as long as they live
+            if (_sharedMemory && _receiveBuffer->size <= NETWORK_BUFFER_SIZE)
+                _receiveBuffer->Reset();
+            else
+                _receiveBuffer.reset();
+
+            return;
+        }
+
+        // Once encrypted the unit we wait for is a record rather than a frame
+        size_t frameSize = NETWORK_BUFFER_SIZE;
+        if (_cipher)
+        {
+            if (activeSize >= StreamCipher::RECORD_HEADER_SIZE)
+                StreamCipher::GetRecordSize(_receiveBuffer->GetReadPointer(), frameSize);
+        }
+        else if (activeSize >= sizeof(PacketHeader))
+        {
+            PacketHeader header;
+            _receiveBuffer->Get<PacketHeader>(header, _receiveBuffer->readData);
+            frameSize = sizeof(PacketHeader) + header.size;
+        }
+
+        // Frames larger than our regular buffer are assembled in a large pooled buffer until they have been consumed
+        if (frameSize > _receiveBuffer->size)
+        {
+            std::shared_ptr<Bytebuffer> largeBuffer = _cipher ? Bytebuffer::Borrow<NETWORK_MAX_RECORD_SIZE>() : Bytebuffer::Borrow<NETWORK_MAX_FRAME_SIZE>();
+            largeBuffer->PutBytes(_receiveBuffer->GetReadPointer(), activeSize);
+
+            _receiveBuffer = largeBuffer;
+            return;
+        }
+
+        if (_receiveBuffer->readData == 0)
+            return;
+
+        std::memmove(_receiveBuffer->GetDataPointer(), _receiveBuffer->GetReadPointer(), activeSize);
+        _receiveBuffer->readData = 0;
+        _receiveBuffer->writtenData = activeSize;
+    }
+
     std::shared_ptr<Bytebuffer> _receiveBuffer;
-    std::shared_ptr<Bytebuffer> _sendBuffer;
+    PacketBatch _packetBatch;
+    PacketBatch _packetViews;
+    std::vector<std::shared_ptr<Bytebuffer>> _inflateBuffers;
+    // Only ever inflates and is only touched by the read path, deflating sends is left to _compressor under _sendMutex
+    std::unique_ptr<PacketCompressor> _decompressor;
+    std::unique_ptr<StreamCipher> _cipher;
+    Opcode _encryptionBarrier = Opcode::INVALID;
+    bool _hasHeldBackData = false;
+    std::shared_ptr<PacketCaptureWriter> _packetCapture;
+    u64 _packetCaptureId = 0;
+    std::chrono::steady_clock::time_point _lastReceiveTime = std::chrono::steady_clock::now();
+
+    std::mutex _sendMutex;
+    std::array<SendLaneQueue, static_cast<size_t>(SendLane::COUNT)> _sendLanes;
+    std::shared_ptr<Bytebuffer> _bundleBuffer;
+    std::unique_ptr<PacketCompressor> _compressor;
+    size_t _bundleFlushThreshold = NETWORK_BUNDLE_FLUSH_THRESHOLD;
+    std::atomic<bool> _isBundling = false;
+    std::vector<QueuedFrames> _sendQueue;
+    std::vector<QueuedFrames> _sendInFlight;
+    std::vector<asio::const_buffer> _sendGatherBuffers;
+    std::atomic<size_t> _sendQueuedBytes = 0;
+    std::atomic<u64> _numSends = 0;
+    std::atomic<u64> _numSupersededSends = 0;
+    std::atomic<u64> _numBundleFlushes = 0;
+    size_t _sendLowWatermark = NETWORK_SEND_LOW_WATERMARK;
+    size_t _sendHighWatermark = NETWORK_SEND_HIGH_WATERMARK;
+    bool _isWriting = false;
+    std::atomic<bool> _isSendBackpressured = false;
 
     bool _isClosed = false;
     tcp::socket* _socket;
-    std::function<void(BaseSocket*)> _readHandler;
+    std::shared_ptr<SharedMemoryChannel> _sharedMemory;
+    std::shared_ptr<IoUringContext> _ioUring;
+    std::function<void(BaseSocket*, PacketBatch&)> _readHandler;
     std::function<void(BaseSocket*, bool)> _connectHandler;
     std::function<void(BaseSocket*)> _disconnectHandler;
+    std::function<void(BaseSocket*, bool)> _backpressureHandler;
+    std::function<void(BaseSocket*)> _closeHandler;
 };
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+#include "../../NovusTypes.h"
+
+// Generational handle into a ConnectionRegistry, handles to removed connections never resolve again even if their slot is reused
+struct ConnectionHandle
+{
+    static constexpr u32 INVALID_INDEX = 0xFFFFFFFF;
+
+    u32 index = INVALID_INDEX;
+    u32 generation = 0;
+
+    bool IsValid() const { return index != INVALID_INDEX; }
+    u64 ToU64() const { return (static_cast<u64>(generation) << 32) | index; }
+
+    bool operator==(const ConnectionHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const ConnectionHandle& other) const { return !(*this == other); }
+};
@@ -0,0 +1,104 @@
+#include "ConnectionRegistry.h"
+#include "NetworkClient.h"
+#include <cassert>
+
+ConnectionRegistry::~ConnectionRegistry()
+{
+    for (u32 i = 0; i < MAX_CHUNKS; i++)
+    {
+        delete[] _chunks[i].load();
+    }
+}
+
+ConnectionHandle ConnectionRegistry::Add(std::shared_ptr<NetworkClient> client)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    u32 index = 0;
+    if (!_freeSlots.empty())
+    {
+        index = _freeSlots.back();
+        _freeSlots.pop_back();
+    }
+    else
+    {
+        index = _slotCount.load();
+        assert(index < CHUNK_SIZE * MAX_CHUNKS);
+
+        u32 chunkIndex = index / CHUNK_SIZE;
+        if (_chunks[chunkIndex].load() == nullptr)
+            _chunks[chunkIndex].store(new Slot[CHUNK_SIZE], std::memory_order_release);
+
+        _slotCount.store(index + 1, std::memory_order_release);
+    }
+
+    Slot& slot = GetSlot(index);
+    slot.owner = client;
+    slot.client.store(client.get());
+    _count++;
+
+    ConnectionHandle handle;
+    handle.index = index;
+    handle.generation = slot.generation.load();
+    return handle;
+}
+
+bool ConnectionRegistry::Remove(ConnectionHandle handle)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (handle.index >= _slotCount.load())
+        return false;
+
+    Slot& slot = GetSlot(handle.index);
+    if (slot.client.load() == nullptr || slot.generation.load() != handle.generation)
+        return false;
+
+    slot.client.store(nullptr);
+    slot.generation++;
+    _count--;
+
+    _retiredSlots.push_back({ handle.index, std::move(slot.owner) });
+    _hasRetired = true;
+
+    // Readers that started before the store above may still be looking at the client, they reclaim it when they leave
+    if (_readers.load() == 0)
+        Reclaim();
+
+    return true;
+}
+
+std::shared_ptr<NetworkClient> ConnectionRegistry::Get(ConnectionHandle handle)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (handle.index >= _slotCount.load())
+        return nullptr;
+
+    Slot& slot = GetSlot(handle.index);
+    if (slot.client.load() == nullptr || slot.generation.load() != handle.generation)
+        return nullptr;
+
+    return slot.owner;
+}
+
+void ConnectionRegistry::Reclaim()
+{
+    for (RetiredSlot& retiredSlot : _retiredSlots)
+    {
+        _freeSlots.push_back(retiredSlot.index);
+    }
+
+    _retiredSlots.clear();
+    _hasRetired = false;
+}
+
+void ConnectionRegistry::TryReclaim()
+{
+    std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    if (_readers.load() == 0)
+        Reclaim();
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <NovusTypes.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ConnectionHandle.h"
+
+class NetworkClient;
+
+/*
+    Slot map of live connections.
+
+    Add and Remove are O(1) and serialized by a mutex, iterating the live connections takes no lock at all.
+    Slots live in chunks that are never moved or freed, and a removed connection is only released (and its
+    slot reused) once no iteration is in flight, so iterators can safely use the raw pointers they are handed.
+*/
+class ConnectionRegistry
+{
+public:
+    static constexpr u32 CHUNK_SIZE = 1024;
+    static constexpr u32 MAX_CHUNKS = 1024;
+
+    ConnectionRegistry() { }
+    ~ConnectionRegistry();
+
+    ConnectionHandle Add(std::shared_ptr<NetworkClient> client);
+    bool Remove(ConnectionHandle handle);
+    std::shared_ptr<NetworkClient> Get(ConnectionHandle handle);
+
+    size_t Count() { return _count; }
+
+    // Calls func(NetworkClient*) for every live connection, the pointer must not be kept past the call
+    template <typename Func>
+    void ForEach(Func&& func)
+    {
+        ReadScope scope(this);
+
+        u32 slotCount = _slotCount.load(std::memory_order_acquire);
+        for (u32 i = 0; i < slotCount; i++)
+        {
+            NetworkClient* client = GetSlot(i).client.load();
+            if (client)
+                func(client);
+        }
+    }
+
+    // Calls func(NetworkClient*) for every handle that still resolves to a live connection
+    template <typename Func>
+    void ForEach(const std::vector<ConnectionHandle>& handles, Func&& func)
+    {
+        ReadScope scope(this);
+
+        u32 slotCount = _slotCount.load(std::memory_order_acquire);
+        for (const ConnectionHandle& handle : handles)
+        {
+            if (handle.index >= slotCount)
+                continue;
+
+            Slot& slot = GetSlot(handle.index);
+            NetworkClient* client = slot.client.load();
+            if (client && slot.generation.load() == handle.generation)
+                func(client);
+        }
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<NetworkClient*> client = nullptr;
+        std::atomic<u32> generation = 0;
+        std::shared_ptr<NetworkClient> owner;
+    };
+    struct RetiredSlot
+    {
+        u32 index;
+        std::shared_ptr<NetworkClient> owner;
+    };
+    struct ReadScope
+    {
+        ReadScope(ConnectionRegistry* inRegistry) : registry(inRegistry) { registry->_readers++; }
+        ~ReadScope()
+        {
+            if (--registry->_readers == 0 && registry->_hasRetired)
+                registry->TryReclaim();
+        }
+
+        ConnectionRegistry* registry;
+    };
+
+    Slot& GetSlot(u32 index) { return _chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE]; }
+
+    // Must be called with _mutex held
+    void Reclaim();
+    void TryReclaim();
+
+    std::mutex _mutex;
+    std::atomic<Slot*> _chunks[MAX_CHUNKS] = { };
+    std::atomic<u32> _slotCount = 0;
+    std::atomic<size_t> _count = 0;
+
+    std::vector<u32> _freeSlots;
+    std::vector<RetiredSlot> _retiredSlots;
+    std::atomic<i32> _readers = 0;
+    std::atomic<bool> _hasRetired = false;
+};
@@ -1,3 +1,49 @@
 #pragma once
 
-#define NETWORK_BUFFER_SIZE 16384
\ No newline at end of file
+#define NETWORK_BUFFER_SIZE 16384
+
+// sizeof(PacketHeader) + the largest payload a u16 size can describe
+#define NETWORK_MAX_FRAME_SIZE 65539
+
+#define NETWORK_SEND_LOW_WATERMARK 131072
+#define NETWORK_SEND_HIGH_WATERMARK 524288
+// Most bytes a socket takes from its send lanes for one write, anything queued after that can still overtake the rest
+#define NETWORK_SEND_BATCH_SIZE 65536
+// A tick bundle is flushed before FlushTick once it holds this many bytes
+#define NETWORK_BUNDLE_FLUSH_THRESHOLD 16384
+
+// Payloads larger than this are never compressed so the deflated frame is guaranteed to fit in a u16 size
+#define NETWORK_COMPRESSION_MAX_INPUT 64512
+#define NETWORK_COMPRESSION_THRESHOLD 1024
+#define NETWORK_COMPRESSION_LEVEL 6
+#define NETWORK_COMPRESSION_WINDOW_BITS 15
+#define NETWORK_COMPRESSION_MEM_LEVEL 8
+// PacketCompressor only times one packet per opcode out of this many, must be a power of two
+#define NETWORK_COMPRESSION_TIMING_SAMPLE_RATE 64
+
+// Size of each direction of a shared memory channel, must be a power of two
+#define NETWORK_SHARED_MEMORY_RING_SIZE 1048576
+// Milliseconds a connecting process gets to hand over its segment before the listener drops it
+#define NETWORK_SHARED_MEMORY_HANDSHAKE_TIMEOUT 1000
+
+// Datagrams are kept below the smallest MTU we expect to see so they are never fragmented
+#define NETWORK_UDP_MAX_DATAGRAM 1200
+
+// Length of one tick of the timing wheel in milliseconds
+#define NETWORK_TIMER_RESOLUTION 10
+
+// Capture files are sized for this many bytes while open, packets past it are dropped
+#define NETWORK_CAPTURE_MAX_SIZE 1073741824
+
+// A record holding one frame of NETWORK_MAX_FRAME_SIZE plus the record size and tag, see StreamCipher
+#define NETWORK_MAX_RECORD_SIZE 65559
+// StreamCipher only times one record out of this many, must be a power of two
+#define NETWORK_CIPHER_TIMING_SAMPLE_RATE 64
+
+// Submission queue size of every io_uring, the completion queue is twice as large
+#define NETWORK_IO_URING_ENTRIES 4096
+// Receive buffers registered with every io_uring, each is NETWORK_BUFFER_SIZE bytes pinned against RLIMIT_MEMLOCK
+#define NETWORK_IO_URING_FIXED_BUFFERS 256
+
+// Changes a ServerDirectory remembers, nodes that fell further behind than this are sent a snapshot
+#define NETWORK_DIRECTORY_HISTORY_SIZE 4096
@@ -0,0 +1,323 @@
+#include "EntityReplication.h"
+#include <cassert>
+#include <cstring>
+
+enum DeltaFlags : u8
+{
+    DELTA_FLAG_FULL = 1 << 0
+};
+
+static u32 QuantizeHalf(f32 value)
+{
+    return half_float::detail::float2half<static_cast<std::float_round_style>(HALF_ROUND_STYLE)>(value);
+}
+static f32 DequantizeHalf(u32 bits)
+{
+    return half_float::detail::half2float<f32>(static_cast<half_float::detail::uint16>(bits));
+}
+static u32 FloatBits(f32 value)
+{
+    u32 bits = 0;
+    std::memcpy(&bits, &value, sizeof(u32));
+    return bits;
+}
+static f32 BitsFloat(u32 bits)
+{
+    f32 value = 0;
+    std::memcpy(&value, &bits, sizeof(u32));
+    return value;
+}
+
+u8 ReplicationSchema::AddField(ReplicatedFieldType type)
+{
+    assert(_types.size() < MAX_REPLICATED_FIELDS);
+
+    u8 field = static_cast<u8>(_types.size());
+    _types.push_back(type);
+    _wordOffsets.push_back(_numWords);
+    _numWords += GetNumWords(field);
+
+    assert(_numWords <= MAX_REPLICATED_WORDS);
+    return field;
+}
+u32 ReplicationSchema::GetNumWords(u32 field) const
+{
+    ReplicatedFieldType type = _types[field];
+    return (type == ReplicatedFieldType::VEC3 || type == ReplicatedFieldType::HVEC3) ? 3 : 1;
+}
+u32 ReplicationSchema::GetWireSize(u32 field) const
+{
+    switch (_types[field])
+    {
+        case ReplicatedFieldType::U8: return 1;
+        case ReplicatedFieldType::U16: return 2;
+        case ReplicatedFieldType::U32: return 4;
+        case ReplicatedFieldType::F32: return 4;
+        case ReplicatedFieldType::F16: return 2;
+        case ReplicatedFieldType::VEC3: return 12;
+        case ReplicatedFieldType::HVEC3: return 6;
+    }
+
+    return 0;
+}
+
+void EntityState::SetU32(const ReplicationSchema& schema, u32 field, u32 value)
+{
+    words[schema.GetWordOffset(field)] = value;
+}
+void EntityState::SetF32(const ReplicationSchema& schema, u32 field, f32 value)
+{
+    bool isHalf = schema.GetType(field) == ReplicatedFieldType::F16;
+    words[schema.GetWordOffset(field)] = isHalf ? QuantizeHalf(value) : FloatBits(value);
+}
+void EntityState::SetVec3(const ReplicationSchema& schema, u32 field, const vec3& value)
+{
+    bool isHalf = schema.GetType(field) == ReplicatedFieldType::HVEC3;
+    u32 offset = schema.GetWordOffset(field);
+
+    for (u32 i = 0; i < 3; i++)
+    {
+        words[offset + i] = isHalf ? QuantizeHalf(value[i]) : FloatBits(value[i]);
+    }
+}
+
+u32 EntityState::GetU32(const ReplicationSchema& schema, u32 field) const
+{
+    return words[schema.GetWordOffset(field)];
+}
+f32 EntityState::GetF32(const ReplicationSchema& schema, u32 field) const
+{
+    bool isHalf = schema.GetType(field) == ReplicatedFieldType::F16;
+    u32 bits = words[schema.GetWordOffset(field)];
+
+    return isHalf ? DequantizeHalf(bits) : BitsFloat(bits);
+}
+vec3 EntityState::GetVec3(const ReplicationSchema& schema, u32 field) const
+{
+    bool isHalf = schema.GetType(field) == ReplicatedFieldType::HVEC3;
+    u32 offset = schema.GetWordOffset(field);
+
+    vec3 value;
+    for (u32 i = 0; i < 3; i++)
+    {
+        value[i] = isHalf ? DequantizeHalf(words[offset + i]) : BitsFloat(words[offset + i]);
+    }
+
+    return value;
+}
+
+bool EntityState::FieldEquals(const ReplicationSchema& schema, u32 field, const EntityState& other) const
+{
+    u32 offset = schema.GetWordOffset(field);
+    return std::memcmp(&words[offset], &other.words[offset], schema.GetNumWords(field) * sizeof(u32)) == 0;
+}
+
+static bool FieldEquals(const ReplicationSchema& schema, u32 field, const EntityState& state, const u32* words)
+{
+    u32 offset = schema.GetWordOffset(field);
+    return std::memcmp(&state.words[offset], words + offset, schema.GetNumWords(field) * sizeof(u32)) == 0;
+}
+
+static bool WriteField(std::shared_ptr<Bytebuffer>& buffer, const ReplicationSchema& schema, u32 field, const EntityState& state)
+{
+    const u32* words = &state.words[schema.GetWordOffset(field)];
+
+    switch (schema.GetType(field))
+    {
+        case ReplicatedFieldType::U8: return buffer->PutU8(static_cast<u8>(words[0]));
+        case ReplicatedFieldType::U16:
+        case ReplicatedFieldType::F16: return buffer->PutU16(static_cast<u16>(words[0]));
+        case ReplicatedFieldType::U32:
+        case ReplicatedFieldType::F32: return buffer->PutU32(words[0]);
+        case ReplicatedFieldType::VEC3: return buffer->PutU32(words[0]) && buffer->PutU32(words[1]) && buffer->PutU32(words[2]);
+        case ReplicatedFieldType::HVEC3: return buffer->PutU16(static_cast<u16>(words[0])) && buffer->PutU16(static_cast<u16>(words[1])) && buffer->PutU16(static_cast<u16>(words[2]));
+    }
+
+    return false;
+}
+static bool ReadField(std::shared_ptr<Bytebuffer>& buffer, const ReplicationSchema& schema, u32 field, EntityState& state)
+{
+    u32* words = &state.words[schema.GetWordOffset(field)];
+    u8 u8Value = 0;
+    u16 u16Values[3] = { };
+
+    switch (schema.GetType(field))
+    {
+        case ReplicatedFieldType::U8:
+            if (!buffer->GetU8(u8Value))
+                return false;
+
+            words[0] = u8Value;
+            return true;
+        case ReplicatedFieldType::U16:
+        case ReplicatedFieldType::F16:
+            if (!buffer->GetU16(u16Values[0]))
+                return false;
+
+            words[0] = u16Values[0];
+            return true;
+        case ReplicatedFieldType::U32:
+        case ReplicatedFieldType::F32: return buffer->GetU32(words[0]);
+        case ReplicatedFieldType::VEC3: return buffer->GetU32(words[0]) && buffer->GetU32(words[1]) && buffer->GetU32(words[2]);
+        case ReplicatedFieldType::HVEC3:
+            if (!buffer->GetU16(u16Values[0]) || !buffer->GetU16(u16Values[1]) || !buffer->GetU16(u16Values[2]))
+                return false;
+
+            words[0] = u16Values[0];
+            words[1] = u16Values[1];
+            words[2] = u16Values[2];
+            return true;
+    }
+
+    return false;
+}
+
+bool DeltaEncoder::Encode(std::shared_ptr<Bytebuffer>& buffer, entt::entity entity, const EntityState& state, u32 sequence)
+{
+    EntityBaseline& entityBaseline = _entities[entity];
+
+    u32 numWords = _schema->GetNumStateWords();
+    if (entityBaseline.words.size() != (MAX_PENDING + 1) * numWords)
+        entityBaseline.words.resize((MAX_PENDING + 1) * numWords);
+
+    // The client only remembers its last few states, if the baseline could have been pushed out we have to start over
+    bool isFull = !entityBaseline.hasBaseline || entityBaseline.numPending >= MAX_PENDING - 1;
+
+    u32 numFields = _schema->GetNumFields();
+    u32 fieldMask = 0;
+    size_t payloadSize = 0;
+    for (u32 i = 0; i < numFields; i++)
+    {
+        if (isFull || !FieldEquals(*_schema, i, state, entityBaseline.words.data()))
+        {
+            fieldMask |= 1u << i;
+            payloadSize += _schema->GetWireSize(i);
+        }
+    }
+
+    // With updates in flight an empty mask still matters, it takes the client back to the baseline
+    if (fieldMask == 0 && !isFull && entityBaseline.numPending == 0)
+        return true;
+
+    size_t headerSize = sizeof(entt::entity) + sizeof(u8) + sizeof(u32) + (isFull ? 0 : sizeof(u32)) + sizeof(u32);
+    if (!buffer->CanPerformWrite(headerSize + payloadSize))
+        return false;
+
+    buffer->PutEnttId(entity);
+    buffer->PutU8(isFull ? DELTA_FLAG_FULL : 0);
+    buffer->PutU32(sequence);
+    if (!isFull)
+        buffer->PutU32(entityBaseline.baselineSequence);
+    buffer->PutU32(fieldMask);
+
+    for (u32 i = 0; i < numFields; i++)
+    {
+        if (fieldMask & (1u << i))
+            WriteField(buffer, *_schema, i, state);
+    }
+
+    if (entityBaseline.numPending == MAX_PENDING)
+    {
+        std::memmove(&entityBaseline.pendingSequences[0], &entityBaseline.pendingSequences[1], sizeof(u32) * (MAX_PENDING - 1));
+        std::memmove(GetPendingWords(entityBaseline, 0), GetPendingWords(entityBaseline, 1), sizeof(u32) * numWords * (MAX_PENDING - 1));
+        entityBaseline.numPending--;
+    }
+
+    entityBaseline.pendingSequences[entityBaseline.numPending] = sequence;
+    std::memcpy(GetPendingWords(entityBaseline, entityBaseline.numPending), state.words.data(), sizeof(u32) * numWords);
+    entityBaseline.numPending++;
+
+    return true;
+}
+
+void DeltaEncoder::Acknowledge(u32 sequence)
+{
+    for (auto& pair : _entities)
+    {
+        Acknowledge(pair.second, sequence);
+    }
+}
+void DeltaEncoder::Acknowledge(entt::entity entity, u32 sequence)
+{
+    auto itr = _entities.find(entity);
+    if (itr != _entities.end())
+        Acknowledge(itr->second, sequence);
+}
+void DeltaEncoder::Acknowledge(EntityBaseline& entityBaseline, u32 sequence)
+{
+    // The newest update the client has received becomes the baseline, everything older than it is no longer needed
+    u32 numAcknowledged = 0;
+    while (numAcknowledged < entityBaseline.numPending && entityBaseline.pendingSequences[numAcknowledged] <= sequence)
+    {
+        numAcknowledged++;
+    }
+
+    if (numAcknowledged == 0)
+        return;
+
+    u32 numWords = _schema->GetNumStateWords();
+    entityBaseline.hasBaseline = true;
+    entityBaseline.baselineSequence = entityBaseline.pendingSequences[numAcknowledged - 1];
+    std::memcpy(entityBaseline.words.data(), GetPendingWords(entityBaseline, numAcknowledged - 1), sizeof(u32) * numWords);
+
+    entityBaseline.numPending -= numAcknowledged;
+    std::memmove(&entityBaseline.pendingSequences[0], &entityBaseline.pendingSequences[numAcknowledged], sizeof(u32) * entityBaseline.numPending);
+    std::memmove(GetPendingWords(entityBaseline, 0), GetPendingWords(entityBaseline, numAcknowledged), sizeof(u32) * numWords * entityBaseline.numPending);
+}
+
+bool DeltaDecoder::Decode(std::shared_ptr<Bytebuffer>& buffer, entt::entity& entity, EntityState& state, u32& sequence)
+{
+    u32 entityId = 0;
+    u8 flags = 0;
+    u32 baselineSequence = 0;
+    u32 fieldMask = 0;
+
+    if (!buffer->GetU32(entityId) || !buffer->GetU8(flags) || !buffer->GetU32(sequence))
+        return false;
+
+    entity = static_cast<entt::entity>(entityId);
+    EntityHistory& history = _entities[entity];
+
+    if (flags & DELTA_FLAG_FULL)
+    {
+        state = EntityState();
+    }
+    else
+    {
+        if (!buffer->GetU32(baselineSequence))
+            return false;
+
+        const ReceivedState* baseline = nullptr;
+        for (const ReceivedState& receivedState : history.states)
+        {
+            if (receivedState.isValid && receivedState.sequence == baselineSequence)
+            {
+                baseline = &receivedState;
+                break;
+            }
+        }
+
+        if (baseline == nullptr)
+            return false;
+
+        state = baseline->state;
+    }
+
+    if (!buffer->GetU32(fieldMask))
+        return false;
+
+    u32 numFields = _schema->GetNumFields();
+    for (u32 i = 0; i < numFields; i++)
+    {
+        if ((fieldMask & (1u << i)) && !ReadField(buffer, *_schema, i, state))
+            return false;
+    }
+
+    ReceivedState& receivedState = history.states[history.next];
+    receivedState.sequence = sequence;
+    receivedState.isValid = true;
+    receivedState.state = state;
+    history.next = (history.next + 1) % HISTORY_SIZE;
+
+    return true;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <NovusTypes.h>
+#include <Utils/ByteBuffer.h>
+#include <entity/fwd.hpp>
+#include <robin_hood.h>
+#include <array>
+#include <vector>
+
+enum class ReplicatedFieldType : u8
+{
+    U8,
+    U16,
+    U32,
+    F32,
+    F16, // f32 quantized to a half on the wire
+    VEC3,
+    HVEC3 // vec3 quantized to a hvec3 on the wire, only suited for small ranges such as velocities or rotations
+};
+
+constexpr u32 MAX_REPLICATED_FIELDS = 32;
+constexpr u32 MAX_REPLICATED_WORDS = 64;
+
+// Describes the fields of a replicated entity, shared by the encoder on the server and the decoder on the client
+class ReplicationSchema
+{
+public:
+    u8 AddField(ReplicatedFieldType type);
+
+    u32 GetNumFields() const { return static_cast<u32>(_types.size()); }
+    u32 GetNumStateWords() const { return _numWords; }
+    ReplicatedFieldType GetType(u32 field) const { return _types[field]; }
+    u32 GetWordOffset(u32 field) const { return _wordOffsets[field]; }
+    u32 GetNumWords(u32 field) const;
+    u32 GetWireSize(u32 field) const;
+
+private:
+    std::vector<ReplicatedFieldType> _types;
+    std::vector<u32> _wordOffsets;
+    u32 _numWords = 0;
+};
+
+// The value of every field, stored the way it is sent so comparing two states ignores changes that don't survive quantization
+struct EntityState
+{
+    void SetU32(const ReplicationSchema& schema, u32 field, u32 value);
+    void SetF32(const ReplicationSchema& schema, u32 field, f32 value);
+    void SetVec3(const ReplicationSchema& schema, u32 field, const vec3& value);
+
+    u32 GetU32(const ReplicationSchema& schema, u32 field) const;
+    f32 GetF32(const ReplicationSchema& schema, u32 field) const;
+    vec3 GetVec3(const ReplicationSchema& schema, u32 field) const;
+
+    bool FieldEquals(const ReplicationSchema& schema, u32 field, const EntityState& other) const;
+
+    std::array<u32, MAX_REPLICATED_WORDS> words = { };
+};
+
+/*
+    Server side, one per client.
+
+    Every update is encoded against the last state the client acknowledged for that entity and only carries the fields
+    that differ from it. Until a baseline has been acknowledged, or when too many updates went unacknowledged for the
+    client to still remember the baseline, a full snapshot is sent instead.
+
+    Wire format per entity: entity, u8 flags, u32 sequence, [u32 baseline sequence], u32 field mask, changed field values
+*/
+class DeltaEncoder
+{
+public:
+    // Must match DeltaDecoder::HISTORY_SIZE
+    static constexpr u32 MAX_PENDING = 8;
+
+    DeltaEncoder(const ReplicationSchema* schema) : _schema(schema) { }
+
+    // Returns false if the buffer is full. An entity that matches its baseline and has nothing in flight writes nothing
+    bool Encode(std::shared_ptr<Bytebuffer>& buffer, entt::entity entity, const EntityState& state, u32 sequence);
+
+    // The client has received every update up to and including sequence
+    void Acknowledge(u32 sequence);
+    void Acknowledge(entt::entity entity, u32 sequence);
+
+    // The entity left the client's view, the next update will be a full snapshot
+    void Forget(entt::entity entity) { _entities.erase(entity); }
+
+private:
+    struct EntityBaseline
+    {
+        bool hasBaseline = false;
+        u32 baselineSequence = 0;
+
+        u32 numPending = 0;
+        std::array<u32, MAX_PENDING> pendingSequences = { };
+
+        // Only the words the schema uses, the baseline followed by every pending state
+        std::vector<u32> words;
+    };
+
+    void Acknowledge(EntityBaseline& entityBaseline, u32 sequence);
+    u32* GetPendingWords(EntityBaseline& entityBaseline, u32 index) { return entityBaseline.words.data() + (index + 1) * _schema->GetNumStateWords(); }
+
+    const ReplicationSchema* _schema;
+    robin_hood::unordered_map<entt::entity, EntityBaseline> _entities;
+};
+
+// Client side, rebuilds full entity states from the updates written by DeltaEncoder
+class DeltaDecoder
+{
+public:
+    static constexpr u32 HISTORY_SIZE = DeltaEncoder::MAX_PENDING;
+
+    DeltaDecoder(const ReplicationSchema* schema) : _schema(schema) { }
+
+    // Returns false if the update is malformed or references a baseline we no longer have
+    bool Decode(std::shared_ptr<Bytebuffer>& buffer, entt::entity& entity, EntityState& state, u32& sequence);
+
+    void Forget(entt::entity entity) { _entities.erase(entity); }
+
+private:
+    struct ReceivedState
+    {
+        u32 sequence = 0;
+        bool isValid = false;
+        EntityState state;
+    };
+    struct EntityHistory
+    {
+        u32 next = 0;
+        std::array<ReceivedState, HISTORY_SIZE> states;
+    };
+
+    const ReplicationSchema* _schema;
+    robin_hood::unordered_map<entt::entity, EntityHistory> _entities;
+};
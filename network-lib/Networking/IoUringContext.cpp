@@ -0,0 +1,614 @@
+#include "IoUringContext.h"
+#include <Utils/DebugHandler.h>
+#include <cstring>
+
+#ifdef NETWORK_IO_URING_SUPPORTED
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <climits>
+#include <unistd.h>
+
+// glibc has no wrappers for these and we don't want to depend on liburing for three syscalls
+static int SetupRing(u32 numEntries, io_uring_params& params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, numEntries, &params));
+}
+static int EnterRing(int ringFd, u32 numSubmit)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, numSubmit, 0, 0, nullptr, 0));
+}
+static int RegisterRing(int ringFd, u32 opcode, void* arg, u32 numArgs)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, ringFd, opcode, arg, numArgs));
+}
+
+// Without fast poll the kernel waits for sockets on a worker thread, which is slower than the reactor we replace
+constexpr u32 IO_URING_REQUIRED_FEATURES = IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL;
+
+struct IoUringOperation
+{
+    IoUringContext::Handler handler;
+    int fd = -1;
+    bool isWrite = false;
+
+    // Writes keep their own copy of the gather list, short writes advance it in place and are submitted again
+    std::vector<iovec> iovecs;
+    size_t iovecIndex = 0;
+    msghdr message;
+    size_t bytesTransferred = 0;
+};
+
+struct IoUringBufferSlab
+{
+    ~IoUringBufferSlab()
+    {
+        if (data)
+            munmap(data, size);
+    }
+
+    u8* data = nullptr;
+    size_t size = 0;
+
+    std::mutex mutex;
+    std::vector<u32> freeSlots;
+};
+
+IoUringContext::IoUringContext(asio::io_context& context, u32 numEntries, u32 numFixedBuffers) : _context(context), _wake(context)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    int ringFd = SetupRing(numEntries, params);
+    if (ringFd < 0)
+    {
+        DebugHandler::PrintWarning("[IoUring]: Failed to set up a ring with %u entries (%s)", numEntries, std::strerror(errno));
+        return;
+    }
+
+    _ringFd = ringFd;
+    if ((params.features & IO_URING_REQUIRED_FEATURES) != IO_URING_REQUIRED_FEATURES)
+    {
+        DebugHandler::PrintWarning("[IoUring]: The kernel can't poll sockets from the ring, io_uring needs Linux 5.7 or later");
+        Close();
+        return;
+    }
+
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+    _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+
+    void* sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        DebugHandler::PrintWarning("[IoUring]: Failed to map the submission ring");
+        Close();
+        return;
+    }
+    _sqRing = static_cast<u8*>(sqRing);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        _cqRing = _sqRing;
+    }
+    else
+    {
+        void* cqRing = mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            DebugHandler::PrintWarning("[IoUring]: Failed to map the completion ring");
+            Close();
+            return;
+        }
+        _cqRing = static_cast<u8*>(cqRing);
+    }
+
+    _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        DebugHandler::PrintWarning("[IoUring]: Failed to map the submission entries");
+        Close();
+        return;
+    }
+    _sqes = static_cast<io_uring_sqe*>(sqes);
+
+    _sqHead = reinterpret_cast<u32*>(_sqRing + params.sq_off.head);
+    _sqTail = reinterpret_cast<u32*>(_sqRing + params.sq_off.tail);
+    _sqArray = reinterpret_cast<u32*>(_sqRing + params.sq_off.array);
+    _sqMask = *reinterpret_cast<u32*>(_sqRing + params.sq_off.ring_mask);
+    _sqEntries = params.sq_entries;
+    _cqHead = reinterpret_cast<u32*>(_cqRing + params.cq_off.head);
+    _cqTail = reinterpret_cast<u32*>(_cqRing + params.cq_off.tail);
+    _cqes = _cqRing + params.cq_off.cqes;
+    _cqMask = *reinterpret_cast<u32*>(_cqRing + params.cq_off.ring_mask);
+
+    int wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd < 0 || RegisterRing(ringFd, IORING_REGISTER_EVENTFD, &wakeFd, 1) != 0)
+    {
+        DebugHandler::PrintWarning("[IoUring]: Failed to register the completion eventfd");
+        if (wakeFd >= 0)
+            close(wakeFd);
+
+        Close();
+        return;
+    }
+
+    asio::error_code error;
+    _wake.assign(wakeFd, error);
+    if (error)
+    {
+        close(wakeFd);
+        Close();
+        return;
+    }
+
+    // Registering pins the slab once instead of on every read, it counts against RLIMIT_MEMLOCK so we carry on without it if that is too low
+    if (numFixedBuffers > 0)
+    {
+        std::shared_ptr<IoUringBufferSlab> slab = std::make_shared<IoUringBufferSlab>();
+        size_t slabSize = static_cast<size_t>(numFixedBuffers) * NETWORK_BUFFER_SIZE;
+
+        void* slabData = mmap(nullptr, slabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (slabData != MAP_FAILED)
+        {
+            slab->data = static_cast<u8*>(slabData);
+            slab->size = slabSize;
+
+            iovec slabVector;
+            slabVector.iov_base = slab->data;
+            slabVector.iov_len = slab->size;
+
+            if (RegisterRing(ringFd, IORING_REGISTER_BUFFERS, &slabVector, 1) == 0)
+            {
+                slab->freeSlots.reserve(numFixedBuffers);
+                for (u32 i = numFixedBuffers; i > 0; i--)
+                {
+                    slab->freeSlots.push_back(i - 1);
+                }
+
+                _slab = slab;
+            }
+        }
+
+        if (!_slab)
+            DebugHandler::PrintWarning("[IoUring]: Failed to register %u receive buffers, reads go to regular buffers", numFixedBuffers);
+    }
+
+    WaitForCompletions();
+}
+IoUringContext::~IoUringContext()
+{
+    Close();
+}
+
+bool IoUringContext::IsSupported()
+{
+    static bool isSupported = []()
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        int ringFd = SetupRing(2, params);
+        if (ringFd < 0)
+            return false;
+
+        close(ringFd);
+        return (params.features & IO_URING_REQUIRED_FEATURES) == IO_URING_REQUIRED_FEATURES;
+    }();
+
+    return isSupported;
+}
+
+void IoUringContext::Close()
+{
+    // Handlers may hold the last reference to their socket, they are destroyed once we let go of the lock
+    std::vector<std::unique_ptr<IoUringOperation>> operations;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_ringFd < 0)
+            return;
+
+        asio::error_code ignored;
+        _wake.close(ignored);
+
+        if (_sqes)
+            munmap(_sqes, _sqesSize);
+        if (_cqRing && _cqRing != _sqRing)
+            munmap(_cqRing, _cqRingSize);
+        if (_sqRing)
+            munmap(_sqRing, _sqRingSize);
+
+        // The kernel cancels whatever is still in flight, the slab stays pinned until it has and is freed with the last buffer
+        close(_ringFd);
+
+        _ringFd = -1;
+        _sqRing = nullptr;
+        _cqRing = nullptr;
+        _sqes = nullptr;
+        _numUnsubmitted = 0;
+
+        operations.swap(_operations);
+        _freeOperations.clear();
+    }
+}
+
+std::shared_ptr<Bytebuffer> IoUringContext::BorrowReceiveBuffer()
+{
+    if (_slab)
+    {
+        std::shared_ptr<IoUringBufferSlab> slab = _slab;
+
+        std::lock_guard<std::mutex> lock(slab->mutex);
+        if (!slab->freeSlots.empty())
+        {
+            u32 slot = slab->freeSlots.back();
+            slab->freeSlots.pop_back();
+
+            // The slab outlives us if a socket still holds one of its buffers
+            return std::shared_ptr<Bytebuffer>(new Bytebuffer(slab->data + static_cast<size_t>(slot) * NETWORK_BUFFER_SIZE, NETWORK_BUFFER_SIZE), [slab, slot](Bytebuffer* buffer)
+            {
+                delete buffer;
+
+                std::lock_guard<std::mutex> lock(slab->mutex);
+                slab->freeSlots.push_back(slot);
+            });
+        }
+    }
+
+    return Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
+}
+
+void IoUringContext::AsyncReadSome(int fd, u8* data, size_t size, Handler handler)
+{
+    asio::error_code error = asio::error::operation_aborted;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        io_uring_sqe* sqe = _ringFd >= 0 ? GetSqe() : nullptr;
+        if (_ringFd >= 0 && !sqe)
+            error = asio::error::no_buffer_space;
+
+        if (sqe)
+        {
+            // Reads into the slab skip pinning the buffer's pages, everything else is a plain recv
+            if (_slab && data >= _slab->data && data + size <= _slab->data + _slab->size)
+            {
+                sqe->opcode = IORING_OP_READ_FIXED;
+                sqe->buf_index = 0;
+                _numFixedReads++;
+            }
+            else
+            {
+                sqe->opcode = IORING_OP_RECV;
+            }
+
+            sqe->fd = fd;
+            sqe->addr = reinterpret_cast<u64>(data);
+            sqe->len = static_cast<u32>(size);
+            sqe->user_data = AddOperation(handler);
+
+            IoUringOperation& operation = *_operations[sqe->user_data];
+            operation.fd = fd;
+            operation.isWrite = false;
+
+            CommitSqe();
+            return;
+        }
+    }
+
+    asio::post(_context, std::bind(handler, error, 0));
+}
+void IoUringContext::AsyncWaitReadable(int fd, Handler handler)
+{
+    asio::error_code error = asio::error::operation_aborted;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        io_uring_sqe* sqe = _ringFd >= 0 ? GetSqe() : nullptr;
+        if (_ringFd >= 0 && !sqe)
+            error = asio::error::no_buffer_space;
+
+        if (sqe)
+        {
+            // Hangups and errors complete the poll as well, the read that follows reports them
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = fd;
+            sqe->poll_events = POLLIN;
+            sqe->user_data = AddOperation(handler);
+
+            IoUringOperation& operation = *_operations[sqe->user_data];
+            operation.fd = fd;
+            operation.isWrite = false;
+
+            CommitSqe();
+            return;
+        }
+    }
+
+    asio::post(_context, std::bind(handler, error, 0));
+}
+void IoUringContext::AsyncWrite(int fd, const std::vector<asio::const_buffer>& buffers, Handler handler)
+{
+    asio::error_code error = asio::error::operation_aborted;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_ringFd >= 0)
+        {
+            u64 operationIndex = AddOperation(handler);
+
+            IoUringOperation& operation = *_operations[operationIndex];
+            operation.fd = fd;
+            operation.isWrite = true;
+            operation.iovecIndex = 0;
+            operation.bytesTransferred = 0;
+
+            operation.iovecs.clear();
+            for (const asio::const_buffer& buffer : buffers)
+            {
+                iovec vector;
+                vector.iov_base = const_cast<void*>(buffer.data());
+                vector.iov_len = buffer.size();
+                operation.iovecs.push_back(vector);
+            }
+
+            if (QueueWrite(operationIndex))
+                return;
+
+            error = asio::error::no_buffer_space;
+            handler = std::move(operation.handler);
+            operation.handler = nullptr;
+            _freeOperations.push_back(operationIndex);
+        }
+    }
+
+    asio::post(_context, std::bind(handler, error, 0));
+}
+void IoUringContext::Flush()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_ringFd >= 0)
+        Submit();
+}
+
+io_uring_sqe* IoUringContext::GetSqe()
+{
+    u32 tail = *_sqTail;
+    if (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries)
+    {
+        Submit();
+
+        if (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries)
+            return nullptr;
+    }
+
+    io_uring_sqe* sqe = &_sqes[tail & _sqMask];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    return sqe;
+}
+void IoUringContext::CommitSqe()
+{
+    u32 tail = *_sqTail;
+    _sqArray[tail & _sqMask] = tail & _sqMask;
+
+    // The entry has to be visible before the kernel can see the new tail
+    __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    _numUnsubmitted++;
+    _numOperations++;
+    ScheduleSubmit();
+}
+u64 IoUringContext::AddOperation(Handler& handler)
+{
+    u64 operationIndex;
+    if (!_freeOperations.empty())
+    {
+        operationIndex = _freeOperations.back();
+        _freeOperations.pop_back();
+    }
+    else
+    {
+        operationIndex = _operations.size();
+        _operations.push_back(std::make_unique<IoUringOperation>());
+    }
+
+    _operations[operationIndex]->handler = std::move(handler);
+    return operationIndex;
+}
+bool IoUringContext::QueueWrite(u64 operationIndex)
+{
+    io_uring_sqe* sqe = GetSqe();
+    if (!sqe)
+        return false;
+
+    IoUringOperation& operation = *_operations[operationIndex];
+
+    std::memset(&operation.message, 0, sizeof(msghdr));
+    operation.message.msg_iov = operation.iovecs.data() + operation.iovecIndex;
+    operation.message.msg_iovlen = std::min(operation.iovecs.size() - operation.iovecIndex, static_cast<size_t>(IOV_MAX));
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = operation.fd;
+    sqe->addr = reinterpret_cast<u64>(&operation.message);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = operationIndex;
+
+    CommitSqe();
+    return true;
+}
+void IoUringContext::Submit()
+{
+    while (_numUnsubmitted > 0)
+    {
+        int result = EnterRing(_ringFd, _numUnsubmitted);
+        if (result < 0 && errno == EINTR)
+            continue;
+
+        // EBUSY means completions are backed up in the kernel, what is left goes out with the submit after the next reap
+        if (result <= 0)
+            break;
+
+        _numSubmits++;
+        _numUnsubmitted -= std::min(static_cast<u32>(result), _numUnsubmitted);
+    }
+}
+void IoUringContext::ScheduleSubmit()
+{
+    // Reaping ends with a submit anyway, everything queued by handlers in the meantime goes out with it
+    if (_isReaping || _isSubmitPosted)
+        return;
+
+    _isSubmitPosted = true;
+    asio::post(_context, std::bind(&IoUringContext::_internalSubmit, this));
+}
+
+void IoUringContext::Reap()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isReaping = true;
+    }
+
+    while (true)
+    {
+        Handler handler;
+        asio::error_code error;
+        size_t bytesTransferred = 0;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_ringFd < 0)
+                return;
+
+            u32 head = *_cqHead;
+            if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+            {
+                // Sends, and reads on sockets that already have data, usually complete during the submit itself
+                u32 numUnsubmitted = _numUnsubmitted;
+                if (numUnsubmitted > 0)
+                    Submit();
+
+                if (numUnsubmitted == 0 || _numUnsubmitted == numUnsubmitted)
+                {
+                    _isReaping = false;
+                    return;
+                }
+
+                continue;
+            }
+
+            io_uring_cqe* cqe = reinterpret_cast<io_uring_cqe*>(_cqes) + (head & _cqMask);
+            u64 operationIndex = cqe->user_data;
+            i32 result = cqe->res;
+            __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+
+            IoUringOperation& operation = *_operations[operationIndex];
+            if (operation.isWrite && result > 0)
+            {
+                operation.bytesTransferred += result;
+
+                size_t remaining = static_cast<size_t>(result);
+                while (operation.iovecIndex < operation.iovecs.size() && remaining >= operation.iovecs[operation.iovecIndex].iov_len)
+                {
+                    remaining -= operation.iovecs[operation.iovecIndex].iov_len;
+                    operation.iovecIndex++;
+                }
+
+                // Short write, the rest goes out before the handler hears about it just like asio::async_write
+                if (operation.iovecIndex < operation.iovecs.size())
+                {
+                    iovec& vector = operation.iovecs[operation.iovecIndex];
+                    vector.iov_base = static_cast<u8*>(vector.iov_base) + remaining;
+                    vector.iov_len -= remaining;
+
+                    if (QueueWrite(operationIndex))
+                        continue;
+
+                    error = asio::error::no_buffer_space;
+                }
+
+                bytesTransferred = operation.bytesTransferred;
+            }
+            else if (result < 0)
+            {
+                error = asio::error_code(-result, asio::error::get_system_category());
+                bytesTransferred = operation.bytesTransferred;
+            }
+            else if (result == 0)
+            {
+                if (operation.isWrite)
+                    error = asio::error::broken_pipe;
+                else
+                    error = asio::error::eof;
+            }
+            else
+            {
+                bytesTransferred = static_cast<size_t>(result);
+            }
+
+            handler = std::move(operation.handler);
+            operation.handler = nullptr;
+            _freeOperations.push_back(operationIndex);
+        }
+
+        handler(error, bytesTransferred);
+    }
+}
+void IoUringContext::WaitForCompletions()
+{
+    _wake.async_read_some(asio::buffer(&_wakeValue, sizeof(_wakeValue)),
+        std::bind(&IoUringContext::_internalWake, this, std::placeholders::_1, std::placeholders::_2));
+}
+void IoUringContext::_internalSubmit()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _isSubmitPosted = false;
+
+    if (_ringFd >= 0)
+        Submit();
+}
+void IoUringContext::_internalWake(asio::error_code errorCode, size_t /*bytesRead*/)
+{
+    if (errorCode)
+        return;
+
+    Reap();
+    WaitForCompletions();
+}
+#else
+struct IoUringOperation { };
+struct IoUringBufferSlab { };
+
+IoUringContext::IoUringContext(asio::io_context& context, u32 /*numEntries*/, u32 /*numFixedBuffers*/) : _context(context) { }
+IoUringContext::~IoUringContext() { }
+
+bool IoUringContext::IsSupported()
+{
+    return false;
+}
+void IoUringContext::Close() { }
+
+std::shared_ptr<Bytebuffer> IoUringContext::BorrowReceiveBuffer()
+{
+    return Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
+}
+void IoUringContext::AsyncReadSome(int /*fd*/, u8* /*data*/, size_t /*size*/, Handler handler)
+{
+    asio::post(_context, std::bind(handler, asio::error::operation_not_supported, 0));
+}
+void IoUringContext::AsyncWaitReadable(int /*fd*/, Handler handler)
+{
+    asio::post(_context, std::bind(handler, asio::error::operation_not_supported, 0));
+}
+void IoUringContext::AsyncWrite(int /*fd*/, const std::vector<asio::const_buffer>& /*buffers*/, Handler handler)
+{
+    asio::post(_context, std::bind(handler, asio::error::operation_not_supported, 0));
+}
+void IoUringContext::Flush() { }
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+#include <NovusTypes.h>
+#include <asio.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <Utils/ByteBuffer.h>
+#include "Defines.h"
+
+#if defined(__linux__) && defined(NETWORK_USE_IO_URING)
+#define NETWORK_IO_URING_SUPPORTED
+#endif
+
+enum class NetworkBackend : u8
+{
+    REACTOR, // asio's own reactor, epoll on Linux
+    IO_URING
+};
+
+struct io_uring_sqe;
+struct IoUringOperation;
+struct IoUringBufferSlab;
+
+/*
+    Drives the socket reads and writes of one io_context through an io_uring instead of asio's reactor.
+
+    Operations are queued on the submission ring and submitted together once the context gets back to its queue, so a
+    busy context makes one io_uring_enter for all of its sockets instead of a syscall per read and write. Completions are
+    signalled through an eventfd the io_context waits on, handlers always run on the context's thread.
+
+    A slab of receive buffers is registered with the kernel up front, reads into it are READ_FIXED so their pages are not
+    pinned again on every read. Multishot receive is not used, it needs the kernel to pick from a provided buffer ring
+    while every socket assembles its frames contiguously in a buffer of its own.
+*/
+class IoUringContext
+{
+public:
+    using Handler = std::function<void(asio::error_code, size_t)>;
+
+    IoUringContext(asio::io_context& context, u32 numEntries = NETWORK_IO_URING_ENTRIES, u32 numFixedBuffers = NETWORK_IO_URING_FIXED_BUFFERS);
+    ~IoUringContext();
+
+    // False when network-lib was built without NETWORK_USE_IO_URING or the kernel is too old to poll sockets from the ring
+    static bool IsSupported();
+
+    bool IsOpen() { return _ringFd >= 0; }
+    asio::io_context& GetContext() { return _context; }
+    // Drops every pending operation without calling its handler, must be called before the io_context is destroyed
+    void Close();
+
+    // Hands out a NETWORK_BUFFER_SIZE buffer from the registered slab, falls back to the regular pool once it is exhausted
+    std::shared_ptr<Bytebuffer> BorrowReceiveBuffer();
+
+    // Reads may only be started from the context's thread, writes from any thread
+    void AsyncReadSome(int fd, u8* data, size_t size, Handler handler);
+    // Completes once fd is readable without reading anything, so the caller only needs a buffer once there is data
+    void AsyncWaitReadable(int fd, Handler handler);
+    // Completes once every buffer has been written, the buffers must stay valid until the handler has been called
+    void AsyncWrite(int fd, const std::vector<asio::const_buffer>& buffers, Handler handler);
+    // Submits whatever is queued right away, sockets call this before closing a descriptor queued operations still refer to
+    void Flush();
+
+    u64 GetNumSubmits() { return _numSubmits; }
+    u64 GetNumOperations() { return _numOperations; }
+    u64 GetNumFixedReads() { return _numFixedReads; }
+
+private:
+    // These must be called with _mutex held
+    io_uring_sqe* GetSqe();
+    void CommitSqe();
+    u64 AddOperation(Handler& handler);
+    bool QueueWrite(u64 operationIndex);
+    void Submit();
+    void ScheduleSubmit();
+
+    void Reap();
+    void WaitForCompletions();
+    void _internalSubmit();
+    void _internalWake(asio::error_code errorCode, size_t bytesRead);
+
+    asio::io_context& _context;
+    std::mutex _mutex;
+    int _ringFd = -1;
+    bool _isReaping = false;
+    bool _isSubmitPosted = false;
+    u32 _numUnsubmitted = 0;
+
+    u8* _sqRing = nullptr;
+    u8* _cqRing = nullptr;
+    size_t _sqRingSize = 0;
+    size_t _cqRingSize = 0;
+    io_uring_sqe* _sqes = nullptr;
+    size_t _sqesSize = 0;
+
+    u32* _sqHead = nullptr;
+    u32* _sqTail = nullptr;
+    u32* _sqArray = nullptr;
+    u32 _sqMask = 0;
+    u32 _sqEntries = 0;
+    u32* _cqHead = nullptr;
+    u32* _cqTail = nullptr;
+    u8* _cqes = nullptr;
+    u32 _cqMask = 0;
+
+    std::vector<std::unique_ptr<IoUringOperation>> _operations;
+    std::vector<u64> _freeOperations;
+    std::shared_ptr<IoUringBufferSlab> _slab;
+
+    std::atomic<u64> _numSubmits = 0;
+    std::atomic<u64> _numOperations = 0;
+    std::atomic<u64> _numFixedReads = 0;
+
+#ifdef NETWORK_IO_URING_SUPPORTED
+    asio::posix::stream_descriptor _wake;
+    u64 _wakeValue = 0;
+#endif
+};
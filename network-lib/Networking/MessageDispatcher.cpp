@@ -0,0 +1,203 @@
+#include "MessageDispatcher.h"
+#include "MessageHandler.h"
+#include "NetworkClient.h"
+#include "NetworkPacket.h"
+
+MessageDispatcher::MessageDispatcher(MessageHandler* messageHandler, u32 numWorkers, u32 numShards) : _messageHandler(messageHandler), _isRunning(false)
+{
+    if (numWorkers == 0)
+        numWorkers = 1;
+
+    if (numShards == 0)
+        numShards = numWorkers * 4;
+
+    _shards.reserve(numShards);
+    for (u32 i = 0; i < numShards; i++)
+    {
+        _shards.push_back(std::make_unique<Shard>());
+    }
+
+    _workers.reserve(numWorkers);
+    for (u32 i = 0; i < numWorkers; i++)
+    {
+        _workers.push_back(std::make_unique<Worker>());
+    }
+
+    _messageHandler->SetCoalescedFlushHandler(std::bind(&MessageDispatcher::_internalFlushCoalesced, this, std::placeholders::_1));
+}
+MessageDispatcher::~MessageDispatcher()
+{
+    Stop();
+}
+
+void MessageDispatcher::Start()
+{
+    if (_isRunning)
+        return;
+
+    _isRunning = true;
+    for (u32 i = 0; i < _workers.size(); i++)
+    {
+        _workers[i]->thread = std::thread(&MessageDispatcher::Run, this, i);
+    }
+}
+void MessageDispatcher::Stop()
+{
+    if (!_isRunning)
+        return;
+
+    _isRunning = false;
+    for (std::unique_ptr<Worker>& worker : _workers)
+    {
+        {
+            // Taking the lock means a worker is either already waiting or sees _isRunning before it waits
+            std::lock_guard<std::mutex> lock(worker->mutex);
+        }
+        worker->condition.notify_one();
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+void MessageDispatcher::Enqueue(std::shared_ptr<NetworkClient> connection, std::shared_ptr<NetworkPacket>& packet)
+{
+    u32 shardIndex = GetShardIndex(connection.get());
+
+    DispatchJob job;
+    job.connection = std::move(connection);
+    job.packet = NetworkPacket::Copy(packet);
+
+    _shards[shardIndex]->queue.enqueue(std::move(job));
+    Wake(shardIndex);
+}
+void MessageDispatcher::Enqueue(std::shared_ptr<NetworkClient> connection, BaseSocket::PacketBatch& batch)
+{
+    if (batch.empty())
+        return;
+
+    u32 shardIndex = GetShardIndex(connection.get());
+
+    // Reused by every batch enqueued from this thread, the jobs are moved out so only the capacity is kept
+    static thread_local std::vector<DispatchJob> jobs;
+    jobs.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        jobs[i].connection = connection;
+        jobs[i].packet = NetworkPacket::Copy(batch[i]);
+    }
+
+    _shards[shardIndex]->queue.enqueue_bulk(std::make_move_iterator(jobs.begin()), jobs.size());
+    jobs.clear();
+
+    Wake(shardIndex);
+}
+
+void MessageDispatcher::_internalFlushCoalesced(std::shared_ptr<NetworkClient> connection)
+{
+    // A job without a packet flushes whatever the connection's rate limiter held back
+    u32 shardIndex = GetShardIndex(connection.get());
+
+    DispatchJob job;
+    job.connection = std::move(connection);
+
+    _shards[shardIndex]->queue.enqueue(std::move(job));
+    Wake(shardIndex);
+}
+
+u32 MessageDispatcher::GetShardIndex(NetworkClient* connection)
+{
+    ConnectionHandle handle = connection->GetHandle();
+
+    // Connections that were never registered with a NetworkServer are keyed by their address instead
+    u64 key = handle.IsValid() ? handle.index : reinterpret_cast<u64>(connection) / alignof(NetworkClient);
+    return static_cast<u32>(key % _shards.size());
+}
+void MessageDispatcher::Wake(u32 shardIndex)
+{
+    Worker& worker = *_workers[shardIndex % _workers.size()];
+
+    // Pairs with the fence in Run, either the worker sees the job we just enqueued or we see it going to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!worker.isSleeping.load(std::memory_order_relaxed))
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.hasWork = true;
+    }
+    worker.condition.notify_one();
+}
+bool MessageDispatcher::HasJobs(u32 workerIndex)
+{
+    for (size_t shardIndex = workerIndex; shardIndex < _shards.size(); shardIndex += _workers.size())
+    {
+        if (_shards[shardIndex]->queue.size_approx() > 0)
+            return true;
+    }
+
+    return false;
+}
+
+void MessageDispatcher::Run(u32 workerIndex)
+{
+    Worker& worker = *_workers[workerIndex];
+    u32 numShards = static_cast<u32>(_shards.size());
+    u32 numWorkers = static_cast<u32>(_workers.size());
+
+    DispatchJob jobs[DEQUEUE_BULK_SIZE];
+    while (_isRunning)
+    {
+        size_t numHandled = 0;
+
+        // A worker only ever touches its own shards, that is what keeps every connection in order
+        for (u32 shardIndex = workerIndex; shardIndex < numShards; shardIndex += numWorkers)
+        {
+            moodycamel::ConcurrentQueue<DispatchJob>& queue = _shards[shardIndex]->queue;
+
+            size_t numJobs = queue.try_dequeue_bulk(jobs, DEQUEUE_BULK_SIZE);
+            for (size_t i = 0; i < numJobs; i++)
+            {
+                HandleJob(jobs[i]);
+                jobs[i] = DispatchJob();
+            }
+
+            numHandled += numJobs;
+        }
+
+        if (numHandled == 0)
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.isSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            // A job enqueued before isSleeping was raised did not wake anyone, so look once more before waiting
+            if (!HasJobs(workerIndex))
+                worker.condition.wait(lock, [this, &worker]() { return worker.hasWork || !_isRunning; });
+
+            worker.hasWork = false;
+            worker.isSleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+}
+void MessageDispatcher::HandleJob(DispatchJob& job)
+{
+    if (job.connection->IsClosed())
+        return;
+
+    bool isHandled = job.packet ? _messageHandler->CallHandler(job.connection, job.packet) : _messageHandler->FlushCoalesced(job.connection);
+    if (isHandled)
+        return;
+
+    if (_failureHandler)
+    {
+        _failureHandler(job.connection, job.packet);
+        return;
+    }
+
+    // The socket belongs to its io_context, so the close has to happen there as well
+    std::shared_ptr<NetworkClient> connection = job.connection;
+    asio::post(connection->socket()->get_executor(), [connection]()
+    {
+        connection->Close(asio::error::connection_aborted);
+    });
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <NovusTypes.h>
+#include <Utils/ConcurrentQueue.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "BaseSocket.h"
+
+class MessageHandler;
+class NetworkClient;
+struct NetworkPacket;
+
+struct DispatchJob
+{
+    std::shared_ptr<NetworkClient> connection;
+    std::shared_ptr<NetworkPacket> packet;
+};
+
+/*
+    Runs MessageHandler on a pool of workers instead of on the I/O thread that read the packet.
+
+    Every connection maps to one shard and every shard is drained by exactly one worker, so packets from the
+    same connection are handled in the order they were enqueued while different connections run in parallel.
+    Ordering relies on a connection's packets being enqueued from one thread at a time, which is the case
+    when its reads complete on a single io_context (see NetworkEngine). Packets the MessageHandler held back
+    for rate limiting are flushed through the same shard, so a connection's limiter is only touched by one worker.
+*/
+class MessageDispatcher
+{
+public:
+    using FailureHandler = std::function<void(std::shared_ptr<NetworkClient>&, std::shared_ptr<NetworkPacket>&)>;
+
+    static constexpr size_t DEQUEUE_BULK_SIZE = 64;
+
+    // numShards of 0 means four shards per worker
+    MessageDispatcher(MessageHandler* messageHandler, u32 numWorkers, u32 numShards = 0);
+    ~MessageDispatcher();
+
+    void Start();
+    void Stop();
+
+    // Packet views are copied into pooled buffers, so the batch may be released as soon as this returns
+    void Enqueue(std::shared_ptr<NetworkClient> connection, std::shared_ptr<NetworkPacket>& packet);
+    void Enqueue(std::shared_ptr<NetworkClient> connection, BaseSocket::PacketBatch& batch);
+
+    // Called when a handler rejects a packet, by default the connection is closed. The packet is null when a held back packet was rejected
+    void SetFailureHandler(FailureHandler failureHandler) { _failureHandler = failureHandler; }
+
+    u32 GetNumShards() { return static_cast<u32>(_shards.size()); }
+    size_t GetShardDepth(u32 shardIndex) { return _shards[shardIndex]->queue.size_approx(); }
+
+private:
+    struct Shard
+    {
+        moodycamel::ConcurrentQueue<DispatchJob> queue;
+    };
+    struct Worker
+    {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> isSleeping = false;
+        bool hasWork = false; // Guarded by mutex
+    };
+
+    u32 GetShardIndex(NetworkClient* connection);
+    void _internalFlushCoalesced(std::shared_ptr<NetworkClient> connection);
+    void Wake(u32 shardIndex);
+    bool HasJobs(u32 workerIndex);
+    void Run(u32 workerIndex);
+    void HandleJob(DispatchJob& job);
+
+    MessageHandler* _messageHandler;
+    FailureHandler _failureHandler;
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<bool> _isRunning;
+};
@@ -1,8 +1,14 @@
 #include "MessageHandler.h"
 #include <NovusTypes.h>
+#include <chrono>
 #include "../Networking/NetworkClient.h"
 #include "../Networking/NetworkPacket.h"
 
+static u32 GetMilliseconds()
+{
+    return static_cast<u32>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
 MessageHandler::MessageHandler() { }
 
 void MessageHandler::SetMessageHandler(Opcode opcode, OpcodeHandler handler)
@@ -12,13 +18,179 @@ void MessageHandler::SetMessageHandler(Opcode opcode, OpcodeHandler handler)
 
 bool MessageHandler::CallHandler(std::shared_ptr<NetworkClient> connection, std::shared_ptr<NetworkPacket>& packet)
 {
-    if (packet->header.opcode <= Opcode::INVALID || packet->header.opcode > Opcode::MAX_COUNT)
+    return Dispatch(*connection, packet->GetView(), &connection, &packet);
+}
+bool MessageHandler::CallHandler(NetworkClient& connection, const PacketView& packet)
+{
+    return Dispatch(connection, packet, nullptr, nullptr);
+}
+
+bool MessageHandler::Dispatch(NetworkClient& connection, const PacketView& packet, std::shared_ptr<NetworkClient>* owner, std::shared_ptr<NetworkPacket>* ownedPacket)
+{
+    if (packet.header.opcode <= Opcode::INVALID || packet.header.opcode >= Opcode::MAX_COUNT)
         return false;
 
-    const OpcodeHandler& opcodeHandler = handlers[static_cast<u16>(packet->header.opcode)];
+    const OpcodeHandler& opcodeHandler = handlers[static_cast<u16>(packet.header.opcode)];
 
-    if (!opcodeHandler.handler || packet->header.size < opcodeHandler.minSize || (packet->header.size > opcodeHandler.maxSize && opcodeHandler.maxSize != -1) || connection->GetStatus() != opcodeHandler.status)
+    if (!opcodeHandler.HasHandler() || packet.header.size < opcodeHandler.minSize || (packet.header.size > opcodeHandler.maxSize && opcodeHandler.maxSize != -1) || connection.GetStatus() != opcodeHandler.status)
         return false;
 
-    return opcodeHandler.handler(connection, packet);
-}
\ No newline at end of file
+    ConnectionRateLimiter& rateLimiter = connection.GetRateLimiter();
+    std::vector<std::shared_ptr<NetworkPacket>>& coalescedPackets = rateLimiter.GetCoalescedPackets();
+
+    // Unlimited opcodes from connections that aren't being limited never touch the clock
+    if (opcodeHandler.rateLimit.rate == 0 && coalescedPackets.empty())
+        return Invoke(opcodeHandler, connection, packet, owner, ownedPacket);
+
+    u32 nowMs = GetMilliseconds();
+    if (!coalescedPackets.empty())
+    {
+        // A newer packet of the same opcode supersedes the one we held back
+        for (size_t i = 0; i < coalescedPackets.size(); i++)
+        {
+            if (coalescedPackets[i]->header.opcode != packet.header.opcode)
+                continue;
+
+            rateLimitStats[static_cast<u16>(packet.header.opcode)].coalesced++;
+            coalescedPackets.erase(coalescedPackets.begin() + i);
+            break;
+        }
+
+        if (!CallCoalescedHandlers(connection, owner, nowMs))
+            return false;
+    }
+
+    if (opcodeHandler.rateLimit.rate > 0 && !rateLimiter.GetBucket(packet.header.opcode).TryConsume(opcodeHandler.rateLimit, nowMs))
+    {
+        rateLimiter.AddLimited();
+
+        if (opcodeHandler.rateLimit.action == RateLimitAction::COALESCE)
+        {
+            // The packet may be a view into the receive buffer, what we hold on to has to own its memory
+            coalescedPackets.push_back(NetworkPacket::Copy(packet));
+            ScheduleCoalescedFlush(connection);
+        }
+        else
+        {
+            rateLimitStats[static_cast<u16>(packet.header.opcode)].dropped++;
+        }
+
+        return true;
+    }
+
+    return Invoke(opcodeHandler, connection, packet, owner, ownedPacket);
+}
+
+bool MessageHandler::Invoke(const OpcodeHandler& opcodeHandler, NetworkClient& connection, const PacketView& packet, std::shared_ptr<NetworkClient>* owner, std::shared_ptr<NetworkPacket>* ownedPacket)
+{
+    if (opcodeHandler.viewHandler)
+        return opcodeHandler.viewHandler(connection, packet);
+
+    // Shared pointer handlers pay for whatever the caller couldn't hand us
+    std::shared_ptr<NetworkClient> connectionOwner = owner ? *owner : std::static_pointer_cast<NetworkClient>(connection.shared_from_this());
+    if (ownedPacket)
+        return opcodeHandler.handler(connectionOwner, *ownedPacket);
+
+    std::shared_ptr<NetworkPacket> packetView = NetworkPacket::Borrow();
+    packetView->header = packet.header;
+    packetView->payload = std::make_shared<Bytebuffer>(const_cast<u8*>(packet.payload), packet.header.size);
+    packetView->payload->writtenData = packet.header.size;
+
+    return opcodeHandler.handler(connectionOwner, packetView);
+}
+
+bool MessageHandler::FlushCoalesced(std::shared_ptr<NetworkClient> connection)
+{
+    ConnectionRateLimiter& rateLimiter = connection->GetRateLimiter();
+    rateLimiter.SetFlushScheduled(false);
+
+    if (rateLimiter.GetCoalescedPackets().empty())
+        return true;
+
+    if (!CallCoalescedHandlers(*connection, &connection, GetMilliseconds()))
+        return false;
+
+    ScheduleCoalescedFlush(*connection);
+    return true;
+}
+
+bool MessageHandler::CallCoalescedHandlers(NetworkClient& connection, std::shared_ptr<NetworkClient>* owner, u32 nowMs)
+{
+    ConnectionRateLimiter& rateLimiter = connection.GetRateLimiter();
+    std::vector<std::shared_ptr<NetworkPacket>>& coalescedPackets = rateLimiter.GetCoalescedPackets();
+
+    for (size_t i = 0; i < coalescedPackets.size();)
+    {
+        Opcode opcode = coalescedPackets[i]->header.opcode;
+        const OpcodeHandler& opcodeHandler = handlers[static_cast<u16>(opcode)];
+
+        // The connection may have changed status since the packet was held back
+        if (!opcodeHandler.HasHandler() || connection.GetStatus() != opcodeHandler.status)
+        {
+            rateLimitStats[static_cast<u16>(opcode)].dropped++;
+            coalescedPackets.erase(coalescedPackets.begin() + i);
+            continue;
+        }
+
+        if (!rateLimiter.GetBucket(opcode).TryConsume(opcodeHandler.rateLimit, nowMs))
+        {
+            i++;
+            continue;
+        }
+
+        // Taken out before the handler runs, it may dispatch more packets for this connection
+        std::shared_ptr<NetworkPacket> packet = std::move(coalescedPackets[i]);
+        coalescedPackets.erase(coalescedPackets.begin() + i);
+
+        if (!Invoke(opcodeHandler, connection, packet->GetView(), owner, &packet))
+            return false;
+    }
+
+    return true;
+}
+void MessageHandler::ScheduleCoalescedFlush(NetworkClient& connection)
+{
+    ConnectionRateLimiter& rateLimiter = connection.GetRateLimiter();
+    std::vector<std::shared_ptr<NetworkPacket>>& coalescedPackets = rateLimiter.GetCoalescedPackets();
+    if (rateLimiter.IsFlushScheduled() || coalescedPackets.empty() || !connection.GetTimingWheel())
+        return;
+
+    // One timer per connection, due when the first of its held back opcodes gets a token
+    u32 waitMs = std::numeric_limits<u32>::max();
+    for (std::shared_ptr<NetworkPacket>& coalescedPacket : coalescedPackets)
+    {
+        Opcode opcode = coalescedPacket->header.opcode;
+        waitMs = std::min(waitMs, rateLimiter.GetBucket(opcode).GetWaitMs(handlers[static_cast<u16>(opcode)].rateLimit));
+    }
+
+    // Connections that aren't owned by a shared_ptr can't be kept track of, their next packet flushes instead
+    std::weak_ptr<BaseSocket> weakConnection = connection.weak_from_this();
+    if (weakConnection.expired())
+        return;
+
+    rateLimiter.SetFlushScheduled(true);
+
+    // We may be on a dispatcher worker, the wheel can only be touched from the connection's io_context
+    std::chrono::milliseconds delay(waitMs);
+    asio::post(connection.socket()->get_executor(), [this, weakConnection, delay]()
+    {
+        std::shared_ptr<BaseSocket> connection = weakConnection.lock();
+        if (connection && !connection->IsClosed())
+            static_cast<NetworkClient*>(connection.get())->GetTimingWheel()->Schedule(delay, std::bind(&MessageHandler::_internalCoalescedFlushTimer, this, weakConnection));
+    });
+}
+void MessageHandler::_internalCoalescedFlushTimer(std::weak_ptr<BaseSocket> weakConnection)
+{
+    std::shared_ptr<NetworkClient> connection = std::static_pointer_cast<NetworkClient>(weakConnection.lock());
+    if (!connection || connection->IsClosed())
+        return;
+
+    if (coalescedFlushHandler)
+    {
+        coalescedFlushHandler(connection);
+        return;
+    }
+
+    if (!FlushCoalesced(connection))
+        connection->Close(asio::error::connection_aborted);
+}
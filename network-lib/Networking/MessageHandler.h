@@ -1,33 +1,84 @@
 #pragma once
 #include <robin_hood.h>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include "../Networking/ConnectionStatus.h"
 #include "../Networking/Opcode.h"
+#include "../Networking/RateLimit.h"
 
+class BaseSocket;
 class NetworkClient;
 struct NetworkPacket;
+struct PacketView;
 
 typedef bool (*MessageHandlerFn)(std::shared_ptr<NetworkClient>, std::shared_ptr<NetworkPacket>&);
+
+// Takes neither the connection nor the packet by reference count, both are only guaranteed to live until the handler returns.
+// Handlers that need to refer to the connection later should keep its ConnectionHandle
+typedef bool (*MessageViewHandlerFn)(NetworkClient&, const PacketView&);
+
 struct OpcodeHandler
 {
     OpcodeHandler() { }
     OpcodeHandler(ConnectionStatus inStatus, u16 inMinMaxSize, MessageHandlerFn inHandler) :status(inStatus), minSize(inMinMaxSize), maxSize(inMinMaxSize), handler(inHandler) { }
     OpcodeHandler(ConnectionStatus inStatus, u16 inMinSize, i16 inMaxSize, MessageHandlerFn inHandler) :status(inStatus), minSize(inMinSize), maxSize(inMaxSize), handler(inHandler) { }
+    OpcodeHandler(ConnectionStatus inStatus, u16 inMinMaxSize, MessageHandlerFn inHandler, OpcodeRateLimit inRateLimit) :status(inStatus), minSize(inMinMaxSize), maxSize(inMinMaxSize), handler(inHandler), rateLimit(inRateLimit) { }
+    OpcodeHandler(ConnectionStatus inStatus, u16 inMinSize, i16 inMaxSize, MessageHandlerFn inHandler, OpcodeRateLimit inRateLimit) :status(inStatus), minSize(inMinSize), maxSize(inMaxSize), handler(inHandler), rateLimit(inRateLimit) { }
+    OpcodeHandler(ConnectionStatus inStatus, u16 inMinMaxSize, MessageViewHandlerFn inViewHandler) :status(inStatus), minSize(inMinMaxSize), maxSize(inMinMaxSize), viewHandler(inViewHandler) { }
+    OpcodeHandler(ConnectionStatus inStatus, u16 inMinSize, i16 inMaxSize, MessageViewHandlerFn inViewHandler) :status(inStatus), minSize(inMinSize), maxSize(inMaxSize), viewHandler(inViewHandler) { }
+    OpcodeHandler(ConnectionStatus inStatus, u16 inMinMaxSize, MessageViewHandlerFn inViewHandler, OpcodeRateLimit inRateLimit) :status(inStatus), minSize(inMinMaxSize), maxSize(inMinMaxSize), viewHandler(inViewHandler), rateLimit(inRateLimit) { }
+    OpcodeHandler(ConnectionStatus inStatus, u16 inMinSize, i16 inMaxSize, MessageViewHandlerFn inViewHandler, OpcodeRateLimit inRateLimit) :status(inStatus), minSize(inMinSize), maxSize(inMaxSize), viewHandler(inViewHandler), rateLimit(inRateLimit) { }
+
+    bool HasHandler() const { return handler != nullptr || viewHandler != nullptr; }
 
     ConnectionStatus status = ConnectionStatus::AUTH_NONE;
     u16 minSize = 0;
     i16 maxSize = 0;
     MessageHandlerFn handler = nullptr;
+    MessageViewHandlerFn viewHandler = nullptr;
+    OpcodeRateLimit rateLimit;
+};
+
+struct RateLimitStats
+{
+    std::atomic<u64> dropped = 0;
+    std::atomic<u64> coalesced = 0;
 };
 
 class MessageHandler
 {
 public:
+    using CoalescedFlushHandler = std::function<void(std::shared_ptr<NetworkClient>)>;
+
     MessageHandler();
 
     void SetMessageHandler(Opcode opcode, OpcodeHandler handler);
+    // Over-limit packets never reach their handler and count as handled, they don't fail the connection
     bool CallHandler(std::shared_ptr<NetworkClient> connection, std::shared_ptr<NetworkPacket>& packet);
+    // Dispatches without touching any reference count as long as the opcode has a view handler, the caller keeps both alive for the call
+    bool CallHandler(NetworkClient& connection, const PacketView& packet);
+
+    // Delivers every held back packet whose opcode has a token again, it has to run wherever the connection's packets are dispatched.
+    // Returns false if a handler rejected one of them
+    bool FlushCoalesced(std::shared_ptr<NetworkClient> connection);
+
+    // Held back packets are flushed from the connection's timing wheel once their opcode has a token again, a connection without
+    // a wheel only flushes them when its next packet arrives. The flush runs on the connection's io_context unless this routes it
+    // to wherever the packets are dispatched instead, set it before the first packet arrives
+    void SetCoalescedFlushHandler(CoalescedFlushHandler flushHandler) { coalescedFlushHandler = flushHandler; }
+
+    const RateLimitStats& GetRateLimitStats(Opcode opcode) { return rateLimitStats[static_cast<u16>(opcode)]; }
 
 private:
+    // owner and ownedPacket are passed along when the caller already has them, so shared pointer handlers don't need new ones
+    bool Dispatch(NetworkClient& connection, const PacketView& packet, std::shared_ptr<NetworkClient>* owner, std::shared_ptr<NetworkPacket>* ownedPacket);
+    bool Invoke(const OpcodeHandler& opcodeHandler, NetworkClient& connection, const PacketView& packet, std::shared_ptr<NetworkClient>* owner, std::shared_ptr<NetworkPacket>* ownedPacket);
+    bool CallCoalescedHandlers(NetworkClient& connection, std::shared_ptr<NetworkClient>* owner, u32 nowMs);
+    void ScheduleCoalescedFlush(NetworkClient& connection);
+    void _internalCoalescedFlushTimer(std::weak_ptr<BaseSocket> weakConnection);
+
     OpcodeHandler handlers[static_cast<u16>(Opcode::MAX_COUNT)];
+    RateLimitStats rateLimitStats[static_cast<u16>(Opcode::MAX_COUNT)];
+    CoalescedFlushHandler coalescedFlushHandler;
 };
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <Utils/Message.h>
 #include <Utils/DebugHandler.h>
 #include <Networking/NetworkPacket.h>
+#include <cmath>
+#include <random>
 
 void NetworkClient::Listen()
 {
@@ -32,4 +34,293 @@ bool NetworkClient::Connect(u32 address, u16 port)
 bool NetworkClient::Connect(std::string address, u16 port)
 {
     return Connect(tcp::endpoint(asio::ip::address::from_string(address), port));
-}
\ No newline at end of file
+}
+void NetworkClient::AsyncConnect(tcp::endpoint endpoint, std::chrono::milliseconds timeout, ConnectCallback callback)
+{
+    if (!_connectTimer)
+        _connectTimer = std::make_unique<asio::steady_timer>(socket()->get_executor().context());
+
+    _connectEndpoint = endpoint;
+    _connectTimeout = timeout;
+    _connectCallback = callback;
+    _connectAttempts = 0;
+    _isConnecting = true;
+    _isConnectCancelled = false;
+
+    // Looking through the interfaces is too slow to repeat on the io thread for every attempt
+    _isConnectLocal = endpoint.address().is_v4() && SharedMemoryChannel::IsLocalAddress(endpoint.address().to_v4().to_uint());
+
+    StartConnectAttempt();
+}
+void NetworkClient::AsyncConnect(u32 address, u16 port, std::chrono::milliseconds timeout, ConnectCallback callback)
+{
+    AsyncConnect(tcp::endpoint(asio::ip::address(asio::ip::address_v4(address)), port), timeout, callback);
+}
+void NetworkClient::CancelConnect()
+{
+    std::shared_ptr<NetworkClient> self = std::static_pointer_cast<NetworkClient>(shared_from_this());
+    asio::post(socket()->get_executor(), [self]()
+    {
+        if (!self->_isConnecting)
+            return;
+
+        self->_isConnectCancelled = true;
+
+        asio::error_code ignored;
+        if (self->_connectTimer)
+            self->_connectTimer->cancel(ignored);
+
+        // A pending attempt completes with operation_aborted and reports the cancellation from there
+        if (self->_isConnectPending)
+        {
+            self->socket()->close(ignored);
+            if (self->_connectChannel)
+                self->_connectChannel->Close();
+
+            return;
+        }
+
+        self->FinishConnect(asio::error::operation_aborted);
+    });
+}
+
+bool NetworkClient::SetIdleTimeout(std::chrono::milliseconds timeout)
+{
+    if (!_timingWheel)
+        return false;
+
+    _timingWheel->Cancel(_idleTimer);
+    _idleTimer = 0;
+    _idleTimeout = timeout;
+
+    if (timeout.count() > 0)
+        _idleTimer = ScheduleTimer(timeout, &NetworkClient::_internalIdleTimeout);
+
+    return true;
+}
+bool NetworkClient::SetStatusDeadline(ConnectionStatus status, std::chrono::milliseconds timeout)
+{
+    if (!_timingWheel)
+        return false;
+
+    _timingWheel->Cancel(_statusDeadlineTimer);
+    _deadlineStatus = status;
+    _statusDeadlineTimer = ScheduleTimer(timeout, &NetworkClient::_internalStatusDeadline);
+    return true;
+}
+bool NetworkClient::CancelStatusDeadline()
+{
+    if (!_timingWheel)
+        return false;
+
+    _timingWheel->Cancel(_statusDeadlineTimer);
+    _statusDeadlineTimer = 0;
+    return true;
+}
+bool NetworkClient::SetKeepalive(std::chrono::milliseconds interval, std::shared_ptr<Bytebuffer> packet)
+{
+    if (!_timingWheel)
+        return false;
+
+    _timingWheel->Cancel(_keepaliveTimer);
+    _keepaliveTimer = 0;
+    _keepaliveInterval = interval;
+    _keepalivePacket = packet;
+    _keepaliveNumSends = GetNumSends();
+
+    if (interval.count() > 0)
+        _keepaliveTimer = ScheduleTimer(interval, &NetworkClient::_internalKeepalive);
+
+    return true;
+}
+bool NetworkClient::SendDelayed(std::shared_ptr<Bytebuffer> buffer, std::chrono::milliseconds delay)
+{
+    if (!_timingWheel)
+        return false;
+
+    std::weak_ptr<NetworkClient> weakSelf = std::static_pointer_cast<NetworkClient>(shared_from_this());
+    _timingWheel->Schedule(delay, [weakSelf, buffer]() mutable
+    {
+        if (std::shared_ptr<NetworkClient> self = weakSelf.lock())
+            self->Send(buffer);
+    });
+
+    return true;
+}
+void NetworkClient::StartConnectAttempt()
+{
+    _connectAttempts++;
+    _isConnectPending = true;
+    _hasConnectTimedOut = false;
+
+    // The timeout covers the whole attempt, including the shared memory handshake before falling back to TCP
+    std::shared_ptr<NetworkClient> self = std::static_pointer_cast<NetworkClient>(shared_from_this());
+    _connectTimer->expires_after(_connectTimeout);
+    _connectTimer->async_wait(std::bind(&NetworkClient::_internalConnectTimeout, self, std::placeholders::_1));
+
+    if (_isConnectLocal)
+    {
+        _connectChannel = SharedMemoryChannel::AsyncConnect(socket()->get_executor().context(), _connectEndpoint.port(),
+            std::bind(&NetworkClient::_internalSharedMemoryConnect, self, std::placeholders::_1));
+        return;
+    }
+
+    StartTcpConnect();
+}
+void NetworkClient::StartTcpConnect()
+{
+    // A failed attempt leaves the socket open, connecting again needs a fresh one
+    asio::error_code ignored;
+    socket()->close(ignored);
+
+    std::shared_ptr<NetworkClient> self = std::static_pointer_cast<NetworkClient>(shared_from_this());
+    socket()->async_connect(_connectEndpoint, std::bind(&NetworkClient::_internalAsyncConnect, self, std::placeholders::_1));
+}
+void NetworkClient::FailConnectAttempt(const asio::error_code& error)
+{
+    asio::error_code result = _hasConnectTimedOut ? asio::error::timed_out : error;
+
+    bool canRetry = _hasReconnectPolicy && !_isConnectCancelled && (_reconnectPolicy.maxAttempts == 0 || _connectAttempts < _reconnectPolicy.maxAttempts);
+    if (!canRetry)
+    {
+        FinishConnect(_isConnectCancelled ? asio::error::operation_aborted : result);
+        return;
+    }
+
+    std::shared_ptr<NetworkClient> self = std::static_pointer_cast<NetworkClient>(shared_from_this());
+    _connectTimer->expires_after(GetReconnectDelay());
+    _connectTimer->async_wait(std::bind(&NetworkClient::_internalReconnectTimer, self, std::placeholders::_1));
+}
+void NetworkClient::FinishConnect(const asio::error_code& error)
+{
+    _isConnecting = false;
+    _internalConnected(!error);
+
+    if (_connectCallback)
+        _connectCallback(this, error);
+
+    if (!error)
+        Listen();
+}
+std::chrono::milliseconds NetworkClient::GetReconnectDelay()
+{
+    static thread_local std::minstd_rand random(std::random_device{}());
+
+    f64 delay = _reconnectPolicy.initialDelay.count() * std::pow(static_cast<f64>(_reconnectPolicy.multiplier), static_cast<f64>(_connectAttempts - 1));
+    delay = std::min(delay, static_cast<f64>(_reconnectPolicy.maxDelay.count()));
+
+    // Spread the retries so links that dropped together don't all come back in lockstep
+    std::uniform_real_distribution<f64> jitter(1.0 - _reconnectPolicy.jitter, 1.0 + _reconnectPolicy.jitter);
+    return std::chrono::milliseconds(static_cast<i64>(delay * jitter(random)));
+}
+
+TimingWheel::TimerId NetworkClient::ScheduleTimer(std::chrono::milliseconds delay, void (NetworkClient::*callback)())
+{
+    // The wheel must not keep a closed connection alive until its timers run out, so it only gets a weak reference
+    std::weak_ptr<NetworkClient> weakSelf = std::static_pointer_cast<NetworkClient>(shared_from_this());
+    return _timingWheel->Schedule(delay, [weakSelf, callback]()
+    {
+        if (std::shared_ptr<NetworkClient> self = weakSelf.lock())
+            (self.get()->*callback)();
+    });
+}
+
+void NetworkClient::_internalAsyncConnect(const asio::error_code& error)
+{
+    _isConnectPending = false;
+
+    asio::error_code ignored;
+    _connectTimer->cancel(ignored);
+
+    // The connect may already have completed when the timeout or CancelConnect closed the socket
+    if (!error && !_hasConnectTimedOut && !_isConnectCancelled && socket()->is_open())
+    {
+        FinishConnect(error);
+        return;
+    }
+
+    FailConnectAttempt(error ? error : asio::error::operation_aborted);
+}
+void NetworkClient::_internalSharedMemoryConnect(const asio::error_code& error)
+{
+    std::shared_ptr<SharedMemoryChannel> channel = std::move(_connectChannel);
+
+    if (_hasConnectTimedOut || _isConnectCancelled)
+    {
+        channel->Close();
+        _isConnectPending = false;
+        FailConnectAttempt(error ? error : asio::error::operation_aborted);
+        return;
+    }
+
+    // Nothing on the server accepts shared memory, the same attempt carries on over TCP
+    if (error)
+    {
+        StartTcpConnect();
+        return;
+    }
+
+    _isConnectPending = false;
+
+    asio::error_code ignored;
+    _connectTimer->cancel(ignored);
+
+    AttachSharedMemory(channel);
+    FinishConnect(error);
+}
+void NetworkClient::_internalConnectTimeout(const asio::error_code& error)
+{
+    // Cancelled because the attempt finished first
+    if (error || !_isConnectPending)
+        return;
+
+    _hasConnectTimedOut = true;
+
+    asio::error_code ignored;
+    socket()->close(ignored);
+    if (_connectChannel)
+        _connectChannel->Close();
+}
+void NetworkClient::_internalReconnectTimer(const asio::error_code& error)
+{
+    if (error || _isConnectCancelled)
+        return;
+
+    StartConnectAttempt();
+}
+void NetworkClient::_internalIdleTimeout()
+{
+    _idleTimer = 0;
+    if (IsClosed())
+        return;
+
+    // Receiving doesn't touch the timer, instead we check how long we have been idle and go back to sleep for the remainder
+    std::chrono::milliseconds idleTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - GetLastReceiveTime());
+    if (idleTime >= _idleTimeout)
+    {
+        Close(asio::error::timed_out);
+        return;
+    }
+
+    _idleTimer = ScheduleTimer(_idleTimeout - idleTime, &NetworkClient::_internalIdleTimeout);
+}
+void NetworkClient::_internalStatusDeadline()
+{
+    _statusDeadlineTimer = 0;
+    if (IsClosed() || _status != _deadlineStatus)
+        return;
+
+    Close(asio::error::timed_out);
+}
+void NetworkClient::_internalKeepalive()
+{
+    _keepaliveTimer = 0;
+    if (IsClosed())
+        return;
+
+    if (GetNumSends() == _keepaliveNumSends)
+        Send(_keepalivePacket);
+
+    _keepaliveNumSends = GetNumSends();
+    _keepaliveTimer = ScheduleTimer(_keepaliveInterval, &NetworkClient::_internalKeepalive);
+}
@@ -3,6 +3,11 @@
 #include <Utils/DebugHandler.h>
 #include <entity/fwd.hpp>
 #include "ConnectionStatus.h"
+#include "ConnectionHandle.h"
+#include "RateLimit.h"
+#include "TimingWheel.h"
+#include <chrono>
+#include <functional>
 
 enum BuildType
 {
@@ -137,24 +142,108 @@ struct ServerLogonHandshake
 };
 #pragma pack(pop)
 
+// Retries a failed AsyncConnect, the delay grows by multiplier after every attempt and is spread by +-jitter
+struct ReconnectPolicy
+{
+    std::chrono::milliseconds initialDelay = std::chrono::milliseconds(250);
+    std::chrono::milliseconds maxDelay = std::chrono::milliseconds(30000);
+    f32 multiplier = 2.0f;
+    f32 jitter = 0.2f;
+    u32 maxAttempts = 0; // 0 keeps trying until CancelConnect
+};
+
 class NetworkClient : public BaseSocket
 {
 public:
     using tcp = asio::ip::tcp;
+    using ConnectCallback = std::function<void(NetworkClient*, const asio::error_code&)>;
+
     NetworkClient(tcp::socket* socket, u32 identity = 0) : BaseSocket(socket), _status(ConnectionStatus::AUTH_NONE), _identity(identity) { }
 
     void Listen();
+    // Only connects over TCP, AsyncConnect reaches servers on this host through shared memory when they accept it
     bool Connect(tcp::endpoint endpoint);
     bool Connect(u32 address, u16 port);
     bool Connect(std::string address, u16 port);
 
+    // Connects on the socket's io_context without blocking, every attempt gives up after timeout. The client must be owned by a shared_ptr.
+    // The callback and the connect handler only run once, when connected or when the reconnect policy gives up
+    void AsyncConnect(tcp::endpoint endpoint, std::chrono::milliseconds timeout, ConnectCallback callback);
+    void AsyncConnect(u32 address, u16 port, std::chrono::milliseconds timeout, ConnectCallback callback);
+    void CancelConnect();
+
+    // Only applies to AsyncConnect, a connection that drops after being established is not reconnected
+    void SetReconnectPolicy(ReconnectPolicy policy) { _reconnectPolicy = policy; _hasReconnectPolicy = true; }
+    u32 GetConnectAttempts() { return _connectAttempts; }
+
+    // Idle timeouts, status deadlines, keepalives and delayed sends run on this wheel, it has to belong to the socket's io_context.
+    // Those functions return false without a wheel and may only be called from the socket's io_context
+    void SetTimingWheel(TimingWheel* timingWheel) { _timingWheel = timingWheel; }
+    TimingWheel* GetTimingWheel() { return _timingWheel; }
+
+    // Closes the connection with timed_out once nothing has been received for timeout, 0 disables it
+    bool SetIdleTimeout(std::chrono::milliseconds timeout);
+    // Closes the connection with timed_out if it is still in status once timeout has passed, replaces the previous deadline
+    bool SetStatusDeadline(ConnectionStatus status, std::chrono::milliseconds timeout);
+    bool CancelStatusDeadline();
+    // Sends packet whenever nothing else was sent for a whole interval, 0 disables it
+    bool SetKeepalive(std::chrono::milliseconds interval, std::shared_ptr<Bytebuffer> packet);
+    // Sends the buffer once delay has passed, unless the connection closed in the meantime
+    bool SendDelayed(std::shared_ptr<Bytebuffer> buffer, std::chrono::milliseconds delay);
+
     ConnectionStatus GetStatus() { return _status; }
     void SetStatus(ConnectionStatus status) { _status = status; }
 
     u64 GetEntityId() { return _identity; }
     entt::entity GetEntity() { return static_cast<entt::entity>(_identity); }
     void SetEntityId(u64 identity) { _identity = identity; }
+
+    ConnectionHandle GetHandle() { return _handle; }
+    void SetHandle(ConnectionHandle handle) { _handle = handle; }
+
+    ConnectionRateLimiter& GetRateLimiter() { return _rateLimiter; }
 private:
+    void StartConnectAttempt();
+    void StartTcpConnect();
+    void FailConnectAttempt(const asio::error_code& error);
+    void FinishConnect(const asio::error_code& error);
+    std::chrono::milliseconds GetReconnectDelay();
+    TimingWheel::TimerId ScheduleTimer(std::chrono::milliseconds delay, void (NetworkClient::*callback)());
+
+    void _internalAsyncConnect(const asio::error_code& error);
+    void _internalSharedMemoryConnect(const asio::error_code& error);
+    void _internalConnectTimeout(const asio::error_code& error);
+    void _internalReconnectTimer(const asio::error_code& error);
+    void _internalIdleTimeout();
+    void _internalStatusDeadline();
+    void _internalKeepalive();
+
     ConnectionStatus _status;
     u64 _identity;
+    ConnectionHandle _handle;
+    ConnectionRateLimiter _rateLimiter;
+
+    std::unique_ptr<asio::steady_timer> _connectTimer;
+    tcp::endpoint _connectEndpoint;
+    std::shared_ptr<SharedMemoryChannel> _connectChannel;
+    bool _isConnectLocal = false;
+    std::chrono::milliseconds _connectTimeout;
+    ConnectCallback _connectCallback;
+    ReconnectPolicy _reconnectPolicy;
+    bool _hasReconnectPolicy = false;
+    bool _isConnecting = false;
+    bool _isConnectPending = false;
+    bool _hasConnectTimedOut = false;
+    bool _isConnectCancelled = false;
+    u32 _connectAttempts = 0;
+
+    TimingWheel* _timingWheel = nullptr;
+    TimingWheel::TimerId _idleTimer = 0;
+    TimingWheel::TimerId _statusDeadlineTimer = 0;
+    TimingWheel::TimerId _keepaliveTimer = 0;
+    std::chrono::milliseconds _idleTimeout = std::chrono::milliseconds(0);
+    std::chrono::milliseconds _keepaliveInterval = std::chrono::milliseconds(0);
+    ConnectionStatus _deadlineStatus = ConnectionStatus::AUTH_NONE;
+    std::shared_ptr<Bytebuffer> _keepalivePacket;
+    u64 _keepaliveNumSends = 0;
 };
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include "NetworkEngine.h"
+#include <Utils/CPUInfo.h>
+#include <Utils/DebugHandler.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#endif
+
+NetworkEngine::NetworkEngine(u32 numContexts, ConnectionDistribution distribution, bool pinThreads) : _distribution(distribution), _pinThreads(pinThreads), _isRunning(false), _nextContext(0)
+{
+    if (numContexts == 0)
+        numContexts = static_cast<u32>(Math::Max(CPUInfo::Get().GetNumCores(), 1));
+
+    _contexts.reserve(numContexts);
+    _timingWheels.reserve(numContexts);
+    for (u32 i = 0; i < numContexts; i++)
+    {
+        // Each context is only ever run by a single thread
+        _contexts.push_back(std::make_unique<asio::io_context>(1));
+        _timingWheels.push_back(std::make_unique<TimingWheel>(*_contexts.back()));
+    }
+
+    _loads = std::make_unique<std::atomic<i32>[]>(numContexts);
+    for (u32 i = 0; i < numContexts; i++)
+    {
+        _loads[i] = 0;
+    }
+}
+NetworkEngine::~NetworkEngine()
+{
+    Stop();
+
+    for (std::shared_ptr<IoUringContext>& ioUring : _ioUrings)
+    {
+        ioUring->Close();
+    }
+}
+
+void NetworkEngine::Start()
+{
+    if (_isRunning)
+        return;
+
+    _isRunning = true;
+
+    _workGuards.reserve(_contexts.size());
+    _threads.reserve(_contexts.size());
+    for (size_t i = 0; i < _contexts.size(); i++)
+    {
+        asio::io_context* context = _contexts[i].get();
+        if (context->stopped())
+            context->restart();
+
+        _workGuards.push_back(asio::make_work_guard(*context));
+        _threads.push_back(std::thread([context]() { context->run(); }));
+
+        if (_pinThreads)
+            PinThread(_threads.back(), i);
+    }
+}
+void NetworkEngine::Stop()
+{
+    if (!_isRunning)
+        return;
+
+    _isRunning = false;
+
+    for (WorkGuard& workGuard : _workGuards)
+    {
+        workGuard.reset();
+    }
+
+    for (std::unique_ptr<asio::io_context>& context : _contexts)
+    {
+        context->stop();
+    }
+
+    for (std::thread& thread : _threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+
+    _workGuards.clear();
+    _threads.clear();
+
+    // The threads are gone, so it is safe to touch the wheels from here
+    for (std::unique_ptr<TimingWheel>& timingWheel : _timingWheels)
+    {
+        timingWheel->Stop();
+    }
+}
+
+bool NetworkEngine::SetBackend(NetworkBackend backend)
+{
+    if (_isRunning)
+        return false;
+
+    if (backend == NetworkBackend::IO_URING && _ioUrings.empty())
+    {
+        if (!IoUringContext::IsSupported())
+        {
+            DebugHandler::PrintWarning("[NetworkEngine]: io_uring is not available, staying on the reactor");
+            return false;
+        }
+
+        std::vector<std::shared_ptr<IoUringContext>> ioUrings;
+        for (std::unique_ptr<asio::io_context>& context : _contexts)
+        {
+            std::shared_ptr<IoUringContext> ioUring = std::make_shared<IoUringContext>(*context);
+            if (!ioUring->IsOpen())
+                return false;
+
+            ioUrings.push_back(ioUring);
+        }
+
+        _ioUrings = std::move(ioUrings);
+    }
+
+    _backend = backend;
+    return true;
+}
+
+size_t NetworkEngine::GetContextIndex(asio::io_context& context)
+{
+    for (size_t i = 0; i < _contexts.size(); i++)
+    {
+        if (_contexts[i].get() == &context)
+            return i;
+    }
+
+    assert(false);
+    return 0;
+}
+
+size_t NetworkEngine::NextContextIndex()
+{
+    if (_distribution == ConnectionDistribution::LEAST_LOADED)
+    {
+        size_t leastLoaded = 0;
+        for (size_t i = 1; i < _contexts.size(); i++)
+        {
+            if (_loads[i] < _loads[leastLoaded])
+                leastLoaded = i;
+        }
+
+        return leastLoaded;
+    }
+
+    return _nextContext++ % _contexts.size();
+}
+
+void NetworkEngine::AddLoad(asio::io_context& context, i32 delta)
+{
+    _loads[GetContextIndex(context)] += delta;
+}
+
+#ifndef _WIN32
+// Every cpu ordered so the first hyperthread of every core comes before any sibling, read from the kernel's topology
+static const std::vector<u32>& GetCpuOrder()
+{
+    static const std::vector<u32> order = []()
+    {
+        // Possible cpus are listed as ranges like "0-7" or "0,2-5", the last number is the highest cpu
+        i32 numCpus = static_cast<i32>(sysconf(_SC_NPROCESSORS_CONF));
+        std::ifstream possibleFile("/sys/devices/system/cpu/possible");
+        std::string possible;
+        if (possibleFile >> possible)
+        {
+            size_t lastSeparator = possible.find_last_of(",-");
+            numCpus = static_cast<i32>(strtol(possible.c_str() + (lastSeparator == std::string::npos ? 0 : lastSeparator + 1), nullptr, 10)) + 1;
+        }
+        numCpus = Math::Clamp(numCpus, 1, CPU_SETSIZE);
+
+        std::vector<u32> firstThreads;
+        std::vector<u32> siblings;
+        for (u32 cpu = 0; cpu < static_cast<u32>(numCpus); cpu++)
+        {
+            // Offline cpus have no topology, the ones after them still do
+            std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+            if (!file.is_open())
+                continue;
+
+            // The list starts with the lowest cpu of the core, e.g. "0,4" or "0-1"
+            u32 firstSibling = cpu;
+            file >> firstSibling;
+
+            if (firstSibling == cpu)
+                firstThreads.push_back(cpu);
+            else
+                siblings.push_back(cpu);
+        }
+
+        firstThreads.insert(firstThreads.end(), siblings.begin(), siblings.end());
+        return firstThreads;
+    }();
+
+    return order;
+}
+#endif
+
+void NetworkEngine::PinThread(std::thread& thread, size_t index)
+{
+    const CPUInfo& cpuInfo = CPUInfo::Get();
+    i32 numThreads = Math::Max(cpuInfo.GetNumThreads(), 1);
+
+#ifdef _WIN32
+    // Windows enumerates the hyperthreads of a core next to each other
+    i32 threadsPerCore = Math::Max(numThreads / Math::Max(cpuInfo.GetNumCores(), 1), 1);
+    u64 cpu = (index * threadsPerCore) % numThreads;
+    if (SetThreadAffinityMask(thread.native_handle(), 1ull << cpu) == 0)
+    {
+        DebugHandler::PrintWarning("[NetworkEngine]: Failed to pin io_context %u to cpu %u", static_cast<u32>(index), static_cast<u32>(cpu));
+    }
+#else
+    // Without sysfs every io_context simply gets the next cpu
+    const std::vector<u32>& cpuOrder = GetCpuOrder();
+    u64 cpu = cpuOrder.empty() ? index % numThreads : cpuOrder[index % cpuOrder.size()];
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    if (pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuSet) != 0)
+    {
+        DebugHandler::PrintWarning("[NetworkEngine]: Failed to pin io_context %u to cpu %u", static_cast<u32>(index), static_cast<u32>(cpu));
+    }
+#endif
+}
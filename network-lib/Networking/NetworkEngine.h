@@ -0,0 +1,66 @@
+#pragma once
+#include <NovusTypes.h>
+#include <asio.hpp>
+#include "IoUringContext.h"
+#include "TimingWheel.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+enum class ConnectionDistribution : u8
+{
+    ROUND_ROBIN,
+    LEAST_LOADED
+};
+
+// Owns one io_context per core, every connection is bound to a single context so its handlers never run concurrently
+class NetworkEngine
+{
+public:
+    using WorkGuard = asio::executor_work_guard<asio::io_context::executor_type>;
+
+    // numContexts of 0 means one context per physical core
+    NetworkEngine(u32 numContexts = 0, ConnectionDistribution distribution = ConnectionDistribution::ROUND_ROBIN, bool pinThreads = true);
+    ~NetworkEngine();
+
+    void Start();
+    void Stop();
+    bool IsRunning() { return _isRunning; }
+
+    // Must be picked before Start, returns false and keeps the reactor when the backend isn't available on this build or kernel
+    bool SetBackend(NetworkBackend backend);
+    NetworkBackend GetBackend() { return _backend; }
+    // Sockets accepted by a NetworkServer are attached to this automatically, it is nullptr unless the backend is IO_URING
+    std::shared_ptr<IoUringContext> GetIoUring(asio::io_context& context) { return _backend == NetworkBackend::IO_URING ? _ioUrings[GetContextIndex(context)] : nullptr; }
+
+    size_t GetNumContexts() { return _contexts.size(); }
+    asio::io_context& GetContext(size_t index) { return *_contexts[index]; }
+    size_t GetContextIndex(asio::io_context& context);
+
+    // Every context has its own timing wheel, it may only be used from that context's thread
+    TimingWheel& GetTimingWheel(size_t index) { return *_timingWheels[index]; }
+    TimingWheel& GetTimingWheel(asio::io_context& context) { return *_timingWheels[GetContextIndex(context)]; }
+
+    // Picks the context the next accepted socket should live on
+    size_t NextContextIndex();
+
+    void AddLoad(asio::io_context& context, i32 delta);
+    i32 GetLoad(size_t index) { return _loads[index]; }
+
+private:
+    void PinThread(std::thread& thread, size_t index);
+
+    ConnectionDistribution _distribution;
+    bool _pinThreads;
+    bool _isRunning;
+    NetworkBackend _backend = NetworkBackend::REACTOR;
+
+    std::vector<std::unique_ptr<asio::io_context>> _contexts;
+    std::vector<std::unique_ptr<TimingWheel>> _timingWheels; // Destroyed before the contexts their timers wait on
+    std::vector<std::shared_ptr<IoUringContext>> _ioUrings; // Closed before the contexts, sockets may keep them alive past that
+    std::vector<WorkGuard> _workGuards;
+    std::vector<std::thread> _threads;
+    std::unique_ptr<std::atomic<i32>[]> _loads;
+    std::atomic<size_t> _nextContext;
+};
@@ -2,14 +2,31 @@
 #include <NovusTypes.h>
 #include <Utils/ByteBuffer.h>
 #include <Utils/SharedPool.h>
-#include <Networking/BaseSocket.h>
 #include <Networking/PacketHeader.h>
+#include <Networking/Defines.h>
+
+// Borrowed, read only view of a packet. Whoever hands it out keeps the payload alive until the call it was passed to returns
+struct PacketView
+{
+    PacketHeader header;
+    const u8* payload = nullptr;
+
+    u16 GetSize() const { return header.size; }
+};
 
 struct NetworkPacket
 {
     PacketHeader header;
     std::shared_ptr<Bytebuffer> payload = nullptr;
 
+    PacketView GetView() const
+    {
+        PacketView view;
+        view.header = header;
+        view.payload = payload ? payload->GetDataPointer() : nullptr;
+        return view;
+    }
+
     static std::shared_ptr<NetworkPacket> Borrow()
     {
         if (_networkPacket.empty())
@@ -27,5 +44,38 @@ struct NetworkPacket
         return buffer;
     }
 
+    // Copies a packet view into pooled memory so it can outlive the receive buffer it points into
+    static std::shared_ptr<NetworkPacket> Copy(const std::shared_ptr<NetworkPacket>& view)
+    {
+        return Copy(view->GetView());
+    }
+    static std::shared_ptr<NetworkPacket> Copy(const PacketView& view)
+    {
+        std::shared_ptr<NetworkPacket> packet = Borrow();
+        packet->header = view.header;
+
+        u16 size = view.header.size;
+        if (size <= 128)
+        {
+            packet->payload = Bytebuffer::Borrow<128>();
+        }
+        else if (size <= 1024)
+        {
+            packet->payload = Bytebuffer::Borrow<1024>();
+        }
+        else if (size <= NETWORK_BUFFER_SIZE)
+        {
+            packet->payload = Bytebuffer::Borrow<NETWORK_BUFFER_SIZE>();
+        }
+        else
+        {
+            packet->payload = Bytebuffer::Borrow<NETWORK_MAX_FRAME_SIZE>();
+        }
+
+        if (size > 0)
+            packet->payload->PutBytes(view.payload, size);
+        return packet;
+    }
+
     static SharedPool<NetworkPacket> _networkPacket;
 };
\ No newline at end of file
@@ -1,6 +1,44 @@
 #include "NetworkServer.h"
-#include <Utils/Timer.h>
 #include <Utils/Message.h>
+#include <Utils/DebugHandler.h>
+
+#ifdef SO_REUSEPORT
+using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+NetworkServer::NetworkServer(std::shared_ptr<NetworkEngine> engine, i16 port, bool useReusePort) : _engine(engine), _isRunning(false)
+{
+#ifndef SO_REUSEPORT
+    if (useReusePort)
+    {
+        DebugHandler::PrintWarning("[NetworkServer]: SO_REUSEPORT is not supported on this platform, falling back to a single acceptor");
+        useReusePort = false;
+    }
+#endif
+
+    _useReusePort = useReusePort;
+
+    size_t numAcceptors = _useReusePort ? engine->GetNumContexts() : 1;
+    for (size_t i = 0; i < numAcceptors; i++)
+    {
+        std::unique_ptr<tcp::acceptor> acceptor = std::make_unique<tcp::acceptor>(engine->GetContext(i));
+        tcp::endpoint endpoint(tcp::v4(), port);
+
+        acceptor->open(endpoint.protocol());
+        acceptor->set_option(tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+        if (_useReusePort)
+            acceptor->set_option(reuse_port(true));
+#endif
+        acceptor->bind(endpoint);
+        acceptor->listen();
+
+        // Every acceptor has to share the port the first one was bound to, this matters when port is 0
+        port = acceptor->local_endpoint().port();
+
+        _acceptors.push_back(std::move(acceptor));
+    }
+}
 
 void NetworkServer::Start()
 {
@@ -8,9 +46,10 @@ void NetworkServer::Start()
         return;
 
     _isRunning = true;
-    _runThread = std::thread(&NetworkServer::Run, this);
-
     Listen();
+
+    if (_sharedMemoryListener)
+        _sharedMemoryListener->Listen(std::bind(&NetworkServer::SelectSharedMemoryContext, this), std::bind(&NetworkServer::_internalSharedMemoryHandler, this, std::placeholders::_1));
 }
 void NetworkServer::Stop()
 {
@@ -18,40 +57,159 @@ void NetworkServer::Stop()
         return;
 
     _isRunning = false;
-    _acceptor.close();
+    for (std::unique_ptr<tcp::acceptor>& acceptor : _acceptors)
+    {
+        acceptor->close();
+    }
+
+    if (_sharedMemoryListener)
+        _sharedMemoryListener->Close();
 }
 void NetworkServer::Listen()
 {
-    tcp::socket* socket = new tcp::socket(*_ioService.get());
-    _acceptor.async_accept(*socket, std::bind(&NetworkServer::_internalConnectionHandler, this, socket, std::placeholders::_1));
-}
-void NetworkServer::Run()
-{
-    const f32 targetDelta = 5;
-
-    Timer timer;
-    while (_isRunning)
-    {
-        timer.Tick();
-
-        connectMutex.lock();
-        if (_clients.size())
-        {
-            _clients.erase(
-                std::remove_if(_clients.begin(), _clients.end(), [](std::shared_ptr<NetworkClient>& client)
-                    {
-                        return client->IsClosed();
-                    }),
-                _clients.end());
-        }
-        connectMutex.unlock();
-
-        // This sacrifices percision for performance, but we don't need precision here
-        f32 deltaTime = timer.GetDeltaTime();
-        if (deltaTime <= targetDelta)
-        {
-            i32 timeToSleep = Math::FloorToInt(targetDelta - deltaTime);
-            std::this_thread::sleep_for(std::chrono::seconds(timeToSleep));
-        }
+    for (size_t i = 0; i < _acceptors.size(); i++)
+    {
+        Accept(i);
+    }
+}
+void NetworkServer::Accept(size_t acceptorIndex)
+{
+    tcp::socket* socket = nullptr;
+    if (!_engine)
+    {
+        socket = new tcp::socket(*_ioService.get());
+    }
+    else
+    {
+        // With SO_REUSEPORT the kernel already picked the context for us by choosing the acceptor
+        size_t contextIndex = _useReusePort ? acceptorIndex : _engine->NextContextIndex();
+        socket = new tcp::socket(_engine->GetContext(contextIndex));
+    }
+
+    _acceptors[acceptorIndex]->async_accept(*socket, std::bind(&NetworkServer::_internalConnectionHandler, this, socket, acceptorIndex, std::placeholders::_1));
+}
+bool NetworkServer::EnableSharedMemory(std::function<void(NetworkServer*, std::shared_ptr<NetworkClient>)> sharedMemoryConnectionHandler)
+{
+    if (!SharedMemoryChannel::IsSupported())
+        return false;
+
+    asio::io_context& context = _engine ? _engine->GetContext(0) : *_ioService.get();
+
+    std::unique_ptr<SharedMemoryListener> listener = std::make_unique<SharedMemoryListener>(context, GetPort());
+    if (!listener->IsListening())
+        return false;
+
+    _sharedMemoryConnectionHandler = sharedMemoryConnectionHandler;
+    _sharedMemoryListener = std::move(listener);
+    if (_isRunning)
+        _sharedMemoryListener->Listen(std::bind(&NetworkServer::SelectSharedMemoryContext, this), std::bind(&NetworkServer::_internalSharedMemoryHandler, this, std::placeholders::_1));
+
+    return true;
+}
+asio::io_context& NetworkServer::SelectSharedMemoryContext()
+{
+    return _engine ? _engine->GetContext(_engine->NextContextIndex()) : *_ioService.get();
+}
+void NetworkServer::_internalSharedMemoryHandler(std::shared_ptr<SharedMemoryChannel> channel)
+{
+    // The socket is never opened, it only ties the client to the channel's context
+    std::shared_ptr<NetworkClient> client = std::make_shared<NetworkClient>(new tcp::socket(channel->GetContext()));
+    client->AttachSharedMemory(channel);
+
+    _sharedMemoryConnectionHandler(this, client);
+
+    // Rejected, nothing else holds the channel so it has to be closed for the peer to notice
+    if (!client->GetHandle().IsValid() && client.use_count() == 1)
+        channel->Close();
+}
+void NetworkServer::AddConnection(std::shared_ptr<NetworkClient> client)
+{
+    asio::io_context& context = client->socket()->get_executor().context();
+    if (_engine && !client->IsSharedMemory())
+    {
+        std::shared_ptr<IoUringContext> ioUring = _engine->GetIoUring(context);
+        if (ioUring)
+            client->AttachIoUring(ioUring);
     }
+
+    client->SetHandle(_connections.Add(client));
+    if (_packetCapture)
+        client->SetPacketCapture(_packetCapture, client->GetHandle().ToU64());
+
+    client->_internalSetCloseHandler(std::bind(&NetworkServer::_internalCloseHandler, this, std::placeholders::_1));
+
+    client->SetTimingWheel(GetTimingWheel(context));
+
+    if (_isTickBundling)
+        client->EnableTickBundling(_bundleFlushThreshold);
+
+    // We are usually running on the acceptor's context, the wheel may only be touched from the connection's own
+    if (_idleTimeout.count() > 0 && client->GetTimingWheel())
+        asio::post(context, std::bind(&NetworkClient::SetIdleTimeout, client, _idleTimeout));
+
+    if (_engine)
+        _engine->AddLoad(context, 1);
+
+    client->_internalConnected(true);
+}
+void NetworkServer::EnableTimers()
+{
+    if (_engine || _timingWheel)
+        return;
+
+    _timingWheel = std::make_unique<TimingWheel>(*_ioService.get());
+}
+void NetworkServer::SetIdleTimeout(std::chrono::milliseconds timeout)
+{
+    _idleTimeout = timeout;
+    if (timeout.count() > 0)
+        EnableTimers();
+}
+size_t NetworkServer::Broadcast(std::shared_ptr<Bytebuffer>& buffer)
+{
+    size_t numQueued = 0;
+    _connections.ForEach([&buffer, &numQueued](NetworkClient* client)
+    {
+        if (client->IsClosed())
+            return;
+
+        client->Send(buffer);
+        numQueued++;
+    });
+
+    return numQueued;
+}
+size_t NetworkServer::Broadcast(std::shared_ptr<Bytebuffer>& buffer, const std::vector<ConnectionHandle>& handles)
+{
+    size_t numQueued = 0;
+    _connections.ForEach(handles, [&buffer, &numQueued](NetworkClient* client)
+    {
+        if (client->IsClosed())
+            return;
+
+        client->Send(buffer);
+        numQueued++;
+    });
+
+    return numQueued;
+}
+size_t NetworkServer::FlushTick()
+{
+    size_t numFlushed = 0;
+    _connections.ForEach([&numFlushed](NetworkClient* client)
+    {
+        if (client->FlushTick())
+            numFlushed++;
+    });
+
+    return numFlushed;
+}
+void NetworkServer::_internalCloseHandler(BaseSocket* socket)
+{
+    NetworkClient* client = static_cast<NetworkClient*>(socket);
+
+    if (_engine)
+        _engine->AddLoad(client->socket()->get_executor().context(), -1);
+
+    _connections.Remove(client->GetHandle());
 }
\ No newline at end of file
@@ -2,53 +2,93 @@
 #include <NovusTypes.h>
 #include <asio.hpp>
 #include "NetworkClient.h"
+#include "NetworkEngine.h"
+#include "ConnectionRegistry.h"
+#include "SharedMemoryChannel.h"
+#include "TimingWheel.h"
+#include <chrono>
 
 class NetworkServer
 {
 public:
     using tcp = asio::ip::tcp;
-    NetworkServer(std::shared_ptr<asio::io_service> ioService, i16 port) : _ioService(ioService), _acceptor(*ioService.get(), tcp::endpoint(tcp::v4(), port)), _isRunning(false)
+    // ioService may be run by any number of threads as long as no timers are used, see EnableTimers. Use the NetworkEngine
+    // constructor below to spread connections over several threads with timers
+    NetworkServer(std::shared_ptr<asio::io_service> ioService, i16 port) : _ioService(ioService), _isRunning(false)
     {
-        _clients.reserve(4096);
+        _acceptors.push_back(std::make_unique<tcp::acceptor>(*ioService.get(), tcp::endpoint(tcp::v4(), port)));
     }
+    // Accepted sockets are spread over the engine's contexts, with useReusePort every context gets its own acceptor and the kernel balances new connections between them
+    NetworkServer(std::shared_ptr<NetworkEngine> engine, i16 port, bool useReusePort = false);
 
     void Start();
     void Stop();
     void Listen();
-    void Run();
 
-    void _internalConnectionHandler(tcp::socket* socket, const asio::error_code& error)
+    // Lets processes on this host connect through shared memory. These connections never reach the connection handler, the handler
+    // here receives each one as a client with its channel attached and must add or keep it, anything else closes it
+    bool EnableSharedMemory(std::function<void(NetworkServer*, std::shared_ptr<NetworkClient>)> sharedMemoryConnectionHandler);
+
+    void _internalConnectionHandler(tcp::socket* socket, size_t acceptorIndex, const asio::error_code& error)
     {
         if (_connectionHandler)
             _connectionHandler(this, socket, error);
 
-        Listen();
+        Accept(acceptorIndex);
     }
     void SetConnectionHandler(std::function<void(NetworkServer*, tcp::socket*, const asio::error_code&)> connectionHandler)
     {
         _connectionHandler = connectionHandler;
     }
 
-    void AddConnection(std::shared_ptr<NetworkClient> client)
-    {
-        connectMutex.lock();
-        _clients.push_back(client);
-        connectMutex.unlock();
+    // Connections unregister themselves as soon as they close, they are handed the timing wheel of their io_context
+    void AddConnection(std::shared_ptr<NetworkClient> client);
+    ConnectionRegistry& GetConnections() { return _connections; }
 
-        client->_internalConnected(true);
-    }
+    // Queues the same buffer on every target without copying it, the buffer must not be modified afterwards and returns to its pool once the last write completes
+    size_t Broadcast(std::shared_ptr<Bytebuffer>& buffer);
+    size_t Broadcast(std::shared_ptr<Bytebuffer>& buffer, const std::vector<ConnectionHandle>& handles);
+    // Writes what every bundling connection collected since the last call, once per server tick. Returns how many connections had anything to write
+    size_t FlushTick();
+
+    u32 GetAddress() { return _acceptors[0]->local_endpoint().address().to_v4().to_uint(); }
+    u16 GetPort() { return _acceptors[0]->local_endpoint().port(); }
+    std::shared_ptr<NetworkEngine> GetEngine() { return _engine; }
+    // Null on an ioService server until timers are enabled, connections without a wheel can't use idle timeouts, status deadlines or keepalives
+    TimingWheel* GetTimingWheel(asio::io_context& context) { return _engine ? &_engine->GetTimingWheel(context) : _timingWheel.get(); }
 
-    u32 GetAddress() { return _acceptor.local_endpoint().address().to_v4().to_uint(); }
-    u16 GetPort() { return _acceptor.local_endpoint().port(); }
+    // Gives connections added from now on a timing wheel. An engine always has them, on an ioService server every connection
+    // shares one wheel, so from here on the ioService must only be run by a single thread
+    void EnableTimers();
+    // Applied to connections added from now on, 0 disables it. Needs timers and enables them
+    void SetIdleTimeout(std::chrono::milliseconds timeout);
+    // Connections added from now on bundle their sends until FlushTick, see BaseSocket::EnableTickBundling
+    void EnableTickBundling(size_t flushThreshold = NETWORK_BUNDLE_FLUSH_THRESHOLD) { _bundleFlushThreshold = flushThreshold; _isTickBundling = true; }
+    // Connections added from now on are captured under their handle, set this before Start and toggle the writer itself at runtime
+    void SetPacketCapture(std::shared_ptr<PacketCaptureWriter> capture) { _packetCapture = capture; }
     bool IsRunning() { return _isRunning; }
 
-    std::mutex connectMutex;
 private:
+    void Accept(size_t acceptorIndex);
+    asio::io_context& SelectSharedMemoryContext();
+    void _internalSharedMemoryHandler(std::shared_ptr<SharedMemoryChannel> channel);
+    void _internalCloseHandler(BaseSocket* socket);
+
     std::shared_ptr<asio::io_service> _ioService;
-    asio::ip::tcp::acceptor _acceptor;
+    std::shared_ptr<NetworkEngine> _engine;
+    std::vector<std::unique_ptr<tcp::acceptor>> _acceptors;
+    bool _useReusePort = false;
     std::function<void(NetworkServer*, tcp::socket*, const asio::error_code&)> _connectionHandler;
 
-    std::thread _runThread;
+    std::function<void(NetworkServer*, std::shared_ptr<NetworkClient>)> _sharedMemoryConnectionHandler;
+    std::unique_ptr<SharedMemoryListener> _sharedMemoryListener;
+
+    std::unique_ptr<TimingWheel> _timingWheel;
+    std::chrono::milliseconds _idleTimeout = std::chrono::milliseconds(0);
+    size_t _bundleFlushThreshold = NETWORK_BUNDLE_FLUSH_THRESHOLD;
+    bool _isTickBundling = false;
+    std::shared_ptr<PacketCaptureWriter> _packetCapture;
+
     bool _isRunning;
-    std::vector<std::shared_ptr<NetworkClient>> _clients;
+    ConnectionRegistry _connections;
 };
\ No newline at end of file
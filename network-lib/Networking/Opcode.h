@@ -26,5 +26,9 @@ enum class Opcode : u16
     MSG_MOVE_ENTITY,
     MSG_MOVE_HEARTBEAT_ENTITY,
     MSG_MOVE_STOP_ENTITY,
+    MSG_REQUEST_SERVER_DIRECTORY,
+    SMSG_SERVER_DIRECTORY_SNAPSHOT,
+    SMSG_SERVER_DIRECTORY_UPDATE,
+    SMSG_SERVER_DIRECTORY_REMOVE,
     MAX_COUNT
 };
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "PacketCapture.h"
+#include <Utils/DebugHandler.h>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#ifdef NETWORK_PACKET_CAPTURE_SUPPORTED
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool PacketCaptureWriter::IsSupported()
+{
+    return true;
+}
+
+bool PacketCaptureWriter::Open(const std::string& path, size_t maxSize)
+{
+    if (_isOpen || _numWriters > 0 || maxSize <= sizeof(PacketCaptureFileHeader))
+        return false;
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        DebugHandler::PrintWarning("[PacketCapture]: Failed to open %s", path.c_str());
+        return false;
+    }
+
+    // The file stays sparse until records are written, so sizing it for the worst case up front costs nothing
+    if (ftruncate(fd, static_cast<off_t>(maxSize)) != 0)
+    {
+        DebugHandler::PrintWarning("[PacketCapture]: Failed to size %s to %llu bytes", path.c_str(), static_cast<u64>(maxSize));
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, maxSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        DebugHandler::PrintWarning("[PacketCapture]: Failed to map %s", path.c_str());
+        close(fd);
+        return false;
+    }
+
+    _fd = fd;
+    _data = static_cast<u8*>(data);
+    _size = maxSize;
+    _startTime = Clock::now();
+    _writeOffset = sizeof(PacketCaptureFileHeader);
+    _numPackets = 0;
+    _numDropped = 0;
+
+    PacketCaptureFileHeader fileHeader;
+    fileHeader.startTime = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    std::memcpy(_data, &fileHeader, sizeof(PacketCaptureFileHeader));
+
+    // Everything above has to be visible before the first writer gets in
+    _isOpen = true;
+    return true;
+}
+void PacketCaptureWriter::Close()
+{
+    if (!_isOpen.exchange(false))
+        return;
+
+    // Writers that got in before the flag flipped are still copying into the mapping
+    while (_numWriters > 0)
+    {
+        std::this_thread::yield();
+    }
+
+    size_t endOffset = std::min(_writeOffset.load(), _size);
+
+    PacketCaptureFileHeader fileHeader;
+    std::memcpy(&fileHeader, _data, sizeof(PacketCaptureFileHeader));
+    fileHeader.dataSize = endOffset - sizeof(PacketCaptureFileHeader);
+    std::memcpy(_data, &fileHeader, sizeof(PacketCaptureFileHeader));
+
+    munmap(_data, _size);
+    if (ftruncate(_fd, static_cast<off_t>(endOffset)) != 0)
+        DebugHandler::PrintWarning("[PacketCapture]: Failed to truncate capture, it keeps its reserved size");
+
+    close(_fd);
+
+    _fd = -1;
+    _data = nullptr;
+    _size = 0;
+}
+
+bool PacketCaptureWriter::Write(u64 connectionId, const PacketHeader& header, const u8* payload)
+{
+    if (!_isOpen.load(std::memory_order_relaxed) || header.opcode == Opcode::INVALID)
+        return false;
+
+    _numWriters++;
+    if (!_isOpen)
+    {
+        _numWriters--;
+        return false;
+    }
+
+    size_t recordSize = sizeof(PacketCaptureRecord) + header.size;
+    size_t offset = _writeOffset.fetch_add(recordSize);
+    if (offset + recordSize > _size)
+    {
+        _numDropped++;
+        _numWriters--;
+        return false;
+    }
+
+    PacketCaptureRecord record;
+    record.timestamp = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _startTime).count());
+    record.connectionId = connectionId;
+    record.header = header;
+
+    std::memcpy(_data + offset, &record, sizeof(PacketCaptureRecord));
+    if (header.size > 0)
+        std::memcpy(_data + offset + sizeof(PacketCaptureRecord), payload, header.size);
+
+    _numPackets++;
+    _numWriters--;
+    return true;
+}
+
+bool PacketCaptureReader::Open(const std::string& path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || static_cast<size_t>(fileStat.st_size) < sizeof(PacketCaptureFileHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(fileStat.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    std::memcpy(&_fileHeader, data, sizeof(PacketCaptureFileHeader));
+    if (_fileHeader.magic != PacketCaptureFileHeader::MAGIC || _fileHeader.version != PacketCaptureFileHeader::VERSION)
+    {
+        DebugHandler::PrintWarning("[PacketCapture]: %s is not a capture this version can read", path.c_str());
+        munmap(data, size);
+        close(fd);
+        return false;
+    }
+
+    _fd = fd;
+    _data = static_cast<const u8*>(data);
+    _mappedSize = size;
+    _size = size;
+
+    // A capture that wasn't closed has no data size and keeps its reserved size, we read until the first zeroed record
+    if (_fileHeader.dataSize > 0)
+        _size = std::min(_size, static_cast<size_t>(sizeof(PacketCaptureFileHeader) + _fileHeader.dataSize));
+
+    Rewind();
+    return true;
+}
+void PacketCaptureReader::Close()
+{
+    if (!_data)
+        return;
+
+    munmap(const_cast<u8*>(_data), _mappedSize);
+    close(_fd);
+
+    _fd = -1;
+    _data = nullptr;
+    _mappedSize = 0;
+    _size = 0;
+}
+
+bool PacketCaptureReader::Next(PacketCaptureEntry& entry)
+{
+    if (!_data || _readOffset + sizeof(PacketCaptureRecord) > _size)
+        return false;
+
+    PacketCaptureRecord record;
+    std::memcpy(&record, _data + _readOffset, sizeof(PacketCaptureRecord));
+
+    size_t recordSize = sizeof(PacketCaptureRecord) + record.header.size;
+    if (record.header.opcode == Opcode::INVALID || _readOffset + recordSize > _size)
+        return false;
+
+    entry.timestamp = record.timestamp;
+    entry.connectionId = record.connectionId;
+    entry.packet.header = record.header;
+    entry.packet.payload = _data + _readOffset + sizeof(PacketCaptureRecord);
+
+    _readOffset += recordSize;
+    return true;
+}
+#else
+bool PacketCaptureWriter::IsSupported()
+{
+    return false;
+}
+bool PacketCaptureWriter::Open(const std::string& /*path*/, size_t /*maxSize*/)
+{
+    return false;
+}
+void PacketCaptureWriter::Close() { }
+bool PacketCaptureWriter::Write(u64 /*connectionId*/, const PacketHeader& /*header*/, const u8* /*payload*/)
+{
+    return false;
+}
+
+bool PacketCaptureReader::Open(const std::string& /*path*/)
+{
+    return false;
+}
+void PacketCaptureReader::Close() { }
+bool PacketCaptureReader::Next(PacketCaptureEntry& /*entry*/)
+{
+    return false;
+}
+#endif
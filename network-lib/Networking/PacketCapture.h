@@ -0,0 +1,113 @@
+#pragma once
+#include <NovusTypes.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "Defines.h"
+#include "NetworkPacket.h"
+#include "PacketHeader.h"
+
+#ifndef _WIN32
+#define NETWORK_PACKET_CAPTURE_SUPPORTED
+#endif
+
+/*
+    Capture files are a file header followed by records, each record is a PacketCaptureRecord directly followed by
+    header.size bytes of payload. Nothing is aligned, so fields have to be copied out rather than read in place.
+
+    Payloads are stored the way handlers see them, compressed packets are captured after they have been inflated.
+*/
+#pragma pack(push, 1)
+struct PacketCaptureFileHeader
+{
+    static constexpr u32 MAGIC = 0x4350434E; // "NCPC"
+    static constexpr u16 VERSION = 1;
+
+    u32 magic = MAGIC;
+    u16 version = VERSION;
+    u16 headerSize = sizeof(PacketCaptureFileHeader);
+    u64 startTime = 0; // System clock, nanoseconds since the epoch
+    u64 dataSize = 0; // Bytes of records, only written when the capture is closed cleanly
+};
+struct PacketCaptureRecord
+{
+    u64 timestamp; // Nanoseconds since the capture was opened
+    u64 connectionId;
+    PacketHeader header;
+};
+#pragma pack(pop)
+
+/*
+    Appends received packets to a memory-mapped file.
+
+    The file is sized to maxSize when it is opened and every Write reserves its record with a single atomic add, so any
+    number of io_contexts can capture at once without taking a lock. Packets that don't fit are dropped and counted.
+    Close truncates the file to what was actually written.
+
+    Sockets keep the writer they were given, Open and Close it again to toggle capturing at runtime. While closed a
+    Write costs one relaxed load.
+*/
+class PacketCaptureWriter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    PacketCaptureWriter() { }
+    ~PacketCaptureWriter() { Close(); }
+
+    static bool IsSupported();
+
+    bool Open(const std::string& path, size_t maxSize = NETWORK_CAPTURE_MAX_SIZE);
+    void Close();
+    bool IsOpen() { return _isOpen; }
+
+    // Packets with an INVALID opcode are never captured, zeroed records are what marks the end of a capture that wasn't closed
+    bool Write(u64 connectionId, const PacketHeader& header, const u8* payload);
+
+    u64 GetNumPackets() { return _numPackets; }
+    u64 GetNumDropped() { return _numDropped; }
+
+private:
+    int _fd = -1;
+    u8* _data = nullptr;
+    size_t _size = 0;
+    Clock::time_point _startTime;
+
+    std::atomic<bool> _isOpen = false;
+    std::atomic<i32> _numWriters = 0;
+    std::atomic<size_t> _writeOffset = 0;
+    std::atomic<u64> _numPackets = 0;
+    std::atomic<u64> _numDropped = 0;
+};
+
+struct PacketCaptureEntry
+{
+    u64 timestamp = 0;
+    u64 connectionId = 0;
+    PacketView packet; // Points into the mapped file, valid until the reader is closed
+};
+
+// Maps a capture file read only and walks its records in the order they were reserved, which is not strictly timestamp order
+class PacketCaptureReader
+{
+public:
+    PacketCaptureReader() { }
+    ~PacketCaptureReader() { Close(); }
+
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() { return _data != nullptr; }
+
+    bool Next(PacketCaptureEntry& entry);
+    void Rewind() { _readOffset = sizeof(PacketCaptureFileHeader); }
+
+    const PacketCaptureFileHeader& GetFileHeader() { return _fileHeader; }
+
+private:
+    int _fd = -1;
+    const u8* _data = nullptr;
+    size_t _mappedSize = 0;
+    size_t _size = 0; // End of the records, may be less than what is mapped
+    size_t _readOffset = 0;
+    PacketCaptureFileHeader _fileHeader;
+};
@@ -0,0 +1,107 @@
+#include "PacketCompressor.h"
+#include <chrono>
+
+PacketCompressor::~PacketCompressor()
+{
+    if (_isDeflateInitialized)
+        deflateEnd(&_deflateStream);
+
+    if (_isInflateInitialized)
+        inflateEnd(&_inflateStream);
+}
+
+bool PacketCompressor::Compress(const PacketHeader& header, const u8* payload, std::shared_ptr<Bytebuffer>& output)
+{
+    if (!_isDeflateInitialized)
+    {
+        if (deflateInit2(&_deflateStream, NETWORK_COMPRESSION_LEVEL, Z_DEFLATED, NETWORK_COMPRESSION_WINDOW_BITS, NETWORK_COMPRESSION_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+            return false;
+
+        _isDeflateInitialized = true;
+    }
+
+    // Worst case deflate output for NETWORK_COMPRESSION_MAX_INPUT still fits in a u16 size
+    size_t headerSize = sizeof(PacketHeader) + sizeof(u16);
+    if (!output->CanPerformWrite(headerSize + deflateBound(&_deflateStream, header.size) + 16))
+        return false;
+
+    CompressionStats* stats = header.opcode < Opcode::MAX_COUNT ? &_stats[static_cast<u16>(header.opcode)] : nullptr;
+    u64 numPackets = stats ? stats->numPackets.load(std::memory_order_relaxed) : 0;
+
+    bool isTimed = stats && (numPackets & (NETWORK_COMPRESSION_TIMING_SAMPLE_RATE - 1)) == 0;
+    std::chrono::steady_clock::time_point startTime;
+    if (isTimed)
+        startTime = std::chrono::steady_clock::now();
+
+    u8* frame = output->GetWritePointer();
+    _deflateStream.next_in = const_cast<u8*>(payload);
+    _deflateStream.avail_in = header.size;
+    _deflateStream.next_out = frame + headerSize;
+    _deflateStream.avail_out = static_cast<uInt>(output->GetSpace() - headerSize);
+
+    if (deflate(&_deflateStream, Z_SYNC_FLUSH) != Z_OK || _deflateStream.avail_in != 0)
+        return false;
+
+    size_t compressedSize = (_deflateStream.next_out - frame) - headerSize;
+
+    PacketHeader compressedHeader;
+    compressedHeader.opcode = static_cast<Opcode>(static_cast<u16>(header.opcode) | PACKET_COMPRESSED_FLAG);
+    compressedHeader.size = static_cast<u16>(sizeof(u16) + compressedSize);
+    std::memcpy(frame, &compressedHeader, sizeof(PacketHeader));
+    std::memcpy(frame + sizeof(PacketHeader), &header.size, sizeof(u16));
+
+    output->writtenData += headerSize + compressedSize;
+
+    // There is only ever one thread deflating at a time, a plain load and store is enough and avoids a locked add
+    if (stats)
+    {
+        stats->numPackets.store(numPackets + 1, std::memory_order_relaxed);
+        stats->bytesIn.store(stats->bytesIn.load(std::memory_order_relaxed) + sizeof(PacketHeader) + header.size, std::memory_order_relaxed);
+        stats->bytesOut.store(stats->bytesOut.load(std::memory_order_relaxed) + headerSize + compressedSize, std::memory_order_relaxed);
+
+        if (isTimed)
+        {
+            u64 nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+            stats->numSampledPackets.store(stats->numSampledPackets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            stats->sampledNanoseconds.store(stats->sampledNanoseconds.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+        }
+    }
+
+    return true;
+}
+
+bool PacketCompressor::Decompress(PacketHeader& header, const u8* payload, std::shared_ptr<Bytebuffer>& output)
+{
+    if (header.size < sizeof(u16))
+        return false;
+
+    if (!_isInflateInitialized)
+    {
+        if (inflateInit2(&_inflateStream, NETWORK_COMPRESSION_WINDOW_BITS) != Z_OK)
+            return false;
+
+        _isInflateInitialized = true;
+    }
+
+    u16 uncompressedSize = 0;
+    std::memcpy(&uncompressedSize, payload, sizeof(u16));
+
+    if (!output->CanPerformWrite(uncompressedSize))
+        return false;
+
+    _inflateStream.next_in = const_cast<u8*>(payload + sizeof(u16));
+    _inflateStream.avail_in = header.size - sizeof(u16);
+    _inflateStream.next_out = output->GetWritePointer();
+    _inflateStream.avail_out = uncompressedSize;
+
+    // A sync flushed packet inflates completely, anything else means the streams went out of sync
+    i32 result = inflate(&_inflateStream, Z_SYNC_FLUSH);
+    if ((result != Z_OK && result != Z_BUF_ERROR) || _inflateStream.avail_in != 0 || _inflateStream.avail_out != 0)
+        return false;
+
+    output->writtenData += uncompressedSize;
+
+    header.opcode = static_cast<Opcode>(static_cast<u16>(header.opcode) & ~PACKET_COMPRESSED_FLAG);
+    header.size = uncompressedSize;
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <NovusTypes.h>
+#include <Utils/ByteBuffer.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <zlib.h>
+#include "Defines.h"
+#include "Opcode.h"
+#include "PacketHeader.h"
+
+// Set on PacketHeader::opcode when the payload is compressed, the payload then starts with the uncompressed size as a u16
+#define PACKET_COMPRESSED_FLAG 0x8000
+
+// Kept per opcode on each compressor and only written while deflating, which its owner already serializes
+struct CompressionStats
+{
+    std::atomic<u64> numPackets = 0;
+    std::atomic<u64> bytesIn = 0;
+    std::atomic<u64> bytesOut = 0;
+
+    // Only every NETWORK_COMPRESSION_TIMING_SAMPLE_RATE-th packet of an opcode is timed
+    std::atomic<u64> numSampledPackets = 0;
+    std::atomic<u64> sampledNanoseconds = 0;
+};
+
+/*
+    Streaming deflate/inflate for one connection.
+
+    Both directions keep their z_stream alive for the lifetime of the connection, every packet is flushed with
+    Z_SYNC_FLUSH so it can be inflated on its own while still referencing earlier packets through the shared window.
+    The streams are only initialized the first time they are used, connections that never send large packets don't pay for them.
+    A compressor is not thread safe, BaseSocket keeps one for its sends and a separate one that its read path inflates with.
+*/
+class PacketCompressor
+{
+public:
+    PacketCompressor(size_t threshold) : _threshold(threshold) { }
+    ~PacketCompressor();
+
+    size_t GetThreshold() { return _threshold; }
+    void SetThreshold(size_t threshold) { _threshold = threshold; }
+    bool ShouldCompress(const PacketHeader& header) { return header.size >= _threshold && header.size <= NETWORK_COMPRESSION_MAX_INPUT; }
+
+    // Writes header and payload to output as a compressed frame
+    bool Compress(const PacketHeader& header, const u8* payload, std::shared_ptr<Bytebuffer>& output);
+    // Inflates a compressed payload into output, header is updated to describe the uncompressed packet
+    bool Decompress(PacketHeader& header, const u8* payload, std::shared_ptr<Bytebuffer>& output);
+
+    const CompressionStats& GetStats(Opcode opcode) { return _stats[static_cast<u16>(opcode)]; }
+
+private:
+    size_t _threshold;
+
+    z_stream _deflateStream = { };
+    z_stream _inflateStream = { };
+    bool _isDeflateInitialized = false;
+    bool _isInflateInitialized = false;
+
+    std::array<CompressionStats, static_cast<u16>(Opcode::MAX_COUNT)> _stats;
+};
@@ -0,0 +1,126 @@
+#include "PacketReplay.h"
+#include <Utils/DebugHandler.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+void PacketReplayReport::Print()
+{
+    DebugHandler::Print("[PacketReplay]: %llu packets from %u connections in %.3fs (%.0f packets/s), %llu failed, %llu skipped",
+        static_cast<unsigned long long>(numPackets), numConnections, seconds, seconds > 0 ? numPackets / seconds : 0.0, static_cast<unsigned long long>(numFailed), static_cast<unsigned long long>(numSkipped));
+    DebugHandler::Print("[PacketReplay]: Slowest handler call was opcode %u at record %llu, %.3fms",
+        static_cast<u16>(slowestOpcode), static_cast<unsigned long long>(slowestRecord), slowestNanoseconds / 1000000.0);
+
+    for (u16 i = 0; i < static_cast<u16>(Opcode::MAX_COUNT); i++)
+    {
+        const OpcodeStats& stats = opcodes[i];
+        if (stats.count == 0)
+            continue;
+
+        DebugHandler::Print("[PacketReplay]: Opcode %u: %llu packets, avg %.0fns, max %.0fns", i, static_cast<unsigned long long>(stats.count),
+            static_cast<f64>(stats.totalNanoseconds) / stats.count, static_cast<f64>(stats.maxNanoseconds));
+    }
+}
+
+PacketReplay::PacketReplay(MessageHandler* messageHandler, PacketReplayConfig config) : _messageHandler(messageHandler), _config(config)
+{
+    if (_config.speed <= 0.0f)
+        _config.speed = 1.0f;
+}
+
+PacketReplayReport PacketReplay::Run(PacketCaptureReader& reader)
+{
+    using Clock = std::chrono::steady_clock;
+
+    PacketReplayReport report;
+    Clock::time_point runStart = Clock::now();
+
+    for (u32 iteration = 0; iteration < _config.iterations; iteration++)
+    {
+        // Every iteration replays the sessions from scratch
+        _connections.clear();
+        reader.Rewind();
+
+        Clock::time_point iterationStart = Clock::now();
+        u64 recordIndex = 0;
+
+        PacketCaptureEntry entry;
+        while (reader.Next(entry))
+        {
+            u64 record = recordIndex++;
+
+            if (_config.isPaced)
+            {
+                std::chrono::nanoseconds offset(static_cast<i64>(entry.timestamp / _config.speed));
+                std::this_thread::sleep_until(iterationStart + offset);
+            }
+
+            ReplayConnection& connection = GetConnection(entry.connectionId);
+            if (connection.isClosed)
+            {
+                report.numSkipped++;
+                continue;
+            }
+
+            Clock::time_point callStart = Clock::now();
+            bool result = _messageHandler->CallHandler(*connection.client, entry.packet);
+            u64 nanoseconds = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - callStart).count());
+
+            report.numPackets++;
+            if (!result)
+            {
+                report.numFailed++;
+                connection.client->Close(asio::error::connection_aborted);
+            }
+
+            u16 opcode = static_cast<u16>(entry.packet.header.opcode);
+            if (opcode < static_cast<u16>(Opcode::MAX_COUNT))
+            {
+                PacketReplayReport::OpcodeStats& stats = report.opcodes[opcode];
+                stats.count++;
+                stats.totalNanoseconds += nanoseconds;
+                stats.maxNanoseconds = std::max(stats.maxNanoseconds, nanoseconds);
+            }
+
+            if (nanoseconds > report.slowestNanoseconds)
+            {
+                report.slowestNanoseconds = nanoseconds;
+                report.slowestRecord = record;
+                report.slowestOpcode = entry.packet.header.opcode;
+            }
+        }
+
+        report.numConnections = static_cast<u32>(_connections.size());
+    }
+
+    report.seconds = std::chrono::duration<f64>(Clock::now() - runStart).count();
+    _connections.clear();
+
+    return report;
+}
+
+PacketReplay::ReplayConnection& PacketReplay::GetConnection(u64 connectionId)
+{
+    auto itr = _connections.find(connectionId);
+    if (itr != _connections.end())
+        return itr->second;
+
+    // The socket is never opened, that is what turns every Send from a handler into a no-op.
+    // It also means IsClosed is always true, so we find out about closes through the close handler instead
+    std::shared_ptr<NetworkClient> connection = std::make_shared<NetworkClient>(new asio::ip::tcp::socket(_context));
+    connection->SetStatus(_config.initialStatus);
+    connection->_internalSetCloseHandler(std::bind(&PacketReplay::_internalCloseHandler, this, connectionId));
+
+    ConnectionHandle handle;
+    handle.index = static_cast<u32>(connectionId & 0xFFFFFFFF);
+    handle.generation = static_cast<u32>(connectionId >> 32);
+    connection->SetHandle(handle);
+
+    ReplayConnection& replayConnection = _connections[connectionId];
+    replayConnection.client = connection;
+    return replayConnection;
+}
+void PacketReplay::_internalCloseHandler(u64 connectionId)
+{
+    _connections[connectionId].isClosed = true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <NovusTypes.h>
+#include <asio.hpp>
+#include <memory>
+#include <robin_hood.h>
+#include "ConnectionStatus.h"
+#include "MessageHandler.h"
+#include "NetworkClient.h"
+#include "Opcode.h"
+#include "PacketCapture.h"
+
+struct PacketReplayConfig
+{
+    bool isPaced = false; // Waits for every packet's original timestamp instead of replaying as fast as possible
+    f32 speed = 1.0f; // Scales the pacing, 2 replays twice as fast as it was captured
+    u32 iterations = 1;
+
+    // Captures that don't start at the beginning of every session need connections that are already past the login
+    ConnectionStatus initialStatus = ConnectionStatus::AUTH_NONE;
+};
+
+struct PacketReplayReport
+{
+    struct OpcodeStats
+    {
+        u64 count = 0;
+        u64 totalNanoseconds = 0;
+        u64 maxNanoseconds = 0;
+    };
+
+    u64 numPackets = 0;
+    u64 numFailed = 0; // Rejected by their handler, the connection is closed just like a live server would
+    u64 numSkipped = 0; // Belonged to a connection that was already closed
+    u32 numConnections = 0;
+    f64 seconds = 0;
+
+    // The single slowest handler call, record is the index of the packet in the capture
+    u64 slowestRecord = 0;
+    u64 slowestNanoseconds = 0;
+    Opcode slowestOpcode = Opcode::INVALID;
+
+    OpcodeStats opcodes[static_cast<u16>(Opcode::MAX_COUNT)];
+
+    void Print();
+};
+
+/*
+    Pushes a capture back through a MessageHandler without any sockets.
+
+    Every connection id in the capture gets its own NetworkClient with a socket that is never opened, so handlers see the
+    same connection state changes they did live while anything they send is discarded. Packets are dispatched on the
+    calling thread through the view path, straight out of the mapped file.
+*/
+class PacketReplay
+{
+public:
+    PacketReplay(MessageHandler* messageHandler, PacketReplayConfig config);
+
+    PacketReplayReport Run(PacketCaptureReader& reader);
+
+private:
+    struct ReplayConnection
+    {
+        std::shared_ptr<NetworkClient> client;
+        bool isClosed = false;
+    };
+
+    ReplayConnection& GetConnection(u64 connectionId);
+    void _internalCloseHandler(u64 connectionId);
+
+    MessageHandler* _messageHandler;
+    PacketReplayConfig _config;
+
+    asio::io_context _context;
+    robin_hood::unordered_map<u64, ReplayConnection> _connections;
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include <NovusTypes.h>
+#include <Utils/ByteBuffer.h>
+#include <array>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include "Opcode.h"
+#include "PacketHeader.h"
+
+/*
+    Declarative packet layouts, list the fields of a packet once and get matching read and write code:
+
+        using SMSG_EXAMPLE = PacketSchema::Packet<Opcode::SMSG_EXAMPLE, u8, u32, std::string>;
+        SMSG_EXAMPLE::Write(buffer, status, address, name);
+        SMSG_EXAMPLE::Read(packet->payload, status, address, name);
+
+    Any trivially copyable type is written as its raw bytes, std::string is written null terminated and
+    PacketSchema::Bytes consumes whatever remains of the payload, so it has to be the last field.
+    The size prefix is computed before anything is written and packets made of fixed size fields need
+    exactly one bounds check for the whole packet.
+*/
+namespace PacketSchema
+{
+    struct Bytes
+    {
+        Bytes() { }
+        Bytes(const u8* inData, size_t inSize) : data(inData), size(inData != nullptr ? inSize : 0) { }
+
+        const u8* data = nullptr;
+        size_t size = 0;
+    };
+
+    template <typename T>
+    struct FieldTraits
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "PacketSchema fields must be trivially copyable or have a FieldTraits specialization");
+
+        static constexpr bool IsFixedSize = true;
+        static constexpr size_t MinSize = sizeof(T);
+
+        static size_t GetSize(const T&) { return sizeof(T); }
+        static u8* Write(u8* dest, const T& val)
+        {
+            std::memcpy(dest, &val, sizeof(T));
+            return dest + sizeof(T);
+        }
+        template <bool Checked>
+        static bool Read(const u8*& src, const u8* end, T& val)
+        {
+            if constexpr (Checked)
+            {
+                if (static_cast<size_t>(end - src) < sizeof(T))
+                    return false;
+            }
+
+            std::memcpy(&val, src, sizeof(T));
+            src += sizeof(T);
+            return true;
+        }
+    };
+
+    template <>
+    struct FieldTraits<std::string>
+    {
+        static constexpr bool IsFixedSize = false;
+        static constexpr size_t MinSize = 1;
+
+        static size_t GetSize(const std::string& val) { return val.length() + 1; }
+        static u8* Write(u8* dest, const std::string& val)
+        {
+            std::memcpy(dest, val.data(), val.length());
+            dest[val.length()] = 0;
+            return dest + val.length() + 1;
+        }
+        template <bool Checked>
+        static bool Read(const u8*& src, const u8* end, std::string& val)
+        {
+            const u8* terminator = static_cast<const u8*>(std::memchr(src, 0, end - src));
+            if (terminator == nullptr)
+                return false;
+
+            val.assign(reinterpret_cast<const char*>(src), terminator - src);
+            src = terminator + 1;
+            return true;
+        }
+    };
+
+    template <>
+    struct FieldTraits<Bytes>
+    {
+        static constexpr bool IsFixedSize = false;
+        static constexpr size_t MinSize = 0;
+
+        static size_t GetSize(const Bytes& val) { return val.size; }
+        static u8* Write(u8* dest, const Bytes& val)
+        {
+            if (val.size > 0)
+                std::memcpy(dest, val.data, val.size);
+
+            return dest + val.size;
+        }
+        // Reading gives a view into the payload rather than a copy
+        template <bool Checked>
+        static bool Read(const u8*& src, const u8* end, Bytes& val)
+        {
+            val.data = src;
+            val.size = end - src;
+            src = end;
+            return true;
+        }
+    };
+
+    template <Opcode PacketOpcode, typename... Fields>
+    struct Packet
+    {
+        static constexpr Opcode OPCODE = PacketOpcode;
+        static constexpr bool IsFixedSize = (FieldTraits<Fields>::IsFixedSize && ...);
+
+        // For packets with variable fields these describe the smallest possible packet
+        static constexpr size_t MinPayloadSize = (FieldTraits<Fields>::MinSize + ... + 0);
+        static constexpr size_t MinWireSize = sizeof(PacketHeader) + MinPayloadSize;
+
+        static_assert(MinPayloadSize <= 0xFFFF, "PacketSchema payload does not fit in PacketHeader::size");
+
+        static size_t GetPayloadSize(const Fields&... fields)
+        {
+            if constexpr (IsFixedSize)
+            {
+                return MinPayloadSize;
+            }
+            else
+            {
+                return (FieldTraits<Fields>::GetSize(fields) + ... + 0);
+            }
+        }
+
+        static bool Write(std::shared_ptr<Bytebuffer>& buffer, const Fields&... fields)
+        {
+            size_t payloadSize = GetPayloadSize(fields...);
+            if (payloadSize > 0xFFFF || !buffer->CanPerformWrite(sizeof(PacketHeader) + payloadSize))
+                return false;
+
+            PacketHeader header;
+            header.opcode = PacketOpcode;
+            header.size = static_cast<u16>(payloadSize);
+
+            u8* dest = buffer->GetWritePointer();
+            std::memcpy(dest, &header, sizeof(PacketHeader));
+            dest += sizeof(PacketHeader);
+
+            ((dest = FieldTraits<Fields>::Write(dest, fields)), ...);
+
+            buffer->writtenData += sizeof(PacketHeader) + payloadSize;
+            return true;
+        }
+
+        // Reads the fields from a packet payload, the header has already been consumed by the framer
+        static bool Read(std::shared_ptr<Bytebuffer>& payload, Fields&... fields)
+        {
+            size_t bytesRead = 0;
+            if (!Read(payload->GetReadPointer(), payload->writtenData - payload->readData, bytesRead, fields...))
+                return false;
+
+            payload->readData += bytesRead;
+            return true;
+        }
+        // Same as above for a borrowed payload, e.g. Read(packet.payload, packet.GetSize(), ...) from a PacketView
+        static bool Read(const u8* payload, size_t size, Fields&... fields)
+        {
+            size_t bytesRead = 0;
+            return Read(payload, size, bytesRead, fields...);
+        }
+        static bool Read(const u8* payload, size_t size, size_t& bytesRead, Fields&... fields)
+        {
+            if (size < MinPayloadSize)
+                return false;
+
+            const u8* end = payload + size;
+            const u8* src = payload;
+
+            bool result = true;
+            if constexpr (IsFixedSize)
+            {
+                ((FieldTraits<Fields>::template Read<false>(src, end, fields)), ...);
+            }
+            else
+            {
+                result = (FieldTraits<Fields>::template Read<true>(src, end, fields) && ...);
+            }
+
+            if (result)
+                bytesRead = src - payload;
+
+            return result;
+        }
+    };
+}
@@ -4,134 +4,50 @@
 #include <entity/fwd.hpp>
 #include "Opcode.h"
 #include "AddressType.h"
+#include "PacketSchema.h"
 
 namespace PacketUtils
 {
+    using MSG_REQUEST_ADDRESS = PacketSchema::Packet<Opcode::MSG_REQUEST_ADDRESS, AddressType, entt::entity, PacketSchema::Bytes>;
+    using SMSG_SEND_ADDRESS = PacketSchema::Packet<Opcode::SMSG_SEND_ADDRESS, u8, u32, u16, PacketSchema::Bytes>;
+    using SMSG_SEND_ADDRESS_FAILED = PacketSchema::Packet<Opcode::SMSG_SEND_ADDRESS, u8, PacketSchema::Bytes>;
+    using SMSG_SEND_FULL_INTERNAL_SERVER_INFO = PacketSchema::Packet<Opcode::SMSG_SEND_FULL_INTERNAL_SERVER_INFO, PacketSchema::Bytes>;
+    using SMSG_SEND_ADD_INTERNAL_SERVER_INFO = PacketSchema::Packet<Opcode::SMSG_SEND_ADD_INTERNAL_SERVER_INFO, entt::entity, AddressType, u8, u32, u16>;
+    using SMSG_SEND_REMOVE_INTERNAL_SERVER_INFO = PacketSchema::Packet<Opcode::SMSG_SEND_REMOVE_INTERNAL_SERVER_INFO, entt::entity, AddressType, u8>;
+    using CMSG_LOGON_HANDSHAKE = PacketSchema::Packet<Opcode::CMSG_LOGON_HANDSHAKE, std::array<u8, 32>>;
+    using SMSG_LOGON_HANDSHAKE = PacketSchema::Packet<Opcode::SMSG_LOGON_HANDSHAKE, std::array<u8, 32>>;
+
     inline bool Write_MSG_REQUEST_ADDRESS(std::shared_ptr<Bytebuffer>& buffer, AddressType type, entt::entity entity, u8* extraData = nullptr, size_t extraDataSize = 0)
     {
-        if (!buffer->Put(Opcode::MSG_REQUEST_ADDRESS))
-            return false;
-
-        size_t currentWriteIndex = buffer->writtenData;
-        if (!buffer->SkipWrite(sizeof(u16)))
-            return false;
-
-        if (!buffer->Put(type))
-            return false;
-
-        if (!buffer->PutEnttId(entity))
-            return false;
-
-        if (extraData != nullptr && extraDataSize > 0)
-        {
-            if (!buffer->PutBytes(extraData, extraDataSize))
-                return false;
-        }
-
-        size_t packetSize = (buffer->writtenData - currentWriteIndex) - 2;
-        if (!buffer->Put<u16>(static_cast<u16>(packetSize), currentWriteIndex))
-            return false;
-
-        return true;
+        return MSG_REQUEST_ADDRESS::Write(buffer, type, entity, PacketSchema::Bytes(extraData, extraDataSize));
     }
     inline bool Write_SMSG_SEND_ADDRESS(std::shared_ptr<Bytebuffer>& buffer, u8 status, u32 address = 0, u16 port = 0, u8* extraData = nullptr, size_t extraDataSize = 0)
     {
-        if (!buffer->Put(Opcode::SMSG_SEND_ADDRESS))
-            return false;
-
-        size_t currentWriteIndex = buffer->writtenData;
-        if (!buffer->SkipWrite(sizeof(u16)))
-            return false;
-
-        if (!buffer->PutU8(status))
-            return false;
-
+        // The address is only sent when the request succeeded
         if (status > 0)
-        {
-            if (!buffer->PutU32(address))
-                return false;
-
-            if (!buffer->PutU16(port))
-                return false;
-        }
-
-        if (extraData != nullptr && extraDataSize > 0)
-        {
-            if (!buffer->PutBytes(extraData, extraDataSize))
-                return false;
-        }
-
-        size_t packetSize = (buffer->writtenData - currentWriteIndex) - 2;
-        if (!buffer->Put<u16>(static_cast<u16>(packetSize), currentWriteIndex))
-            return false;
+            return SMSG_SEND_ADDRESS::Write(buffer, status, address, port, PacketSchema::Bytes(extraData, extraDataSize));
 
-        return true;
+        return SMSG_SEND_ADDRESS_FAILED::Write(buffer, status, PacketSchema::Bytes(extraData, extraDataSize));
     }
     inline bool Write_SMSG_SEND_FULL_INTERNAL_SERVER_INFO(std::shared_ptr<Bytebuffer>& buffer, const u8* serverInfoData, size_t numServers)
     {
-        if (!buffer->Put(Opcode::SMSG_SEND_FULL_INTERNAL_SERVER_INFO))
-            return false;
-
-        size_t packetSize = (sizeof(entt::entity) + sizeof(AddressType) + 1 + sizeof(u32) + sizeof(u16)) * numServers;
-        if (!buffer->PutU16(static_cast<u16>(packetSize)))
-            return false;
-        
         /*
             The data here is packed as following inside of a struct called "ServerInformation", however
             the struct is not located in common, thus we cannot reference it here.
 
             It is not in "common" because only 2 servers needs to know the structure.
 
-            Entt::Entity, AddressType, u32, u16
+            Entt::Entity, AddressType, u8, u32, u16
         */
-
-        if (!buffer->PutBytes(serverInfoData, packetSize))
-            return false;
-
-        return true;
+        size_t serverInfoSize = sizeof(entt::entity) + sizeof(AddressType) + sizeof(u8) + sizeof(u32) + sizeof(u16);
+        return SMSG_SEND_FULL_INTERNAL_SERVER_INFO::Write(buffer, PacketSchema::Bytes(serverInfoData, serverInfoSize * numServers));
     }
     inline bool Write_SMSG_SEND_ADD_INTERNAL_SERVER_INFO(std::shared_ptr<Bytebuffer>& buffer, entt::entity entity, AddressType type, u8 realmId, u32 address, u16 port)
     {
-        if (!buffer->Put(Opcode::SMSG_SEND_ADD_INTERNAL_SERVER_INFO))
-            return false;
-
-        if (!buffer->PutU16(sizeof(entt::entity) + sizeof(AddressType) + sizeof(u32) + sizeof(u16)))
-            return false;
-        
-        if (!buffer->PutEnttId(entity))
-            return false;
-
-        if (!buffer->Put(type))
-            return false;
-
-        if (!buffer->PutU8(realmId))
-            return false;
-
-        if (!buffer->PutU32(address))
-            return false;
-
-        if (!buffer->PutU16(port))
-            return false;
-
-        return true;
+        return SMSG_SEND_ADD_INTERNAL_SERVER_INFO::Write(buffer, entity, type, realmId, address, port);
     }
     inline bool Write_SMSG_SEND_REMOVE_INTERNAL_SERVER_INFO(std::shared_ptr<Bytebuffer>& buffer, entt::entity entity, AddressType type, u8 realmId)
     {
-        if (!buffer->Put(Opcode::SMSG_SEND_REMOVE_INTERNAL_SERVER_INFO))
-            return false;
-
-        if (!buffer->PutU16(sizeof(entt::entity) + sizeof(AddressType)))
-            return false;
-        
-        if (!buffer->PutEnttId(entity))
-            return false;
-
-        if (!buffer->Put(type))
-            return false;
-
-        if (!buffer->PutU8(realmId))
-            return false;
-
-        return true;
+        return SMSG_SEND_REMOVE_INTERNAL_SERVER_INFO::Write(buffer, entity, type, realmId);
     }
-}
\ No newline at end of file
+}
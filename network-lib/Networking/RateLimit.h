@@ -0,0 +1,89 @@
+#pragma once
+#include <NovusTypes.h>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "Opcode.h"
+
+struct NetworkPacket;
+
+enum class RateLimitAction : u8
+{
+    DROP, // Over-limit packets are thrown away
+    COALESCE // The newest over-limit packet of the opcode is kept and delivered once a token is available again, older ones are dropped
+};
+
+// rate of 0 means the opcode is not limited, burst is how many packets may arrive back to back
+struct OpcodeRateLimit
+{
+    OpcodeRateLimit() { }
+    OpcodeRateLimit(u16 inRate, u16 inBurst, RateLimitAction inAction = RateLimitAction::DROP) : rate(inRate), burst(inBurst), action(inAction) { }
+
+    u16 rate = 0; // Packets per second
+    u16 burst = 0;
+    RateLimitAction action = RateLimitAction::DROP;
+};
+
+// Tokens are kept in thousandths so refilling never needs floating point
+struct TokenBucket
+{
+    static constexpr u32 FULL = std::numeric_limits<u32>::max();
+
+    u32 milliTokens = FULL;
+    u32 lastRefillMs = 0;
+
+    bool TryConsume(const OpcodeRateLimit& limit, u32 nowMs)
+    {
+        u32 capacity = static_cast<u32>(limit.burst) * 1000;
+
+        if (milliTokens == FULL)
+        {
+            milliTokens = capacity;
+        }
+        else
+        {
+            // rate tokens per second is exactly rate milli-tokens per millisecond
+            u64 refill = static_cast<u64>(nowMs - lastRefillMs) * limit.rate;
+            milliTokens = static_cast<u32>(std::min<u64>(milliTokens + refill, capacity));
+        }
+        lastRefillMs = nowMs;
+
+        if (milliTokens < 1000)
+            return false;
+
+        milliTokens -= 1000;
+        return true;
+    }
+
+    // Milliseconds after the last TryConsume until the next token is available
+    u32 GetWaitMs(const OpcodeRateLimit& limit)
+    {
+        if (milliTokens >= 1000 || limit.rate == 0)
+            return 0;
+
+        return (1000 - milliTokens + limit.rate - 1) / limit.rate;
+    }
+};
+
+// Lives inline in every NetworkClient, only touched by whoever dispatches that connection's packets
+class ConnectionRateLimiter
+{
+public:
+    TokenBucket& GetBucket(Opcode opcode) { return _buckets[static_cast<u16>(opcode)]; }
+
+    // At most one held back packet per opcode, only a few opcodes coalesce so they are searched linearly
+    std::vector<std::shared_ptr<NetworkPacket>>& GetCoalescedPackets() { return _coalescedPackets; }
+    bool IsFlushScheduled() { return _isFlushScheduled; }
+    void SetFlushScheduled(bool isFlushScheduled) { _isFlushScheduled = isFlushScheduled; }
+
+    void AddLimited() { _numLimited++; }
+    u32 GetNumLimited() { return _numLimited; }
+
+private:
+    std::array<TokenBucket, static_cast<u16>(Opcode::MAX_COUNT)> _buckets;
+    std::vector<std::shared_ptr<NetworkPacket>> _coalescedPackets;
+    bool _isFlushScheduled = false;
+    u32 _numLimited = 0;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <NovusTypes.h>
+#include <array>
+#include "Opcode.h"
+
+enum class SendLane : u8
+{
+    MOVEMENT, // Goes stale within a tick, has to overtake everything else
+    DEFAULT,
+    BULK, // Large one-off transfers, nobody waits on a single frame of these
+    COUNT
+};
+
+struct SendLaneInfo
+{
+    SendLane lane = SendLane::DEFAULT;
+
+    // A queued frame with this opcode is dropped once a newer one for the same entity is sent. The payload of these
+    // opcodes starts with the u32 entity it is about
+    bool isSuperseded = false;
+};
+
+/*
+    Which send lane every opcode goes out on, opcodes not listed here use the default lane. Frames are only ordered
+    within a lane, so opcodes that have to arrive in order (e.g. creating, updating and deleting an entity) share one.
+    Movement is the exception: a MSG_MOVE_* can overtake the SMSG_CREATE_ENTITY of its entity, so clients have to
+    ignore moves for entities they don't know yet.
+
+    Every socket drains its lanes with deficit round robin, each round a lane may write its quantum in bytes. A lane is
+    never starved, but movement gets to write four times as much as bulk traffic and is written first in every round.
+*/
+namespace SendLanes
+{
+    constexpr std::array<size_t, static_cast<size_t>(SendLane::COUNT)> Quantum = { 4096, 2048, 1024 };
+
+    constexpr std::array<SendLaneInfo, static_cast<size_t>(Opcode::MAX_COUNT)> CreateTable()
+    {
+        std::array<SendLaneInfo, static_cast<size_t>(Opcode::MAX_COUNT)> table = { };
+
+        table[static_cast<size_t>(Opcode::MSG_MOVE_ENTITY)] = { SendLane::MOVEMENT, false };
+        table[static_cast<size_t>(Opcode::MSG_MOVE_HEARTBEAT_ENTITY)] = { SendLane::MOVEMENT, true };
+        table[static_cast<size_t>(Opcode::MSG_MOVE_STOP_ENTITY)] = { SendLane::MOVEMENT, false };
+
+        table[static_cast<size_t>(Opcode::SMSG_SEND_REALMLIST)] = { SendLane::BULK, false };
+
+        return table;
+    }
+    constexpr std::array<SendLaneInfo, static_cast<size_t>(Opcode::MAX_COUNT)> Table = CreateTable();
+
+    inline SendLaneInfo Get(Opcode opcode)
+    {
+        size_t index = static_cast<size_t>(opcode);
+        return index < Table.size() ? Table[index] : SendLaneInfo();
+    }
+}
@@ -0,0 +1,422 @@
+#include "ServerDirectory.h"
+#include "Defines.h"
+#include "NetworkServer.h"
+#include "PacketSchema.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace
+{
+    enum SnapshotFlags : u8
+    {
+        SNAPSHOT_FLAG_FIRST = 1 << 0,
+        SNAPSHOT_FLAG_LAST = 1 << 1
+    };
+
+    using MSG_REQUEST_SERVER_DIRECTORY = PacketSchema::Packet<Opcode::MSG_REQUEST_SERVER_DIRECTORY, u32, u64>;
+    using SMSG_SERVER_DIRECTORY_SNAPSHOT = PacketSchema::Packet<Opcode::SMSG_SERVER_DIRECTORY_SNAPSHOT, u32, u64, u8, PacketSchema::Bytes>;
+    using SMSG_SERVER_DIRECTORY_UPDATE = PacketSchema::Packet<Opcode::SMSG_SERVER_DIRECTORY_UPDATE, u64, ServerEntry>;
+    using SMSG_SERVER_DIRECTORY_REMOVE = PacketSchema::Packet<Opcode::SMSG_SERVER_DIRECTORY_REMOVE, u64, entt::entity>;
+
+    constexpr size_t MAX_SNAPSHOT_ENTRIES = (0xFFFF - SMSG_SERVER_DIRECTORY_SNAPSHOT::MinPayloadSize) / sizeof(ServerEntry);
+
+    // Frames are appended to the last buffer until it is full
+    std::shared_ptr<Bytebuffer>& GetWriteBuffer(std::vector<std::shared_ptr<Bytebuffer>>& buffers, size_t frameSize)
+    {
+        if (buffers.empty() || !buffers.back()->CanPerformWrite(frameSize))
+            buffers.push_back(Bytebuffer::Borrow<NETWORK_MAX_FRAME_SIZE>());
+
+        return buffers.back();
+    }
+}
+
+ServerDirectory::ServerDirectory(NetworkServer* server) : _server(server), _history(NETWORK_DIRECTORY_HISTORY_SIZE), _numSnapshotsSent(0)
+{
+    std::random_device random;
+    do
+    {
+        _epoch = random();
+    } while (_epoch == 0);
+}
+
+u64 ServerDirectory::Set(const ServerEntry& entry)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto itr = _entries.find(entry.entity);
+    if (itr != _entries.end() && std::memcmp(&itr->second, &entry, sizeof(ServerEntry)) == 0)
+        return 0;
+
+    Change change;
+    change.version = _version + 1;
+    change.entry = entry;
+
+    ApplyChange(change);
+    Publish(change);
+    return change.version;
+}
+u64 ServerDirectory::Remove(entt::entity entity)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto itr = _entries.find(entity);
+    if (itr == _entries.end())
+        return 0;
+
+    Change change;
+    change.version = _version + 1;
+    change.isRemove = true;
+    change.entry = itr->second;
+
+    ApplyChange(change);
+    Publish(change);
+    return change.version;
+}
+
+bool ServerDirectory::Get(entt::entity entity, ServerEntry& entry)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto itr = _entries.find(entity);
+    if (itr == _entries.end())
+        return false;
+
+    entry = itr->second;
+    return true;
+}
+std::vector<ServerEntry> ServerDirectory::Find(AddressType type, RegionType region)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<ServerEntry> entries;
+
+    auto itr = _entriesByKey.find(GetKey(type, region));
+    if (itr == _entriesByKey.end())
+        return entries;
+
+    entries.reserve(itr->second.size());
+    for (entt::entity entity : itr->second)
+    {
+        entries.push_back(_entries[entity]);
+    }
+
+    return entries;
+}
+bool ServerDirectory::FindAny(AddressType type, RegionType region, ServerEntry& entry)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto itr = _entriesByKey.find(GetKey(type, region));
+    if (itr == _entriesByKey.end() || itr->second.empty())
+        return false;
+
+    // Spreads whoever asks over every matching server
+    static thread_local std::minstd_rand random(std::random_device{}());
+    entt::entity entity = itr->second[random() % itr->second.size()];
+
+    entry = _entries[entity];
+    return true;
+}
+size_t ServerDirectory::Count()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+u32 ServerDirectory::GetEpoch()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _epoch;
+}
+u64 ServerDirectory::GetVersion()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _version;
+}
+
+bool ServerDirectory::Subscribe(NetworkClient& client, const PacketView& request)
+{
+    u32 epoch = 0;
+    u64 knownVersion = 0;
+    if (!MSG_REQUEST_SERVER_DIRECTORY::Read(request.payload, request.GetSize(), epoch, knownVersion))
+        return false;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Sending the sync and adding the subscriber under the same lock means no change can fall in between
+    std::vector<std::shared_ptr<Bytebuffer>> buffers;
+    WriteSyncFrames(buffers, epoch, knownVersion);
+
+    for (std::shared_ptr<Bytebuffer>& buffer : buffers)
+    {
+        client.Send(buffer);
+    }
+
+    ConnectionHandle handle = client.GetHandle();
+    if (!handle.IsValid())
+        return false;
+
+    if (std::find(_subscribers.begin(), _subscribers.end(), handle) == _subscribers.end())
+        _subscribers.push_back(handle);
+
+    return true;
+}
+void ServerDirectory::Unsubscribe(ConnectionHandle handle)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto itr = std::find(_subscribers.begin(), _subscribers.end(), handle);
+    if (itr == _subscribers.end())
+        return;
+
+    *itr = _subscribers.back();
+    _subscribers.pop_back();
+}
+size_t ServerDirectory::GetNumSubscribers()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _subscribers.size();
+}
+
+bool ServerDirectory::WriteRequest(std::shared_ptr<Bytebuffer>& buffer, u32 epoch, u64 knownVersion)
+{
+    return MSG_REQUEST_SERVER_DIRECTORY::Write(buffer, epoch, knownVersion);
+}
+bool ServerDirectory::WriteResumeRequest(std::shared_ptr<Bytebuffer>& buffer)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return WriteRequest(buffer, _epoch, _version);
+}
+bool ServerDirectory::Apply(const PacketView& packet)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Change change;
+    switch (packet.header.opcode)
+    {
+        case Opcode::SMSG_SERVER_DIRECTORY_SNAPSHOT:
+        {
+            u32 epoch = 0;
+            u64 version = 0;
+            u8 flags = 0;
+            PacketSchema::Bytes entries;
+            if (!SMSG_SERVER_DIRECTORY_SNAPSHOT::Read(packet.payload, packet.GetSize(), epoch, version, flags, entries))
+                return false;
+
+            if (entries.size % sizeof(ServerEntry) != 0)
+                return false;
+
+            if (flags & SNAPSHOT_FLAG_FIRST)
+            {
+                _pendingSnapshot.clear();
+                _pendingEpoch = epoch;
+                _pendingVersion = version;
+            }
+            else if (epoch != _pendingEpoch || version != _pendingVersion)
+            {
+                return false;
+            }
+
+            size_t numEntries = entries.size / sizeof(ServerEntry);
+            size_t offset = _pendingSnapshot.size();
+            _pendingSnapshot.resize(offset + numEntries);
+            if (numEntries > 0)
+                std::memcpy(&_pendingSnapshot[offset], entries.data, entries.size);
+
+            if (!(flags & SNAPSHOT_FLAG_LAST))
+                return true;
+
+            _entries.clear();
+            _entriesByKey.clear();
+            for (const ServerEntry& entry : _pendingSnapshot)
+            {
+                Insert(entry);
+            }
+
+            _epoch = _pendingEpoch;
+            _version = _pendingVersion;
+            _oldestVersion = _version + 1;
+
+            _pendingSnapshot.clear();
+            _pendingSnapshot.shrink_to_fit();
+            return true;
+        }
+        case Opcode::SMSG_SERVER_DIRECTORY_UPDATE:
+        {
+            if (!SMSG_SERVER_DIRECTORY_UPDATE::Read(packet.payload, packet.GetSize(), change.version, change.entry))
+                return false;
+
+            break;
+        }
+        case Opcode::SMSG_SERVER_DIRECTORY_REMOVE:
+        {
+            if (!SMSG_SERVER_DIRECTORY_REMOVE::Read(packet.payload, packet.GetSize(), change.version, change.entry.entity))
+                return false;
+
+            change.isRemove = true;
+            break;
+        }
+        default:
+            return false;
+    }
+
+    // Changes we already have are harmless, a missing one means this directory can no longer be trusted
+    if (change.version <= _version)
+        return true;
+
+    if (change.version != _version + 1)
+        return false;
+
+    return ApplyChange(change);
+}
+
+std::vector<std::shared_ptr<Bytebuffer>> ServerDirectory::WriteSync(u32 epoch, u64 knownVersion)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<std::shared_ptr<Bytebuffer>> buffers;
+    WriteSyncFrames(buffers, epoch, knownVersion);
+
+    return buffers;
+}
+
+void ServerDirectory::Insert(const ServerEntry& entry)
+{
+    ServerEntry erased;
+    Erase(entry.entity, erased);
+
+    _entries[entry.entity] = entry;
+    _entriesByKey[GetKey(entry.type, entry.region)].push_back(entry.entity);
+}
+bool ServerDirectory::Erase(entt::entity entity, ServerEntry& erased)
+{
+    auto itr = _entries.find(entity);
+    if (itr == _entries.end())
+        return false;
+
+    erased = itr->second;
+    _entries.erase(itr);
+
+    std::vector<entt::entity>& entities = _entriesByKey[GetKey(erased.type, erased.region)];
+    auto entityItr = std::find(entities.begin(), entities.end(), entity);
+    if (entityItr != entities.end())
+    {
+        *entityItr = entities.back();
+        entities.pop_back();
+    }
+
+    return true;
+}
+void ServerDirectory::Record(const Change& change)
+{
+    _history[change.version % _history.size()] = change;
+    _version = change.version;
+
+    if (_version - _oldestVersion + 1 > _history.size())
+        _oldestVersion = _version - _history.size() + 1;
+}
+void ServerDirectory::Publish(const Change& change)
+{
+    if (_server == nullptr || _subscribers.empty())
+        return;
+
+    std::shared_ptr<Bytebuffer> buffer = Bytebuffer::Borrow<128>();
+    if (change.isRemove)
+        SMSG_SERVER_DIRECTORY_REMOVE::Write(buffer, change.version, change.entry.entity);
+    else
+        SMSG_SERVER_DIRECTORY_UPDATE::Write(buffer, change.version, change.entry);
+
+    size_t numQueued = _server->Broadcast(buffer, _subscribers);
+    if (numQueued == _subscribers.size())
+        return;
+
+    // Some subscribers have disconnected, they resubscribe with their version once they are back
+    ConnectionRegistry& connections = _server->GetConnections();
+    _subscribers.erase(std::remove_if(_subscribers.begin(), _subscribers.end(), [&connections](const ConnectionHandle& handle)
+    {
+        std::shared_ptr<NetworkClient> client = connections.Get(handle);
+        return client == nullptr || client->IsClosed();
+    }), _subscribers.end());
+}
+bool ServerDirectory::CanResume(u32 epoch, u64 knownVersion)
+{
+    if (epoch != _epoch || knownVersion > _version || knownVersion + 1 < _oldestVersion)
+        return false;
+
+    // Past this point the changes alone are more to send than the whole directory
+    size_t changesSize = (_version - knownVersion) * SMSG_SERVER_DIRECTORY_UPDATE::MinWireSize;
+    size_t snapshotSize = SMSG_SERVER_DIRECTORY_SNAPSHOT::MinWireSize + _entries.size() * sizeof(ServerEntry);
+    return changesSize <= snapshotSize;
+}
+void ServerDirectory::WriteSyncFrames(std::vector<std::shared_ptr<Bytebuffer>>& buffers, u32 epoch, u64 knownVersion)
+{
+    if (!CanResume(epoch, knownVersion))
+    {
+        WriteSnapshot(buffers);
+        return;
+    }
+
+    for (u64 version = knownVersion + 1; version <= _version; version++)
+    {
+        WriteChange(buffers, _history[version % _history.size()]);
+    }
+}
+void ServerDirectory::WriteChange(std::vector<std::shared_ptr<Bytebuffer>>& buffers, const Change& change)
+{
+    if (change.isRemove)
+    {
+        std::shared_ptr<Bytebuffer>& buffer = GetWriteBuffer(buffers, SMSG_SERVER_DIRECTORY_REMOVE::MinWireSize);
+        SMSG_SERVER_DIRECTORY_REMOVE::Write(buffer, change.version, change.entry.entity);
+    }
+    else
+    {
+        std::shared_ptr<Bytebuffer>& buffer = GetWriteBuffer(buffers, SMSG_SERVER_DIRECTORY_UPDATE::MinWireSize);
+        SMSG_SERVER_DIRECTORY_UPDATE::Write(buffer, change.version, change.entry);
+    }
+}
+void ServerDirectory::WriteSnapshot(std::vector<std::shared_ptr<Bytebuffer>>& buffers)
+{
+    std::vector<ServerEntry> entries;
+    entries.reserve(_entries.size());
+    for (auto& pair : _entries)
+    {
+        entries.push_back(pair.second);
+    }
+
+    // An empty directory is still sent as one frame so the node learns the epoch and version
+    size_t offset = 0;
+    do
+    {
+        size_t numEntries = std::min(entries.size() - offset, MAX_SNAPSHOT_ENTRIES);
+
+        u8 flags = 0;
+        if (offset == 0)
+            flags |= SNAPSHOT_FLAG_FIRST;
+        if (offset + numEntries == entries.size())
+            flags |= SNAPSHOT_FLAG_LAST;
+
+        PacketSchema::Bytes data(numEntries > 0 ? reinterpret_cast<const u8*>(&entries[offset]) : nullptr, numEntries * sizeof(ServerEntry));
+
+        std::shared_ptr<Bytebuffer>& buffer = GetWriteBuffer(buffers, SMSG_SERVER_DIRECTORY_SNAPSHOT::MinWireSize + data.size);
+        SMSG_SERVER_DIRECTORY_SNAPSHOT::Write(buffer, _epoch, _version, flags, data);
+
+        offset += numEntries;
+    } while (offset < entries.size());
+
+    _numSnapshotsSent++;
+}
+bool ServerDirectory::ApplyChange(const Change& change)
+{
+    if (change.isRemove)
+    {
+        ServerEntry erased;
+        Erase(change.entry.entity, erased);
+    }
+    else
+    {
+        Insert(change.entry);
+    }
+
+    Record(change);
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <NovusTypes.h>
+#include <Utils/ByteBuffer.h>
+#include <entity/fwd.hpp>
+#include <robin_hood.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "AddressType.h"
+#include "RegionType.h"
+#include "ConnectionHandle.h"
+
+class NetworkClient;
+class NetworkServer;
+struct PacketView;
+
+#pragma pack(push, 1)
+struct ServerEntry
+{
+    entt::entity entity;
+    AddressType type = AddressType::INVALID;
+    RegionType region = RegionType::NA;
+    u8 realmId = 0;
+    u32 address = 0;
+    u16 port = 0;
+};
+#pragma pack(pop)
+
+/*
+    Directory of internal servers, keyed by AddressType and RegionType.
+
+    Every change gets the next version and is kept in a ring of the last NETWORK_DIRECTORY_HISTORY_SIZE changes. A node
+    subscribes with the epoch and version it already knows and is sent only the changes after that version. It gets a
+    snapshot only when those changes have left the ring, or when they would be larger than the directory itself. The
+    epoch is random per directory, so a node never resumes against a directory that restarted and began counting again.
+
+    The authority creates its directory with the NetworkServer its subscribers are connected through and pushes every
+    change to them. A node keeps a directory of its own without a server and feeds it every directory packet through
+    Apply. Apply returns false when a version is missing, and the node then resubscribes with WriteResumeRequest.
+*/
+class ServerDirectory
+{
+public:
+    ServerDirectory(NetworkServer* server = nullptr);
+
+    // Both return the version of the change, or 0 if nothing changed
+    u64 Set(const ServerEntry& entry);
+    u64 Remove(entt::entity entity);
+
+    bool Get(entt::entity entity, ServerEntry& entry);
+    std::vector<ServerEntry> Find(AddressType type, RegionType region);
+    bool FindAny(AddressType type, RegionType region, ServerEntry& entry);
+    size_t Count();
+
+    u32 GetEpoch();
+    u64 GetVersion();
+
+    // Authority side, answers a MSG_REQUEST_SERVER_DIRECTORY and pushes every later change to the client
+    bool Subscribe(NetworkClient& client, const PacketView& request);
+    void Unsubscribe(ConnectionHandle handle);
+    size_t GetNumSubscribers();
+    u64 GetNumSnapshotsSent() { return _numSnapshotsSent; }
+
+    // Node side
+    static bool WriteRequest(std::shared_ptr<Bytebuffer>& buffer, u32 epoch, u64 knownVersion);
+    bool WriteResumeRequest(std::shared_ptr<Bytebuffer>& buffer);
+    bool Apply(const PacketView& packet);
+
+    // Frames bringing a node at knownVersion of epoch up to date, split into buffers that each fit a frame
+    std::vector<std::shared_ptr<Bytebuffer>> WriteSync(u32 epoch, u64 knownVersion);
+
+private:
+    struct Change
+    {
+        u64 version = 0;
+        bool isRemove = false;
+        ServerEntry entry;
+    };
+
+    static u16 GetKey(AddressType type, RegionType region) { return static_cast<u16>((static_cast<u16>(type) << 8) | static_cast<u16>(region)); }
+
+    // These expect _mutex to be held
+    void Insert(const ServerEntry& entry);
+    bool Erase(entt::entity entity, ServerEntry& erased);
+    void Record(const Change& change);
+    void Publish(const Change& change);
+    bool CanResume(u32 epoch, u64 knownVersion);
+    void WriteSyncFrames(std::vector<std::shared_ptr<Bytebuffer>>& buffers, u32 epoch, u64 knownVersion);
+    void WriteChange(std::vector<std::shared_ptr<Bytebuffer>>& buffers, const Change& change);
+    void WriteSnapshot(std::vector<std::shared_ptr<Bytebuffer>>& buffers);
+    bool ApplyChange(const Change& change);
+
+    NetworkServer* _server;
+    std::mutex _mutex;
+
+    u32 _epoch;
+    u64 _version = 0;
+    robin_hood::unordered_map<entt::entity, ServerEntry> _entries;
+    robin_hood::unordered_map<u16, std::vector<entt::entity>> _entriesByKey;
+
+    // Ring indexed by version, holds every version from _oldestVersion up to _version
+    std::vector<Change> _history;
+    u64 _oldestVersion = 1;
+
+    std::vector<ConnectionHandle> _subscribers;
+    std::atomic<u64> _numSnapshotsSent;
+
+    // A snapshot spanning several frames is collected here and only replaces the directory once its last frame arrives
+    std::vector<ServerEntry> _pendingSnapshot;
+    u32 _pendingEpoch = 0;
+    u64 _pendingVersion = 0;
+};
@@ -0,0 +1,672 @@
+#include "SharedMemoryChannel.h"
+#include "Defines.h"
+#include <Utils/DebugHandler.h>
+#include <cstring>
+#include <string>
+
+#ifdef NETWORK_SHARED_MEMORY_SUPPORTED
+#include <fcntl.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr u32 SHARED_MEMORY_MAGIC = 0x434D534E; // NSMC
+constexpr size_t SHARED_MEMORY_NUM_DESCRIPTORS = 3;
+
+struct SharedMemoryRing
+{
+    alignas(64) std::atomic<u64> head; // Only written by the producer
+    alignas(64) std::atomic<u64> tail; // Only written by the consumer
+    alignas(64) std::atomic<u32> consumerWaiting;
+    std::atomic<u32> producerWaiting;
+};
+// rings[0] carries client to server and rings[1] server to client, the data of both rings follows the segment
+struct SharedMemorySegment
+{
+    u32 magic;
+    u32 capacity;
+    SharedMemoryRing rings[2];
+};
+static_assert(std::atomic<u64>::is_always_lock_free && std::atomic<u32>::is_always_lock_free, "Shared memory rings need address free atomics");
+
+static std::string GetListenerName(u16 port)
+{
+    // Abstract namespace, nothing is left behind on disk if a server dies
+    return std::string(1, '\0') + "novuscore-" + std::to_string(port);
+}
+
+// The rings are shared with another process, positions are validated instead of trusted
+static bool RingWrite(SharedMemoryRing* ring, u8* data, u32 capacity, const u8* source, size_t size, size_t& bytesWritten)
+{
+    u64 head = ring->head.load(std::memory_order_relaxed);
+    u64 tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail > capacity)
+        return false;
+
+    bytesWritten = std::min(size, static_cast<size_t>(capacity - (head - tail)));
+    if (bytesWritten == 0)
+        return true;
+
+    size_t offset = head & (capacity - 1);
+    size_t firstPart = std::min(bytesWritten, capacity - offset);
+    std::memcpy(data + offset, source, firstPart);
+    std::memcpy(data, source + firstPart, bytesWritten - firstPart);
+
+    ring->head.store(head + bytesWritten, std::memory_order_release);
+    return true;
+}
+static bool RingRead(SharedMemoryRing* ring, u8* data, u32 capacity, u8* destination, size_t size, size_t& bytesRead)
+{
+    u64 tail = ring->tail.load(std::memory_order_relaxed);
+    u64 head = ring->head.load(std::memory_order_acquire);
+    if (head - tail > capacity)
+        return false;
+
+    bytesRead = std::min(size, static_cast<size_t>(head - tail));
+    if (bytesRead == 0)
+        return true;
+
+    size_t offset = tail & (capacity - 1);
+    size_t firstPart = std::min(bytesRead, capacity - offset);
+    std::memcpy(destination, data + offset, firstPart);
+    std::memcpy(destination + firstPart, data, bytesRead - firstPart);
+
+    ring->tail.store(tail + bytesRead, std::memory_order_release);
+    return true;
+}
+static size_t RingFreeSpace(SharedMemoryRing* ring, u32 capacity)
+{
+    u64 used = ring->head.load(std::memory_order_relaxed) - ring->tail.load(std::memory_order_acquire);
+    return used > capacity ? 0 : capacity - used;
+}
+static bool RingIsEmpty(SharedMemoryRing* ring)
+{
+    return ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed);
+}
+
+static void Signal(int fd)
+{
+    u64 value = 1;
+    ssize_t result = write(fd, &value, sizeof(value));
+    (void)result;
+}
+
+static bool SendDescriptors(int socket, const int* fds, size_t numFds)
+{
+    u8 byte = 1;
+    iovec iov = { &byte, sizeof(byte) };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * SHARED_MEMORY_NUM_DESCRIPTORS)] = { };
+    msghdr message = { };
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * numFds);
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * numFds);
+    std::memcpy(CMSG_DATA(header), fds, sizeof(int) * numFds);
+
+    return sendmsg(socket, &message, MSG_NOSIGNAL) == sizeof(byte);
+}
+static bool ReceiveDescriptors(int socket, int* fds, size_t numFds)
+{
+    u8 byte = 0;
+    iovec iov = { &byte, sizeof(byte) };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * SHARED_MEMORY_NUM_DESCRIPTORS)] = { };
+    msghdr message = { };
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) != sizeof(byte))
+        return false;
+
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (header == nullptr || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+        return false;
+
+    size_t numReceived = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    int received[SHARED_MEMORY_NUM_DESCRIPTORS];
+    std::memcpy(received, CMSG_DATA(header), sizeof(int) * std::min(numReceived, SHARED_MEMORY_NUM_DESCRIPTORS));
+
+    if (numReceived != numFds || byte != 1)
+    {
+        for (size_t i = 0; i < std::min(numReceived, SHARED_MEMORY_NUM_DESCRIPTORS); i++)
+        {
+            close(received[i]);
+        }
+
+        return false;
+    }
+
+    std::memcpy(fds, received, sizeof(int) * numFds);
+    return true;
+}
+
+SharedMemoryChannel::SharedMemoryChannel(asio::io_context& context) : _context(context), _wake(context), _control(context) { }
+SharedMemoryChannel::~SharedMemoryChannel()
+{
+    Close();
+
+    if (_segment != nullptr)
+        munmap(_segment, _mappedSize);
+}
+
+bool SharedMemoryChannel::IsSupported()
+{
+    return true;
+}
+bool SharedMemoryChannel::IsLocalAddress(u32 address)
+{
+    if ((address >> 24) == 127)
+        return true;
+
+    ifaddrs* interfaces = nullptr;
+    if (getifaddrs(&interfaces) != 0)
+        return false;
+
+    bool isLocal = false;
+    for (ifaddrs* itr = interfaces; itr != nullptr; itr = itr->ifa_next)
+    {
+        if (itr->ifa_addr == nullptr || itr->ifa_addr->sa_family != AF_INET)
+            continue;
+
+        if (ntohl(reinterpret_cast<sockaddr_in*>(itr->ifa_addr)->sin_addr.s_addr) == address)
+        {
+            isLocal = true;
+            break;
+        }
+    }
+
+    freeifaddrs(interfaces);
+    return isLocal;
+}
+
+std::shared_ptr<SharedMemoryChannel> SharedMemoryChannel::AsyncConnect(asio::io_context& context, u16 port, ConnectHandler handler)
+{
+    std::shared_ptr<SharedMemoryChannel> channel = std::make_shared<SharedMemoryChannel>(context);
+    channel->_control.async_connect(asio::local::stream_protocol::endpoint(GetListenerName(port)),
+        std::bind(&SharedMemoryChannel::_internalConnect, channel, std::placeholders::_1, handler));
+
+    return channel;
+}
+asio::error_code SharedMemoryChannel::SendSegment()
+{
+    static std::atomic<u32> segmentCounter = 0;
+    std::string name = "/novuscore-" + std::to_string(getpid()) + "-" + std::to_string(segmentCounter++);
+
+    int segmentFd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (segmentFd == -1)
+        return asio::error_code(errno, asio::error::get_system_category());
+
+    // Both processes keep the segment mapped, the name would only leak if one of us crashed
+    shm_unlink(name.c_str());
+
+    // ftruncate zero fills, which is a valid empty state for both rings
+    u32 header[2] = { SHARED_MEMORY_MAGIC, NETWORK_SHARED_MEMORY_RING_SIZE };
+    size_t segmentSize = sizeof(SharedMemorySegment) + 2 * static_cast<size_t>(NETWORK_SHARED_MEMORY_RING_SIZE);
+    if (ftruncate(segmentFd, segmentSize) != 0 || pwrite(segmentFd, header, sizeof(header), 0) != sizeof(header))
+    {
+        asio::error_code error(errno, asio::error::get_system_category());
+        close(segmentFd);
+        return error;
+    }
+
+    int clientWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int serverWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (clientWakeFd == -1 || serverWakeFd == -1)
+    {
+        asio::error_code error(errno, asio::error::get_system_category());
+        close(segmentFd);
+        if (clientWakeFd != -1)
+            close(clientWakeFd);
+        if (serverWakeFd != -1)
+            close(serverWakeFd);
+
+        return error;
+    }
+
+    // The server receives its own wakeup descriptor first
+    int fds[SHARED_MEMORY_NUM_DESCRIPTORS] = { segmentFd, serverWakeFd, clientWakeFd };
+    bool isSent = Map(segmentFd, clientWakeFd, serverWakeFd, false) && SendDescriptors(_control.native_handle(), fds, SHARED_MEMORY_NUM_DESCRIPTORS);
+    close(segmentFd);
+
+    return isSent ? asio::error_code() : asio::error::connection_refused;
+}
+
+bool SharedMemoryChannel::Map(int segmentFd, int wakeFd, int peerWakeFd, bool isServer)
+{
+    // The descriptors are ours from here on, even if mapping fails
+    asio::error_code error;
+    _wake.assign(wakeFd, error);
+    _peerWakeFd = peerWakeFd;
+    if (error)
+    {
+        close(wakeFd);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(segmentFd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SharedMemorySegment))
+        return false;
+
+    void* memory = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, segmentFd, 0);
+    if (memory == MAP_FAILED)
+        return false;
+
+    _segment = static_cast<SharedMemorySegment*>(memory);
+    _mappedSize = info.st_size;
+
+    u32 capacity = _segment->capacity;
+    if (_segment->magic != SHARED_MEMORY_MAGIC || capacity == 0 || (capacity & (capacity - 1)) != 0 || sizeof(SharedMemorySegment) + 2 * static_cast<size_t>(capacity) != _mappedSize)
+        return false;
+
+    u8* ringData = static_cast<u8*>(memory) + sizeof(SharedMemorySegment);
+    _capacity = capacity;
+    _rx = &_segment->rings[isServer ? 0 : 1];
+    _tx = &_segment->rings[isServer ? 1 : 0];
+    _rxData = ringData + (isServer ? 0 : capacity);
+    _txData = ringData + (isServer ? capacity : 0);
+
+    _isOpen = true;
+    return true;
+}
+void SharedMemoryChannel::StartControlRead()
+{
+    // Nothing is sent over the control socket after the handshake, it only completes once the peer is gone
+    _control.async_read_some(asio::buffer(&_controlByte, sizeof(_controlByte)),
+        std::bind(&SharedMemoryChannel::_internalControl, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+}
+
+void SharedMemoryChannel::AsyncReadSome(u8* data, size_t size, Handler handler)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    assert(!_readHandler);
+
+    if (!_isOpen)
+    {
+        asio::post(_context, std::bind(handler, _error ? _error : asio::error::not_connected, 0));
+        return;
+    }
+
+    _readData = data;
+    _readSize = size;
+    _readHandler = handler;
+
+    if (!TryCompleteRead())
+        WaitForPeer();
+}
+void SharedMemoryChannel::AsyncWrite(const std::vector<asio::const_buffer>& buffers, Handler handler)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    assert(!_writeHandler);
+
+    if (!_isOpen)
+    {
+        asio::post(_context, std::bind(handler, _error ? _error : asio::error::not_connected, 0));
+        return;
+    }
+
+    _writeBuffers = buffers;
+    _writeBufferIndex = 0;
+    _writeBufferOffset = 0;
+    _bytesWritten = 0;
+    _writeHandler = handler;
+
+    if (!TryCompleteWrite())
+        WaitForPeer();
+}
+
+void SharedMemoryChannel::Close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_isOpen)
+        Fail(asio::error::operation_aborted);
+
+    asio::error_code ignored;
+    _control.close(ignored);
+    _wake.close(ignored);
+
+    if (_peerWakeFd != -1)
+    {
+        close(_peerWakeFd);
+        _peerWakeFd = -1;
+    }
+}
+
+bool SharedMemoryChannel::TryCompleteRead()
+{
+    if (!_readHandler)
+        return true;
+
+    size_t bytesRead = 0;
+    if (!RingRead(_rx, _rxData, _capacity, _readData, _readSize, bytesRead))
+    {
+        Fail(asio::error::invalid_argument);
+        return true;
+    }
+
+    if (bytesRead == 0)
+    {
+        // Announce that we are going to sleep and look again, otherwise a write racing with us would never wake us up
+        _rx->consumerWaiting.store(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (RingIsEmpty(_rx))
+            return false;
+
+        _rx->consumerWaiting.store(0);
+        return TryCompleteRead();
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_rx->producerWaiting.exchange(0) != 0)
+        Signal(_peerWakeFd);
+
+    Handler handler = std::move(_readHandler);
+    _readHandler = nullptr;
+
+    asio::post(_context, std::bind(handler, asio::error_code(), bytesRead));
+    return true;
+}
+bool SharedMemoryChannel::TryCompleteWrite()
+{
+    if (!_writeHandler)
+        return true;
+
+    while (_writeBufferIndex < _writeBuffers.size())
+    {
+        const asio::const_buffer& buffer = _writeBuffers[_writeBufferIndex];
+        size_t remaining = buffer.size() - _writeBufferOffset;
+
+        size_t bytesWritten = 0;
+        if (!RingWrite(_tx, _txData, _capacity, static_cast<const u8*>(buffer.data()) + _writeBufferOffset, remaining, bytesWritten))
+        {
+            Fail(asio::error::invalid_argument);
+            return true;
+        }
+
+        _writeBufferOffset += bytesWritten;
+        _bytesWritten += bytesWritten;
+
+        if (bytesWritten < remaining)
+        {
+            // The ring is full, the consumer has to hear about what we did write before we wait for it to make room
+            NotifyConsumer();
+
+            _tx->producerWaiting.store(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (RingFreeSpace(_tx, _capacity) == 0)
+                return false;
+
+            _tx->producerWaiting.store(0);
+            continue;
+        }
+
+        _writeBufferIndex++;
+        _writeBufferOffset = 0;
+    }
+
+    NotifyConsumer();
+
+    Handler handler = std::move(_writeHandler);
+    _writeHandler = nullptr;
+    _writeBuffers.clear();
+
+    asio::post(_context, std::bind(handler, asio::error_code(), _bytesWritten));
+    return true;
+}
+void SharedMemoryChannel::NotifyConsumer()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_tx->consumerWaiting.exchange(0) != 0)
+        Signal(_peerWakeFd);
+}
+void SharedMemoryChannel::WaitForPeer()
+{
+    if (_isWaiting)
+        return;
+
+    _isWaiting = true;
+    _wake.async_read_some(asio::buffer(&_wakeValue, sizeof(_wakeValue)),
+        std::bind(&SharedMemoryChannel::_internalWake, shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+}
+void SharedMemoryChannel::Fail(asio::error_code error)
+{
+    _isOpen = false;
+    _error = error;
+    FailPending();
+}
+void SharedMemoryChannel::FailPending()
+{
+    if (_readHandler)
+    {
+        asio::post(_context, std::bind(_readHandler, _error, 0));
+        _readHandler = nullptr;
+    }
+
+    if (_writeHandler)
+    {
+        asio::post(_context, std::bind(_writeHandler, _error, _bytesWritten));
+        _writeHandler = nullptr;
+        _writeBuffers.clear();
+    }
+}
+
+void SharedMemoryChannel::_internalWake(asio::error_code errorCode, size_t /*bytesRead*/)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _isWaiting = false;
+
+    if (!_isOpen)
+        return;
+
+    if (errorCode)
+    {
+        Fail(errorCode);
+        return;
+    }
+
+    bool isReadDone = TryCompleteRead();
+    bool isWriteDone = TryCompleteWrite();
+
+    if (_isOpen && (!isReadDone || !isWriteDone))
+        WaitForPeer();
+}
+void SharedMemoryChannel::_internalControl(asio::error_code errorCode, size_t /*bytesRead*/)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_isOpen)
+        Fail(errorCode ? errorCode : asio::error::eof);
+}
+void SharedMemoryChannel::_internalConnect(const asio::error_code& error, ConnectHandler handler)
+{
+    // Close may have raced with a connect that had already completed
+    if (error || !_control.is_open())
+    {
+        handler(error ? error : asio::error::operation_aborted);
+        return;
+    }
+
+    asio::error_code sendError = SendSegment();
+    if (sendError)
+    {
+        Close();
+        handler(sendError);
+        return;
+    }
+
+    // Nothing may be written before the server has mapped the segment
+    asio::async_read(_control, asio::buffer(&_controlByte, sizeof(_controlByte)),
+        std::bind(&SharedMemoryChannel::_internalConnectAck, shared_from_this(), std::placeholders::_1, std::placeholders::_2, handler));
+}
+void SharedMemoryChannel::_internalConnectAck(const asio::error_code& error, size_t /*bytesRead*/, ConnectHandler handler)
+{
+    asio::error_code result = error;
+    if (!result && (!_control.is_open() || _controlByte != 1))
+        result = asio::error::connection_refused;
+
+    if (result)
+    {
+        Close();
+        handler(result);
+        return;
+    }
+
+    StartControlRead();
+    handler(result);
+}
+
+SharedMemoryListener::SharedMemoryListener(asio::io_context& context, u16 port) : _acceptor(context)
+{
+    asio::error_code error;
+    asio::local::stream_protocol::endpoint endpoint(GetListenerName(port));
+
+    _acceptor.open(endpoint.protocol(), error);
+    if (!error)
+        _acceptor.bind(endpoint, error);
+    if (!error)
+        _acceptor.listen(asio::socket_base::max_listen_connections, error);
+
+    if (error)
+    {
+        DebugHandler::PrintWarning("[SharedMemoryListener]: Failed to listen for local connections on port %u (%s)", static_cast<u32>(port), error.message().c_str());
+        return;
+    }
+
+    _isListening = true;
+}
+void SharedMemoryListener::Listen(std::function<asio::io_context&()> selectContext, AcceptHandler acceptHandler)
+{
+    if (!_isListening)
+        return;
+
+    _selectContext = selectContext;
+    _acceptHandler = acceptHandler;
+    Accept();
+}
+void SharedMemoryListener::Close()
+{
+    asio::error_code ignored;
+    _acceptor.close(ignored);
+    _isListening = false;
+}
+void SharedMemoryListener::Accept()
+{
+    std::shared_ptr<SharedMemoryChannel> channel = std::make_shared<SharedMemoryChannel>(_selectContext());
+    _acceptor.async_accept(channel->_control, std::bind(&SharedMemoryListener::_internalAccept, this, channel, std::placeholders::_1));
+}
+void SharedMemoryListener::_internalAccept(std::shared_ptr<SharedMemoryChannel> channel, const asio::error_code& error)
+{
+    if (!_isListening || error == asio::error::operation_aborted)
+        return;
+
+    // The handshake runs on the channel's own context, a slow peer never holds up the next accept and one that stalls is dropped
+    if (!error)
+    {
+        std::shared_ptr<asio::steady_timer> timer = std::make_shared<asio::steady_timer>(channel->GetContext());
+        timer->expires_after(std::chrono::milliseconds(NETWORK_SHARED_MEMORY_HANDSHAKE_TIMEOUT));
+        timer->async_wait(std::bind(&SharedMemoryListener::_internalHandshakeTimeout, this, channel, std::placeholders::_1));
+
+        channel->_control.async_wait(asio::socket_base::wait_read, std::bind(&SharedMemoryListener::_internalHandshake, this, channel, timer, std::placeholders::_1));
+    }
+
+    Accept();
+}
+void SharedMemoryListener::_internalHandshake(std::shared_ptr<SharedMemoryChannel> channel, std::shared_ptr<asio::steady_timer> timer, const asio::error_code& error)
+{
+    asio::error_code ignored;
+    if (error || !channel->_control.is_open())
+    {
+        timer->cancel(ignored);
+        return;
+    }
+
+    int fds[SHARED_MEMORY_NUM_DESCRIPTORS];
+    if (!ReceiveDescriptors(channel->_control.native_handle(), fds, SHARED_MEMORY_NUM_DESCRIPTORS))
+    {
+        timer->cancel(ignored);
+        channel->Close();
+        return;
+    }
+
+    bool isMapped = channel->Map(fds[0], fds[1], fds[2], true);
+    close(fds[0]);
+
+    if (!isMapped)
+    {
+        timer->cancel(ignored);
+        channel->Close();
+        return;
+    }
+
+    channel->_controlByte = 1;
+    asio::async_write(channel->_control, asio::buffer(&channel->_controlByte, sizeof(channel->_controlByte)),
+        std::bind(&SharedMemoryListener::_internalHandshakeAck, this, channel, timer, std::placeholders::_1, std::placeholders::_2));
+}
+void SharedMemoryListener::_internalHandshakeAck(std::shared_ptr<SharedMemoryChannel> channel, std::shared_ptr<asio::steady_timer> timer, const asio::error_code& error, size_t /*bytesWritten*/)
+{
+    asio::error_code ignored;
+    timer->cancel(ignored);
+
+    // The timeout may have closed the channel after the write had already completed
+    if (error || !channel->_control.is_open())
+    {
+        channel->Close();
+        return;
+    }
+
+    channel->StartControlRead();
+    _acceptHandler(channel);
+}
+void SharedMemoryListener::_internalHandshakeTimeout(std::shared_ptr<SharedMemoryChannel> channel, const asio::error_code& error)
+{
+    if (error)
+        return;
+
+    // Cancels whichever step of the handshake is pending
+    channel->Close();
+}
+#else
+SharedMemoryChannel::SharedMemoryChannel(asio::io_context& context) : _context(context) { }
+SharedMemoryChannel::~SharedMemoryChannel() { }
+
+bool SharedMemoryChannel::IsSupported()
+{
+    return false;
+}
+bool SharedMemoryChannel::IsLocalAddress(u32 /*address*/)
+{
+    return false;
+}
+std::shared_ptr<SharedMemoryChannel> SharedMemoryChannel::AsyncConnect(asio::io_context& context, u16 /*port*/, ConnectHandler handler)
+{
+    asio::post(context, std::bind(handler, asio::error::operation_not_supported));
+    return std::make_shared<SharedMemoryChannel>(context);
+}
+void SharedMemoryChannel::AsyncReadSome(u8* /*data*/, size_t /*size*/, Handler handler)
+{
+    asio::post(_context, std::bind(handler, asio::error::operation_not_supported, 0));
+}
+void SharedMemoryChannel::AsyncWrite(const std::vector<asio::const_buffer>& /*buffers*/, Handler handler)
+{
+    asio::post(_context, std::bind(handler, asio::error::operation_not_supported, 0));
+}
+void SharedMemoryChannel::Close() { }
+
+SharedMemoryListener::SharedMemoryListener(asio::io_context& /*context*/, u16 /*port*/) { }
+void SharedMemoryListener::Listen(std::function<asio::io_context&()> /*selectContext*/, AcceptHandler /*acceptHandler*/) { }
+void SharedMemoryListener::Close() { }
+#endif
@@ -0,0 +1,133 @@
+#pragma once
+#include <NovusTypes.h>
+#include <asio.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#define NETWORK_SHARED_MEMORY_SUPPORTED
+#endif
+
+struct SharedMemorySegment;
+struct SharedMemoryRing;
+
+/*
+    A byte stream between two processes on the same host, used in place of a loopback TCP connection.
+
+    Each direction is a single producer single consumer ring in a POSIX shared memory segment. Reads and writes only
+    touch the kernel when the other side is asleep, in which case it is woken through its eventfd. A unix domain socket
+    is kept open next to the segment so either side notices when the other process goes away.
+
+    AsyncReadSome and AsyncWrite complete like their asio counterparts, so BaseSocket can drive it the same way it drives
+    a tcp::socket.
+*/
+class SharedMemoryChannel : public std::enable_shared_from_this<SharedMemoryChannel>
+{
+public:
+    using Handler = std::function<void(asio::error_code, size_t)>;
+    using ConnectHandler = std::function<void(const asio::error_code&)>;
+
+    SharedMemoryChannel(asio::io_context& context);
+    ~SharedMemoryChannel();
+
+    static bool IsSupported();
+    // True for loopback and for any address assigned to one of our interfaces, address is in host byte order
+    static bool IsLocalAddress(u32 address);
+
+    // Connects to the SharedMemoryListener of the server listening on port. The handler runs on context once the server has
+    // mapped the segment, or with the error that stopped us, e.g. connection_refused when nobody listens on port. Closing
+    // the channel cancels the attempt
+    static std::shared_ptr<SharedMemoryChannel> AsyncConnect(asio::io_context& context, u16 port, ConnectHandler handler);
+
+    void AsyncReadSome(u8* data, size_t size, Handler handler);
+    // Only one write may be in progress at a time, the buffers must stay valid until the handler has been called
+    void AsyncWrite(const std::vector<asio::const_buffer>& buffers, Handler handler);
+
+    asio::io_context& GetContext() { return _context; }
+    bool IsOpen() { return _isOpen; }
+    void Close();
+
+private:
+    friend class SharedMemoryListener;
+
+    bool Map(int segmentFd, int wakeFd, int peerWakeFd, bool isServer);
+    asio::error_code SendSegment();
+    void StartControlRead();
+
+    // These must be called with _mutex held
+    bool TryCompleteRead();
+    bool TryCompleteWrite();
+    void WaitForPeer();
+    void Fail(asio::error_code error);
+    void FailPending();
+    void NotifyConsumer();
+
+    void _internalWake(asio::error_code errorCode, size_t bytesRead);
+    void _internalControl(asio::error_code errorCode, size_t bytesRead);
+    void _internalConnect(const asio::error_code& error, ConnectHandler handler);
+    void _internalConnectAck(const asio::error_code& error, size_t bytesRead, ConnectHandler handler);
+
+    asio::io_context& _context;
+    std::mutex _mutex;
+    std::atomic<bool> _isOpen = false;
+    bool _isWaiting = false;
+    asio::error_code _error;
+
+    SharedMemorySegment* _segment = nullptr;
+    size_t _mappedSize = 0;
+    SharedMemoryRing* _rx = nullptr;
+    SharedMemoryRing* _tx = nullptr;
+    u8* _rxData = nullptr;
+    u8* _txData = nullptr;
+    u32 _capacity = 0;
+
+    u8* _readData = nullptr;
+    size_t _readSize = 0;
+    Handler _readHandler;
+
+    std::vector<asio::const_buffer> _writeBuffers;
+    size_t _writeBufferIndex = 0;
+    size_t _writeBufferOffset = 0;
+    size_t _bytesWritten = 0;
+    Handler _writeHandler;
+
+#ifdef NETWORK_SHARED_MEMORY_SUPPORTED
+    asio::posix::stream_descriptor _wake;
+    asio::local::stream_protocol::socket _control;
+    int _peerWakeFd = -1;
+    u64 _wakeValue = 0;
+    u8 _controlByte = 0;
+#endif
+};
+
+// Server side of the handshake, accepts channels from processes connecting to the same port on this host
+class SharedMemoryListener
+{
+public:
+    using AcceptHandler = std::function<void(std::shared_ptr<SharedMemoryChannel>)>;
+
+    SharedMemoryListener(asio::io_context& context, u16 port);
+
+    bool IsListening() { return _isListening; }
+
+    // Keeps accepting until Close, selectContext picks the context every new channel is bound to
+    void Listen(std::function<asio::io_context&()> selectContext, AcceptHandler acceptHandler);
+    void Close();
+
+private:
+#ifdef NETWORK_SHARED_MEMORY_SUPPORTED
+    void Accept();
+    void _internalAccept(std::shared_ptr<SharedMemoryChannel> channel, const asio::error_code& error);
+    void _internalHandshake(std::shared_ptr<SharedMemoryChannel> channel, std::shared_ptr<asio::steady_timer> timer, const asio::error_code& error);
+    void _internalHandshakeAck(std::shared_ptr<SharedMemoryChannel> channel, std::shared_ptr<asio::steady_timer> timer, const asio::error_code& error, size_t bytesWritten);
+    void _internalHandshakeTimeout(std::shared_ptr<SharedMemoryChannel> channel, const asio::error_code& error);
+
+    asio::local::stream_protocol::acceptor _acceptor;
+#endif
+    bool _isListening = false;
+    std::function<asio::io_context&()> _selectContext;
+    AcceptHandler _acceptHandler;
+};
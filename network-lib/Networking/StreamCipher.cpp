@@ -0,0 +1,141 @@
+#include "StreamCipher.h"
+#include <Math/Sha256.h>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <openssl/evp.h>
+
+StreamCipher::~StreamCipher()
+{
+    if (_sealContext)
+        EVP_CIPHER_CTX_free(_sealContext);
+
+    if (_openContext)
+        EVP_CIPHER_CTX_free(_openContext);
+}
+
+bool StreamCipher::Init(const u8* sessionKey, size_t keySize, bool isServer)
+{
+    if (_sealContext || _openContext)
+        return false;
+
+    // Separate keys per direction, otherwise both ends would use the same nonces for their first records
+    u8 keys[2][32];
+    const char* labels[2] = { "NovusCore client to server", "NovusCore server to client" };
+    for (u32 i = 0; i < 2; i++)
+    {
+        Sha256 hasher;
+        hasher.Init();
+        hasher.Update(sessionKey, keySize);
+        hasher.Update(std::string(labels[i]));
+        hasher.Final(keys[i]);
+    }
+
+    const u8* sealKey = isServer ? keys[1] : keys[0];
+    const u8* openKey = isServer ? keys[0] : keys[1];
+
+    _sealContext = EVP_CIPHER_CTX_new();
+    _openContext = EVP_CIPHER_CTX_new();
+
+    bool result = _sealContext && _openContext &&
+        EVP_EncryptInit_ex(_sealContext, EVP_aes_256_gcm(), nullptr, sealKey, nullptr) == 1 &&
+        EVP_DecryptInit_ex(_openContext, EVP_aes_256_gcm(), nullptr, openKey, nullptr) == 1;
+
+    std::memset(keys, 0, sizeof(keys));
+    return result;
+}
+
+bool StreamCipher::Seal(const u8* plaintext, size_t size, u8* dest)
+{
+    if (size == 0 || size > NETWORK_MAX_RECORD_SIZE - RECORD_OVERHEAD)
+        return false;
+
+    bool isTimed = IsTimed(_sealCounter);
+    std::chrono::steady_clock::time_point startTime;
+    if (isTimed)
+        startTime = std::chrono::steady_clock::now();
+
+    u8 nonce[12];
+    GetNonce(_sealCounter++, nonce);
+
+    u32 ciphertextSize = static_cast<u32>(size);
+    std::memcpy(dest, &ciphertextSize, RECORD_HEADER_SIZE);
+
+    i32 length = 0;
+    u8* ciphertext = dest + RECORD_HEADER_SIZE;
+    if (EVP_EncryptInit_ex(_sealContext, nullptr, nullptr, nullptr, nonce) != 1 ||
+        EVP_EncryptUpdate(_sealContext, nullptr, &length, dest, RECORD_HEADER_SIZE) != 1 ||
+        EVP_EncryptUpdate(_sealContext, ciphertext, &length, plaintext, static_cast<i32>(size)) != 1 ||
+        EVP_EncryptFinal_ex(_sealContext, ciphertext + length, &length) != 1 ||
+        EVP_CIPHER_CTX_ctrl(_sealContext, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, ciphertext + size) != 1)
+    {
+        return false;
+    }
+
+    u64 nanoseconds = isTimed ? std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count() : 0;
+    Record(_sealStats, size, nanoseconds, isTimed);
+    return true;
+}
+
+bool StreamCipher::Open(u8* record, size_t recordSize, u8*& plaintext, size_t& plaintextSize)
+{
+    if (recordSize <= RECORD_OVERHEAD)
+        return false;
+
+    bool isTimed = IsTimed(_openCounter);
+    std::chrono::steady_clock::time_point startTime;
+    if (isTimed)
+        startTime = std::chrono::steady_clock::now();
+
+    u8 nonce[12];
+    GetNonce(_openCounter++, nonce);
+
+    u8* ciphertext = record + RECORD_HEADER_SIZE;
+    size_t ciphertextSize = recordSize - RECORD_OVERHEAD;
+
+    // GCM is a counter mode, so decrypting onto the ciphertext itself is fine
+    i32 length = 0;
+    if (EVP_DecryptInit_ex(_openContext, nullptr, nullptr, nullptr, nonce) != 1 ||
+        EVP_CIPHER_CTX_ctrl(_openContext, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, ciphertext + ciphertextSize) != 1 ||
+        EVP_DecryptUpdate(_openContext, nullptr, &length, record, RECORD_HEADER_SIZE) != 1 ||
+        EVP_DecryptUpdate(_openContext, ciphertext, &length, ciphertext, static_cast<i32>(ciphertextSize)) != 1 ||
+        EVP_DecryptFinal_ex(_openContext, ciphertext + length, &length) != 1)
+    {
+        return false;
+    }
+
+    plaintext = ciphertext;
+    plaintextSize = ciphertextSize;
+
+    u64 nanoseconds = isTimed ? std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count() : 0;
+    Record(_openStats, ciphertextSize, nanoseconds, isTimed);
+    return true;
+}
+
+bool StreamCipher::GetRecordSize(const u8* record, size_t& recordSize)
+{
+    u32 ciphertextSize = 0;
+    std::memcpy(&ciphertextSize, record, RECORD_HEADER_SIZE);
+
+    recordSize = ciphertextSize + RECORD_OVERHEAD;
+    return ciphertextSize > 0 && recordSize <= NETWORK_MAX_RECORD_SIZE;
+}
+
+void StreamCipher::Record(EncryptionStats& stats, size_t size, u64 nanoseconds, bool isTimed)
+{
+    // Each direction has a single writer, a plain load and store is enough and avoids a locked add
+    stats.numRecords.store(stats.numRecords.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    stats.numBytes.store(stats.numBytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+
+    if (isTimed)
+    {
+        stats.numSampledRecords.store(stats.numSampledRecords.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        stats.sampledNanoseconds.store(stats.sampledNanoseconds.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void StreamCipher::GetNonce(u64 counter, u8* nonce)
+{
+    std::memset(nonce, 0, 4);
+    std::memcpy(nonce + 4, &counter, sizeof(u64));
+}
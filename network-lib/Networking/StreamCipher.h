@@ -0,0 +1,66 @@
+#pragma once
+#include <NovusTypes.h>
+#include "Defines.h"
+#include <array>
+#include <atomic>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+// Kept per direction of one cipher and only ever written by the thread using that direction, so readers on other threads
+// see them without the cipher paying for a locked add per record
+struct EncryptionStats
+{
+    std::atomic<u64> numRecords = 0;
+    std::atomic<u64> numBytes = 0;
+
+    // Only every NETWORK_CIPHER_TIMING_SAMPLE_RATE-th record is timed, sampledNanoseconds / numSampledRecords is the average
+    std::atomic<u64> numSampledRecords = 0;
+    std::atomic<u64> sampledNanoseconds = 0;
+};
+
+/*
+    AES-256-GCM over the packet stream of one connection, keyed from the SRP session key.
+
+    Every record is a u32 ciphertext size, the ciphertext and a 16 byte tag, the size is authenticated as well.
+    A record always holds whole frames, so the receiver can frame packets straight out of a record once it has been
+    decrypted in place. Each direction has its own key and the nonce is a per direction record counter that never
+    goes over the wire, a replayed, dropped or reordered record fails authentication.
+*/
+class StreamCipher
+{
+public:
+    static constexpr size_t RECORD_HEADER_SIZE = sizeof(u32);
+    static constexpr size_t TAG_SIZE = 16;
+    static constexpr size_t RECORD_OVERHEAD = RECORD_HEADER_SIZE + TAG_SIZE;
+
+    StreamCipher() { }
+    ~StreamCipher();
+
+    // Both ends call this with the same session key, isServer picks which derived key is used for which direction
+    bool Init(const u8* sessionKey, size_t keySize, bool isServer);
+
+    // Writes size bytes of whole frames as a single record to dest, which needs room for size + RECORD_OVERHEAD bytes
+    bool Seal(const u8* plaintext, size_t size, u8* dest);
+    // Decrypts a complete record in place, the plaintext is left right behind the record header
+    bool Open(u8* record, size_t recordSize, u8*& plaintext, size_t& plaintextSize);
+
+    // Reads the full size of the record starting at record, which must hold at least RECORD_HEADER_SIZE bytes
+    static bool GetRecordSize(const u8* record, size_t& recordSize);
+
+    const EncryptionStats& GetSealStats() { return _sealStats; }
+    const EncryptionStats& GetOpenStats() { return _openStats; }
+
+private:
+    void GetNonce(u64 counter, u8* nonce);
+
+    static bool IsTimed(u64 counter) { return (counter & (NETWORK_CIPHER_TIMING_SAMPLE_RATE - 1)) == 0; }
+    static void Record(EncryptionStats& stats, size_t size, u64 nanoseconds, bool isTimed);
+
+    EVP_CIPHER_CTX* _sealContext = nullptr;
+    EVP_CIPHER_CTX* _openContext = nullptr;
+    u64 _sealCounter = 0;
+    u64 _openCounter = 0;
+
+    EncryptionStats _sealStats;
+    EncryptionStats _openStats;
+};
@@ -0,0 +1,262 @@
+#include "TimingWheel.h"
+#include <algorithm>
+#include <cassert>
+
+TimingWheel::TimingWheel(asio::io_context& context, std::chrono::milliseconds resolution) : _context(context), _timer(context), _resolution(resolution)
+{
+    assert(resolution.count() > 0);
+
+    _startTime = std::chrono::steady_clock::now();
+    for (u32 level = 0; level < LEVELS; level++)
+    {
+        for (u32 slot = 0; slot < SLOTS; slot++)
+        {
+            _slots[level][slot] = INVALID_NODE;
+        }
+    }
+}
+
+TimingWheel::TimerId TimingWheel::Schedule(std::chrono::milliseconds delay, Callback callback)
+{
+    CheckThread();
+
+    // While nothing is pending the timer isn't armed and the wheel stops turning, jump ahead instead of replaying the idle ticks
+    u64 nowTick = GetNowTick();
+    if (_numTimers == 0 && nowTick > _currentTick)
+        _currentTick = nowTick;
+
+    u32 index = 0;
+    if (!_freeNodes.empty())
+    {
+        index = _freeNodes.back();
+        _freeNodes.pop_back();
+    }
+    else
+    {
+        index = static_cast<u32>(_nodes.size());
+        _nodes.emplace_back();
+    }
+
+    // The current tick may already be partly over, the extra tick makes sure we never fire before the delay has passed
+    u64 delayTicks = (std::max<i64>(delay.count(), 0) + _resolution.count() - 1) / _resolution.count();
+
+    Node& node = _nodes[index];
+    node.expireTick = std::max(nowTick, _currentTick) + delayTicks + 1;
+    node.callback = std::move(callback);
+    node.isScheduled = true;
+
+    Insert(index);
+    _numTimers++;
+
+    Arm();
+    return (static_cast<u64>(node.generation) << 32) | index;
+}
+bool TimingWheel::Cancel(TimerId id)
+{
+    CheckThread();
+
+    Node* node = GetNode(id);
+    if (!node)
+        return false;
+
+    u32 index = static_cast<u32>(id & 0xFFFFFFFF);
+    Unlink(index);
+    Release(index);
+    return true;
+}
+bool TimingWheel::IsScheduled(TimerId id)
+{
+    CheckThread();
+
+    return GetNode(id) != nullptr;
+}
+
+void TimingWheel::Stop()
+{
+    _timer.cancel();
+    _isArmed = false;
+    _thread = std::thread::id();
+
+    for (u32 i = 0; i < _nodes.size(); i++)
+    {
+        if (_nodes[i].isScheduled)
+            Release(i);
+    }
+
+    for (u32 level = 0; level < LEVELS; level++)
+    {
+        for (u32 slot = 0; slot < SLOTS; slot++)
+        {
+            _slots[level][slot] = INVALID_NODE;
+        }
+    }
+}
+
+void TimingWheel::CheckThread()
+{
+#ifndef NDEBUG
+    std::thread::id thread = std::this_thread::get_id();
+    if (_thread == std::thread::id())
+        _thread = thread;
+
+    assert(_thread == thread);
+#endif
+}
+u64 TimingWheel::GetNowTick()
+{
+    std::chrono::milliseconds elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _startTime);
+    return static_cast<u64>(elapsed.count() / _resolution.count());
+}
+TimingWheel::Node* TimingWheel::GetNode(TimerId id)
+{
+    u32 index = static_cast<u32>(id & 0xFFFFFFFF);
+    u32 generation = static_cast<u32>(id >> 32);
+    if (index >= _nodes.size())
+        return nullptr;
+
+    Node& node = _nodes[index];
+    if (!node.isScheduled || node.generation != generation)
+        return nullptr;
+
+    return &node;
+}
+
+void TimingWheel::Insert(u32 index)
+{
+    Node& node = _nodes[index];
+
+    // Pick the lowest level whose range still covers the delay, anything past the top level is clamped to its range
+    u64 delta = node.expireTick - _currentTick;
+    u32 level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << ((level + 1) * SLOT_BITS)))
+    {
+        level++;
+    }
+
+    u64 maxDelta = (1ull << (LEVELS * SLOT_BITS)) - 1;
+    if (delta > maxDelta)
+        node.expireTick = _currentTick + maxDelta;
+
+    node.level = static_cast<u8>(level);
+    node.slot = static_cast<u8>((node.expireTick >> (level * SLOT_BITS)) & (SLOTS - 1));
+
+    u32& head = _slots[node.level][node.slot];
+    node.prev = INVALID_NODE;
+    node.next = head;
+    if (head != INVALID_NODE)
+        _nodes[head].prev = index;
+
+    head = index;
+}
+void TimingWheel::Unlink(u32 index)
+{
+    Node& node = _nodes[index];
+
+    if (node.prev != INVALID_NODE)
+        _nodes[node.prev].next = node.next;
+    else
+        _slots[node.level][node.slot] = node.next;
+
+    if (node.next != INVALID_NODE)
+        _nodes[node.next].prev = node.prev;
+
+    node.prev = INVALID_NODE;
+    node.next = INVALID_NODE;
+}
+void TimingWheel::Release(u32 index)
+{
+    Node& node = _nodes[index];
+    node.isScheduled = false;
+    node.callback = nullptr;
+
+    // Bumping the generation invalidates every id handed out for this node
+    if (++node.generation == 0)
+        node.generation = 1;
+
+    _freeNodes.push_back(index);
+    _numTimers--;
+}
+
+void TimingWheel::Advance(u64 targetTick)
+{
+    while (_currentTick < targetTick)
+    {
+        if (_numTimers == 0)
+        {
+            _currentTick = targetTick;
+            break;
+        }
+
+        _currentTick++;
+
+        // Every time a level wraps around, the next slot of the level above it is spread over the levels below
+        u32 slot = static_cast<u32>(_currentTick & (SLOTS - 1));
+        for (u32 level = 1; level < LEVELS; level++)
+        {
+            if ((_currentTick & ((1ull << (level * SLOT_BITS)) - 1)) != 0)
+                break;
+
+            Cascade(level);
+        }
+
+        Expire(slot);
+    }
+}
+void TimingWheel::Cascade(u32 level)
+{
+    u32 slot = static_cast<u32>((_currentTick >> (level * SLOT_BITS)) & (SLOTS - 1));
+
+    u32 index = _slots[level][slot];
+    _slots[level][slot] = INVALID_NODE;
+
+    while (index != INVALID_NODE)
+    {
+        u32 next = _nodes[index].next;
+        Insert(index);
+        index = next;
+    }
+}
+void TimingWheel::Expire(u32 slot)
+{
+    // Callbacks may schedule and cancel freely, new timers always land at least one slot ahead of this one
+    while (_slots[0][slot] != INVALID_NODE)
+    {
+        u32 index = _slots[0][slot];
+        Unlink(index);
+
+        Callback callback = std::move(_nodes[index].callback);
+        Release(index);
+
+        callback();
+    }
+}
+
+void TimingWheel::Arm()
+{
+    if (_isArmed || _numTimers == 0)
+        return;
+
+    _isArmed = true;
+    _timer.expires_at(_startTime + _resolution * (_currentTick + 1));
+
+    // Cancelling only queues the handler with an error, it can still run after the wheel is gone
+    std::weak_ptr<bool> isAlive = _isAlive;
+    _timer.async_wait([this, isAlive](const asio::error_code& error)
+    {
+        if (isAlive.expired())
+            return;
+
+        _internalTick(error);
+    });
+}
+void TimingWheel::_internalTick(const asio::error_code& error)
+{
+    if (error)
+        return;
+
+    CheckThread();
+
+    _isArmed = false;
+    Advance(GetNowTick());
+    Arm();
+}
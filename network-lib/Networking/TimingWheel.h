@@ -0,0 +1,94 @@
+#pragma once
+#include <NovusTypes.h>
+#include <asio.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Defines.h"
+
+/*
+    Hierarchical timing wheel driven by a single steady_timer on one io_context.
+
+    Timers are kept in intrusive lists over a pooled node array, so scheduling and cancelling are O(1) and cost no allocation
+    once the pool has grown. Each level has SLOTS slots and covers SLOTS times the range of the level below it, timers in the
+    upper levels are cascaded down as the wheel turns. The steady_timer is only armed while there are timers pending.
+
+    The wheel is not thread safe, every call has to be made from the thread running its io_context. An io_context run by more
+    than one thread can't own a wheel. Debug builds assert that every call comes from the thread that used the wheel first,
+    Stop lets a restarted context pick it up on its new thread.
+
+    The wheel may be destroyed while its wait is still queued on the context, the aborted handler only holds a weak liveness
+    token and never touches the wheel once it is gone.
+*/
+class TimingWheel
+{
+public:
+    // 0 is never a valid id
+    using TimerId = u64;
+    using Callback = std::function<void()>;
+
+    static constexpr u32 LEVELS = 4;
+    static constexpr u32 SLOT_BITS = 8;
+    static constexpr u32 SLOTS = 1 << SLOT_BITS;
+
+    TimingWheel(asio::io_context& context, std::chrono::milliseconds resolution = std::chrono::milliseconds(NETWORK_TIMER_RESOLUTION));
+    ~TimingWheel() { Stop(); }
+
+    // Delays are rounded up to whole ticks and a timer never fires earlier than one tick from now
+    TimerId Schedule(std::chrono::milliseconds delay, Callback callback);
+    bool Cancel(TimerId id);
+    bool IsScheduled(TimerId id);
+
+    // Drops every pending timer without running it
+    void Stop();
+
+    size_t GetNumTimers() { return _numTimers; }
+    std::chrono::milliseconds GetResolution() { return _resolution; }
+    asio::io_context& GetContext() { return _context; }
+
+private:
+    static constexpr u32 INVALID_NODE = 0xFFFFFFFF;
+
+    struct Node
+    {
+        u64 expireTick = 0;
+        u32 prev = INVALID_NODE;
+        u32 next = INVALID_NODE;
+        u32 generation = 1;
+        u8 level = 0;
+        u8 slot = 0;
+        bool isScheduled = false;
+        Callback callback;
+    };
+
+    void CheckThread();
+    u64 GetNowTick();
+    Node* GetNode(TimerId id);
+
+    void Insert(u32 index);
+    void Unlink(u32 index);
+    void Release(u32 index);
+
+    void Advance(u64 targetTick);
+    void Cascade(u32 level);
+    void Expire(u32 slot);
+
+    void Arm();
+    void _internalTick(const asio::error_code& error);
+
+    asio::io_context& _context;
+    asio::steady_timer _timer;
+    std::chrono::milliseconds _resolution;
+    std::chrono::steady_clock::time_point _startTime;
+    u64 _currentTick = 0;
+    bool _isArmed = false;
+    std::thread::id _thread;
+    std::shared_ptr<bool> _isAlive = std::make_shared<bool>(true);
+
+    std::vector<Node> _nodes;
+    std::vector<u32> _freeNodes;
+    u32 _slots[LEVELS][SLOTS];
+    size_t _numTimers = 0;
+};
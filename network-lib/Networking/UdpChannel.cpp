@@ -0,0 +1,362 @@
+#include "UdpChannel.h"
+#include "MessageDispatcher.h"
+#include "MessageHandler.h"
+#include "NetworkPacket.h"
+#include <Math/Sha256.h>
+#include <cstring>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+static bool IsNewer(u32 sequence, u32 other)
+{
+    return static_cast<i32>(sequence - other) > 0;
+}
+static bool IsMovement(Opcode opcode)
+{
+    return opcode == Opcode::MSG_MOVE_ENTITY || opcode == Opcode::MSG_MOVE_HEARTBEAT_ENTITY || opcode == Opcode::MSG_MOVE_STOP_ENTITY;
+}
+static void DeriveKey(const u8* sessionKey, const std::string& label, u8* dest)
+{
+    Sha256 hasher;
+    hasher.Init();
+    hasher.Update(sessionKey, 32);
+    hasher.Update(label);
+    hasher.Final(dest);
+}
+
+UdpChannel::UdpChannel(asio::io_context& context, u16 port, MessageHandler* messageHandler) : _socket(context, udp::endpoint(udp::v4(), port)), _messageHandler(messageHandler) { }
+
+u64 UdpChannel::DeriveToken(const u8* sessionKey)
+{
+    // Hashed with a label so the token can't be mistaken for, or turned back into, the key itself
+    Sha256 hasher;
+    hasher.Init();
+    hasher.Update(sessionKey, 32);
+    hasher.Update(std::string("NovusCore UDP"));
+    hasher.Final();
+
+    u64 token = 0;
+    std::memcpy(&token, hasher.GetData(), sizeof(token));
+    return token;
+}
+
+void UdpChannel::Start()
+{
+    if (_isRunning)
+        return;
+
+    _isRunning = true;
+    Receive();
+}
+void UdpChannel::Stop()
+{
+    if (!_isRunning)
+        return;
+
+    _isRunning = false;
+
+    asio::error_code ignored;
+    _socket.close(ignored);
+}
+
+void UdpChannel::Register(std::shared_ptr<NetworkClient> client, const u8* sessionKey)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    AddPeer(client, sessionKey, true);
+}
+void UdpChannel::Register(std::shared_ptr<NetworkClient> client, const u8* sessionKey, udp::endpoint endpoint)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Peer& peer = AddPeer(client, sessionKey, false);
+    peer.endpoint = endpoint;
+    peer.hasEndpoint = true;
+}
+UdpChannel::Peer& UdpChannel::AddPeer(std::shared_ptr<NetworkClient>& client, const u8* sessionKey, bool isServer)
+{
+    u64 token = DeriveToken(sessionKey);
+
+    Peer peer;
+    peer.owner = client.get();
+    peer.client = client;
+
+    std::array<u8, MAC_KEY_SIZE> clientKey;
+    std::array<u8, MAC_KEY_SIZE> serverKey;
+    DeriveKey(sessionKey, "NovusCore UDP client MAC", clientKey.data());
+    DeriveKey(sessionKey, "NovusCore UDP server MAC", serverKey.data());
+    peer.sendKey = isServer ? serverKey : clientKey;
+    peer.receiveKey = isServer ? clientKey : serverKey;
+
+    _tokens[client.get()] = token;
+
+    Peer& result = _peers[token];
+    result = peer;
+    return result;
+}
+void UdpChannel::Unregister(NetworkClient* client)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto itr = _tokens.find(client);
+    if (itr == _tokens.end())
+        return;
+
+    _peers.erase(itr->second);
+    _tokens.erase(itr);
+}
+
+u32 UdpChannel::Send(NetworkClient* client, std::shared_ptr<Bytebuffer>& buffer)
+{
+    if (buffer->IsEmpty() || sizeof(UdpHeader) + buffer->writtenData > NETWORK_UDP_MAX_DATAGRAM)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto tokenItr = _tokens.find(client);
+    if (tokenItr == _tokens.end())
+        return 0;
+
+    Peer& peer = _peers[tokenItr->second];
+    if (!peer.hasEndpoint)
+        return 0;
+
+    u32 sequence = peer.nextSequence++;
+    if (peer.nextSequence == 0)
+        peer.nextSequence = 1;
+
+    peer.unackedSequences[sequence % ACK_WINDOW] = sequence;
+
+    UdpHeader header;
+    header.mac = 0;
+    header.token = tokenItr->second;
+    header.sequence = sequence;
+    header.ack = peer.lastReceived;
+    header.ackBits = peer.receivedBits;
+
+    std::shared_ptr<Bytebuffer> datagram = Bytebuffer::Borrow<NETWORK_UDP_MAX_DATAGRAM>();
+    datagram->Put<UdpHeader>(header);
+    datagram->PutBytes(buffer->GetDataPointer(), buffer->writtenData);
+
+    u64 mac = ComputeMac(peer.sendKey, datagram->GetDataPointer(), datagram->writtenData);
+    std::memcpy(datagram->GetDataPointer(), &mac, sizeof(mac));
+
+    // Starting sends from several threads at once isn't safe on one socket, holding _mutex serializes them
+    _socket.async_send_to(asio::buffer(datagram->GetDataPointer(), datagram->writtenData), peer.endpoint, [datagram](const asio::error_code&, size_t) { });
+    return sequence;
+}
+
+void UdpChannel::Receive()
+{
+    if (!_receiveBuffer)
+        _receiveBuffer = Bytebuffer::Borrow<NETWORK_UDP_MAX_DATAGRAM>();
+
+    _receiveBuffer->Reset();
+    _socket.async_receive_from(asio::buffer(_receiveBuffer->GetDataPointer(), _receiveBuffer->size), _receiveEndpoint,
+        std::bind(&UdpChannel::_internalReceive, this, std::placeholders::_1, std::placeholders::_2));
+}
+void UdpChannel::_internalReceive(const asio::error_code& error, size_t bytesReceived)
+{
+    if (!_isRunning)
+        return;
+
+    // Errors on an unconnected socket only concern a single datagram, the channel itself keeps going
+    bool hasMovement = false;
+    if (error || bytesReceived < sizeof(UdpHeader) || !FramePackets(bytesReceived, hasMovement))
+    {
+        Receive();
+        return;
+    }
+
+    UdpHeader header;
+    _receiveBuffer->Get<UdpHeader>(header, 0);
+
+    std::shared_ptr<NetworkClient> client;
+    bool isMovementStale = false;
+    std::array<u32, ACK_WINDOW + 1> ackedSequences;
+    size_t numAcked = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto itr = _peers.find(header.token);
+        if (itr == _peers.end())
+        {
+            Receive();
+            return;
+        }
+
+        // Anyone can copy a token off the wire, only the MAC shows the datagram came from the peer
+        Peer& peer = itr->second;
+        u64 mac = ComputeMac(peer.receiveKey, _receiveBuffer->GetDataPointer(), bytesReceived);
+        if (CRYPTO_memcmp(&mac, &header.mac, sizeof(mac)) != 0)
+        {
+            Receive();
+            return;
+        }
+
+        client = peer.client.lock();
+        if (!client || client->IsClosed())
+        {
+            _tokens.erase(peer.owner);
+            _peers.erase(itr);
+
+            Receive();
+            return;
+        }
+
+        if (!AcceptSequence(peer, header.sequence))
+        {
+            Receive();
+            return;
+        }
+
+        // Clients may change address, the newest authenticated datagram decides where we answer
+        if (peer.lastReceived == header.sequence)
+        {
+            peer.endpoint = _receiveEndpoint;
+            peer.hasEndpoint = true;
+        }
+
+        if (hasMovement)
+        {
+            isMovementStale = peer.latestMoveSequence != 0 && IsNewer(peer.latestMoveSequence, header.sequence);
+            if (!isMovementStale)
+                peer.latestMoveSequence = header.sequence;
+        }
+
+        if (header.ack != 0)
+        {
+            for (u32 i = 0; i <= ACK_WINDOW; i++)
+            {
+                if (i > 0 && (header.ackBits & (1u << (i - 1))) == 0)
+                    continue;
+
+                u32 sequence = header.ack - i;
+                u32& unacked = peer.unackedSequences[sequence % ACK_WINDOW];
+                if (unacked == sequence && sequence != 0)
+                {
+                    unacked = 0;
+                    ackedSequences[numAcked++] = sequence;
+                }
+            }
+        }
+    }
+
+    if (_ackHandler)
+    {
+        for (size_t i = 0; i < numAcked; i++)
+        {
+            _ackHandler(client.get(), ackedSequences[i]);
+        }
+    }
+
+    for (std::shared_ptr<NetworkPacket>& packet : _packetBatch)
+    {
+        if (isMovementStale && IsMovement(packet->header.opcode))
+            continue;
+
+        Dispatch(client, packet);
+    }
+
+    Receive();
+}
+
+bool UdpChannel::FramePackets(size_t datagramSize, bool& hasMovement)
+{
+    _packetBatch.clear();
+    _receiveBuffer->writtenData = datagramSize;
+    _receiveBuffer->readData = sizeof(UdpHeader);
+
+    while (_receiveBuffer->GetActiveSize() > 0)
+    {
+        PacketHeader header;
+        if (_receiveBuffer->GetActiveSize() < sizeof(PacketHeader) || !_receiveBuffer->Get<PacketHeader>(header, _receiveBuffer->readData))
+            return false;
+
+        // Compression is a property of the TCP stream, it never appears here
+        size_t frameSize = sizeof(PacketHeader) + header.size;
+        if (_receiveBuffer->GetActiveSize() < frameSize || header.opcode <= Opcode::INVALID || header.opcode >= Opcode::MAX_COUNT)
+            return false;
+
+        size_t index = _packetBatch.size();
+        if (index >= _packetViews.size())
+            _packetViews.resize(index + 1);
+
+        // Views are re-pointed for every datagram, a handler that keeps a packet past its call has to NetworkPacket::Copy it
+        std::shared_ptr<NetworkPacket>& packet = _packetViews[index];
+        if (!packet)
+        {
+            packet = std::make_shared<NetworkPacket>();
+            packet->payload = std::make_shared<Bytebuffer>(_receiveBuffer->GetDataPointer(), 0);
+        }
+
+        packet->header = header;
+        packet->payload->SetView(_receiveBuffer->GetReadPointer() + sizeof(PacketHeader), header.size);
+        _packetBatch.push_back(packet);
+
+        hasMovement |= IsMovement(header.opcode);
+        _receiveBuffer->readData += frameSize;
+    }
+
+    return true;
+}
+
+u64 UdpChannel::ComputeMac(const std::array<u8, MAC_KEY_SIZE>& key, const u8* datagram, size_t size)
+{
+    u8 digest[EVP_MAX_MD_SIZE];
+    u32 digestSize = 0;
+    HMAC(EVP_sha256(), key.data(), static_cast<i32>(key.size()), datagram + sizeof(u64), size - sizeof(u64), digest, &digestSize);
+
+    u64 mac = 0;
+    std::memcpy(&mac, digest, sizeof(mac));
+    return mac;
+}
+
+bool UdpChannel::AcceptSequence(Peer& peer, u32 sequence)
+{
+    if (sequence == 0)
+        return false;
+
+    if (peer.lastReceived == 0 || IsNewer(sequence, peer.lastReceived))
+    {
+        u32 shift = peer.lastReceived == 0 ? ACK_WINDOW + 1 : sequence - peer.lastReceived;
+
+        // The previous newest becomes bit shift - 1, everything it acknowledged moves along with it
+        peer.receivedBits = shift >= ACK_WINDOW ? 0 : peer.receivedBits << shift;
+        if (shift <= ACK_WINDOW)
+            peer.receivedBits |= 1u << (shift - 1);
+
+        peer.lastReceived = sequence;
+        return true;
+    }
+
+    u32 distance = peer.lastReceived - sequence;
+    if (distance == 0 || distance > ACK_WINDOW)
+        return false;
+
+    u32 bit = 1u << (distance - 1);
+    if (peer.receivedBits & bit)
+        return false;
+
+    peer.receivedBits |= bit;
+    return true;
+}
+
+void UdpChannel::Dispatch(std::shared_ptr<NetworkClient>& client, std::shared_ptr<NetworkPacket>& packet)
+{
+    if (_dispatcher)
+    {
+        _dispatcher->Enqueue(client, packet);
+        return;
+    }
+
+    if (_messageHandler->CallHandler(client, packet))
+        return;
+
+    // Same as a rejected TCP packet, the datagram carried a valid token so the connection is to blame
+    std::shared_ptr<NetworkClient> connection = client;
+    asio::post(connection->socket()->get_executor(), [connection]()
+    {
+        connection->Close(asio::error::connection_aborted);
+    });
+}
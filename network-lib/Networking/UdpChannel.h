@@ -0,0 +1,125 @@
+#pragma once
+#include <NovusTypes.h>
+#include <asio.hpp>
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <robin_hood.h>
+#include "Defines.h"
+#include "NetworkClient.h"
+
+class MessageHandler;
+class MessageDispatcher;
+
+// Prefixes every datagram, followed by regular PacketHeader framed packets
+#pragma pack(push, 1)
+struct UdpHeader
+{
+    u64 mac; // Truncated HMAC-SHA256 of everything after it
+    u64 token;
+    u32 sequence;
+    u32 ack; // Highest sequence received from the other side
+    u32 ackBits; // Bit n set means ack - 1 - n was received as well
+};
+#pragma pack(pop)
+
+/*
+    Unreliable side channel next to an authenticated TCP connection, meant for movement that would otherwise suffer
+    from head-of-line blocking.
+
+    Peers are identified by a token derived from the SRP session key. The token is sent in the clear, so every datagram
+    is also authenticated with a MAC keyed from the session key, with a separate key per direction so a datagram can't be
+    reflected back at its sender. Datagrams that fail it are dropped before anything else looks at them. The server learns
+    a client's address from its first authenticated datagram and follows it if it changes. Received packets go through
+    the same MessageHandler as the TCP stream, handlers see the owning NetworkClient and can't tell the difference.
+
+    Datagrams that arrive twice or too late are dropped, and MSG_MOVE_* packets are latest-wins: a movement packet older
+    than one already handled is discarded instead of rewinding the entity.
+
+    Without a dispatcher, handlers run on the thread receiving datagrams, which can race with the same connection's TCP
+    packets. Sending both through one MessageDispatcher keeps every connection on a single worker.
+
+    Packets point into the receive buffer, which the next datagram overwrites. Without a dispatcher they are only valid
+    for the duration of the handler call, a handler that wants to keep one has to NetworkPacket::Copy it. The dispatcher
+    copies packets itself before queueing them.
+*/
+class UdpChannel
+{
+public:
+    using udp = asio::ip::udp;
+    using AckHandler = std::function<void(NetworkClient*, u32 sequence)>;
+
+    static constexpr u32 ACK_WINDOW = 32;
+    static constexpr size_t MAC_KEY_SIZE = 32;
+
+    // port of 0 binds an ephemeral port, which is what clients want
+    UdpChannel(asio::io_context& context, u16 port, MessageHandler* messageHandler);
+
+    static u64 DeriveToken(const u8* sessionKey);
+
+    void Start();
+    void Stop();
+
+    // Server side, the client's address is learned from its first datagram
+    void Register(std::shared_ptr<NetworkClient> client, const u8* sessionKey);
+    // Client side, the server's address is known up front
+    void Register(std::shared_ptr<NetworkClient> client, const u8* sessionKey, udp::endpoint endpoint);
+    void Unregister(NetworkClient* client);
+
+    // Hands received packets to the dispatcher instead of calling the MessageHandler on the receiving thread
+    void SetDispatcher(MessageDispatcher* dispatcher) { _dispatcher = dispatcher; }
+    // Called once for every sequence we sent that the other side reported as received
+    void SetAckHandler(AckHandler ackHandler) { _ackHandler = ackHandler; }
+
+    // buffer holds one or more framed packets and must fit in a single datagram, returns the sequence it was sent with or 0 if it couldn't be sent
+    u32 Send(NetworkClient* client, std::shared_ptr<Bytebuffer>& buffer);
+
+    u16 GetPort() { return _socket.local_endpoint().port(); }
+
+private:
+    struct Peer
+    {
+        NetworkClient* owner = nullptr;
+        std::weak_ptr<NetworkClient> client;
+        udp::endpoint endpoint;
+        bool hasEndpoint = false;
+
+        std::array<u8, MAC_KEY_SIZE> sendKey;
+        std::array<u8, MAC_KEY_SIZE> receiveKey;
+
+        u32 nextSequence = 1;
+        std::array<u32, ACK_WINDOW> unackedSequences = { };
+
+        u32 lastReceived = 0;
+        u32 receivedBits = 0;
+        u32 latestMoveSequence = 0;
+    };
+
+    // Must be called with _mutex held
+    Peer& AddPeer(std::shared_ptr<NetworkClient>& client, const u8* sessionKey, bool isServer);
+
+    void Receive();
+    void _internalReceive(const asio::error_code& error, size_t bytesReceived);
+    bool FramePackets(size_t datagramSize, bool& hasMovement);
+    static u64 ComputeMac(const std::array<u8, MAC_KEY_SIZE>& key, const u8* datagram, size_t size);
+
+    // Must be called with _mutex held, returns false for duplicates and datagrams that fell out of the window
+    bool AcceptSequence(Peer& peer, u32 sequence);
+    void Dispatch(std::shared_ptr<NetworkClient>& client, std::shared_ptr<NetworkPacket>& packet);
+
+    udp::socket _socket;
+    MessageHandler* _messageHandler;
+    MessageDispatcher* _dispatcher = nullptr;
+    AckHandler _ackHandler;
+
+    std::mutex _mutex;
+    robin_hood::unordered_map<u64, Peer> _peers;
+    robin_hood::unordered_map<NetworkClient*, u64> _tokens;
+
+    std::shared_ptr<Bytebuffer> _receiveBuffer;
+    udp::endpoint _receiveEndpoint;
+    BaseSocket::PacketBatch _packetBatch;
+    BaseSocket::PacketBatch _packetViews;
+    bool _isRunning = false;
+};